@@ -0,0 +1,72 @@
+#include "accountcache.h"
+#include <algorithm>
+
+
+bool AccountCache::read(int userID, AccountVersion& account) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = accounts.find(userID);
+    if(found == accounts.end()){
+        return false;
+    }
+    account = found->second;
+    return true;
+}
+
+
+void AccountCache::store(int userID, const AccountVersion& account){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto inserted = accounts.emplace(userID, account);
+    if(!inserted.second && account.version >= inserted.first->second.version){
+        inserted.first->second = account;
+    }
+}
+
+
+void AccountCache::forget(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    accounts.erase(userID);
+}
+
+
+std::string AccountCache::openSession(int userID){
+    std::string token = randomHex(16);
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Clients that vanish without logging out leave their sessions behind; clear the idle ones
+    // whenever the table has doubled since the last sweep
+    if(sessions.size() >= sweepAt){
+        for(auto session = sessions.begin(); session != sessions.end();){
+            if(now - session->second.lastUsed > SESSION_IDLE_TIMEOUT){
+                session = sessions.erase(session);
+            } else {
+                ++session;
+            }
+        }
+        sweepAt = std::max<size_t>(1024, sessions.size() * 2);
+    }
+    sessions[token] = Session{userID, now};
+    return token;
+}
+
+
+int AccountCache::sessionUser(const std::string& token){
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = sessions.find(token);
+    if(found == sessions.end()){
+        return -1;
+    }
+    if(now - found->second.lastUsed > SESSION_IDLE_TIMEOUT){
+        sessions.erase(found);
+        return -1;
+    }
+    found->second.lastUsed = now;
+    return found->second.userID;
+}
+
+
+void AccountCache::closeSession(const std::string& token){
+    std::lock_guard<std::mutex> lock(mutex);
+    sessions.erase(token);
+}
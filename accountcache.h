@@ -0,0 +1,52 @@
+#ifndef ACCOUNTCACHE_H
+#define ACCOUNTCACHE_H
+
+#include "storage.h"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+// A session unused for this long ends; clients reconnect with Resume well within it
+constexpr std::chrono::minutes SESSION_IDLE_TIMEOUT{30};
+
+
+// Balances and versions of the accounts this process has read or written, and the session
+// tokens handed out at login. An entry is only as fresh as the last storage call that touched
+// it; Database writes at the cached version, so a change made elsewhere (another process, a
+// Storage::transact) comes back as TRADE_STALE with the current state instead of being lost.
+class AccountCache {
+
+    private:
+        struct Session {
+            int userID;
+            std::chrono::steady_clock::time_point lastUsed;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<int, AccountVersion> accounts;
+        std::unordered_map<std::string, Session> sessions;   // token -> session
+        size_t sweepAt = 1024;   // session count at which openSession next drops idle ones
+
+    public:
+
+    bool read(int userID, AccountVersion& account) const;
+
+    // Keeps whichever of the cached and given states has the higher version, so a slow writer
+    // finishing last cannot put an older balance back
+    void store(int userID, const AccountVersion& account);
+
+    void forget(int userID);
+
+    // Returns a token of 128 bits from the system random source, bound to the user
+    std::string openSession(int userID);
+
+    // -1 if the token was never issued or its session has ended or gone idle; otherwise the
+    // session counts as used now
+    int sessionUser(const std::string& token);
+
+    void closeSession(const std::string& token);
+};
+
+#endif // ACCOUNTCACHE_H
@@ -0,0 +1,67 @@
+#include "asyncdatabase.h"
+#include <algorithm>
+#include <thread>
+
+
+AsyncDatabase::AsyncDatabase(Database& db, size_t threads)
+    : db(db), executor(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+
+std::future<int> AsyncDatabase::loginUserAsync(const std::string& username, const std::string& password){
+    return run([this, username, password]{ return db.loginUser(username, password); });
+}
+
+
+std::future<double> AsyncDatabase::getBalanceAsync(int userID){
+    return run([this, userID]{ return db.getBalance(userID); });
+}
+
+
+std::future<void> AsyncDatabase::depositMoneyAsync(int userID, double amount){
+    return run([this, userID, amount]{ db.depositMoney(userID, amount); });
+}
+
+
+std::future<void> AsyncDatabase::withdrawMoneyAsync(int userID, double amount){
+    return run([this, userID, amount]{ db.withdrawMoney(userID, amount); });
+}
+
+
+std::future<void> AsyncDatabase::buyStockAsync(int userID, const std::string& stockSymbol, int quantity){
+    return run([this, userID, stockSymbol, quantity]{ db.buyStock(userID, stockSymbol, quantity); });
+}
+
+
+std::future<void> AsyncDatabase::sellStockAsync(int userID, const std::string& stockSymbol, int quantity){
+    return run([this, userID, stockSymbol, quantity]{ db.sellStock(userID, stockSymbol, quantity); });
+}
+
+
+std::future<std::vector<OrderResult>> AsyncDatabase::submitBatchAsync(int userID, const std::vector<Order>& orders){
+    return run([this, userID, orders]{ return db.submitBatch(userID, orders); });
+}
+
+
+std::future<uint64_t> AsyncDatabase::placeLimitOrderAsync(int userID, const std::string& stockSymbol, Side side,
+                                                          int quantity, double limitPrice){
+    return run([this, userID, stockSymbol, side, quantity, limitPrice]{
+        return db.placeLimitOrder(userID, stockSymbol, side, quantity, limitPrice);
+    });
+}
+
+
+std::future<void> AsyncDatabase::cancelOrderAsync(int userID, uint64_t orderID){
+    return run([this, userID, orderID]{ db.cancelOrder(userID, orderID); });
+}
+
+
+std::future<std::vector<Holding>> AsyncDatabase::holdingsAsync(int userID){
+    return run([this, userID]{ return db.holdings(userID); });
+}
+
+
+std::future<PortfolioSnapshot> AsyncDatabase::portfolioSnapshotAsync(int userID){
+    return run([this, userID]{ return db.portfolioSnapshot(userID); });
+}
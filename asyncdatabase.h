@@ -0,0 +1,67 @@
+#ifndef ASYNCDATABASE_H
+#define ASYNCDATABASE_H
+
+#include "database.h"
+#include "threadpool.h"
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Future-returning front for a connected Database. Each call is queued on a small executor
+// and returns at once, so one thread can keep many requests in flight and independent ones
+// (a balance and a portfolio, buys for different users) run on separate pooled connections
+// at the same time. Calls for the same user are not ordered against each other; wait on a
+// future before issuing anything that depends on it. Exceptions surface from future::get().
+class AsyncDatabase {
+
+    private:
+        Database& db;
+        ThreadPool executor;
+
+        template<typename Call>
+        auto run(Call call) -> std::future<decltype(call())>{
+            using Result = decltype(call());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(call));
+            std::future<Result> result = task->get_future();
+            executor.submit([task]{ (*task)(); });
+            return result;
+        }
+
+    public:
+
+    // threads 0 uses every hardware thread. More threads than the storage pool has sessions
+    // only adds waiting for a session.
+    AsyncDatabase(Database& db, size_t threads);
+
+    // Waits for every request already issued
+    ~AsyncDatabase() = default;
+
+    std::future<int> loginUserAsync(const std::string& username, const std::string& password);
+
+    std::future<double> getBalanceAsync(int userID);
+
+    std::future<void> depositMoneyAsync(int userID, double amount);
+
+    std::future<void> withdrawMoneyAsync(int userID, double amount);
+
+    std::future<void> buyStockAsync(int userID, const std::string& stockSymbol, int quantity);
+
+    std::future<void> sellStockAsync(int userID, const std::string& stockSymbol, int quantity);
+
+    std::future<std::vector<OrderResult>> submitBatchAsync(int userID, const std::vector<Order>& orders);
+
+    std::future<uint64_t> placeLimitOrderAsync(int userID, const std::string& stockSymbol, Side side,
+                                               int quantity, double limitPrice);
+
+    std::future<void> cancelOrderAsync(int userID, uint64_t orderID);
+
+    std::future<std::vector<Holding>> holdingsAsync(int userID);
+
+    std::future<PortfolioSnapshot> portfolioSnapshotAsync(int userID);
+
+    size_t threads() const { return executor.size(); }
+};
+
+#endif // ASYNCDATABASE_H
@@ -0,0 +1,249 @@
+#include "backtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+Account::Account(double cash)
+    : cash(cash)
+{
+}
+
+
+bool Account::buy(const std::string& symbol, int quantity, double price){
+    if(quantity <= 0 || price * quantity > cash){
+        rejections++;
+        return false;
+    }
+    cash -= price * quantity;
+    addToPosition(positions[symbol], quantity, price);
+    trades++;
+    return true;
+}
+
+
+bool Account::sell(const std::string& symbol, int quantity, double price){
+    auto found = positions.find(symbol);
+    if(quantity <= 0 || found == positions.end() || found->second.quantity < quantity){
+        rejections++;
+        return false;
+    }
+    cash += price * quantity;
+    relievePosition(found->second, quantity);
+    if(found->second.quantity == 0){
+        positions.erase(found);
+    }
+    trades++;
+    return true;
+}
+
+
+int Account::quantity(const std::string& symbol) const{
+    auto found = positions.find(symbol);
+    return found == positions.end() ? 0 : found->second.quantity;
+}
+
+
+double Account::equity(const std::unordered_map<std::string, double>& marks) const{
+    double total = cash;
+    for(const auto& entry : positions){
+        auto mark = marks.find(entry.first);
+        total += (mark == marks.end()) ? entry.second.costBasis : entry.second.quantity * mark->second;
+    }
+    return total;
+}
+
+
+
+MovingAverageCrossover::MovingAverageCrossover(size_t fast, size_t slow)
+    : fast(std::max<size_t>(fast, 1)), slow(std::max(slow, fast + 1)), window(this->slow, 0.0)
+{
+}
+
+
+void MovingAverageCrossover::onTick(const std::string& symbol, int64_t, double price, Account& account){
+    // Both sums slide over one ring buffer; the fast window is the newest `fast` slots of it
+    size_t slot = seen % slow;
+    if(seen >= fast){
+        fastSum -= window[(seen - fast) % slow];
+    }
+    if(seen >= slow){
+        slowSum -= window[slot];
+    }
+    window[slot] = price;
+    fastSum += price;
+    slowSum += price;
+    seen++;
+
+    if(seen < slow){
+        return;
+    }
+    bool nowAbove = fastSum / fast > slowSum / slow;
+    if(nowAbove && !above){
+        account.buy(symbol, static_cast<int>(account.balance() / price), price);
+    } else if(!nowAbove && above){
+        account.sell(symbol, account.quantity(symbol), price);
+    }
+    above = nowAbove;
+}
+
+
+
+MeanReversion::MeanReversion(size_t length, double threshold)
+    : length(std::max<size_t>(length, 1)), threshold(threshold), window(this->length, 0.0)
+{
+}
+
+
+void MeanReversion::onTick(const std::string& symbol, int64_t, double price, Account& account){
+    size_t slot = seen % length;
+    if(seen >= length){
+        sum -= window[slot];
+    }
+    window[slot] = price;
+    sum += price;
+    seen++;
+
+    if(seen < length){
+        return;
+    }
+    double mean = sum / length;
+    int held = account.quantity(symbol);
+    if(held == 0 && price < mean * (1.0 - threshold)){
+        account.buy(symbol, static_cast<int>(account.balance() / price), price);
+    } else if(held > 0 && price >= mean){
+        account.sell(symbol, held, price);
+    }
+}
+
+
+
+Backtester::Backtester(const std::string& directory, int64_t from, int64_t to)
+    : directory(directory), from(from), to(to)
+{
+}
+
+
+BacktestResult Backtester::runJob(const BacktestJob& job) const{
+    const TickReader& reader = *readers.at(job.symbol);
+    std::unique_ptr<Strategy> strategy = job.makeStrategy();
+    Account account(job.startingCash);
+
+    BacktestResult result;
+    result.name = job.name;
+    result.symbol = job.symbol;
+    result.startingCash = job.startingCash;
+
+    double lastPrice = 0.0;
+    reader.scan(from, to, [&](const TickSpan& span){
+        for(size_t i = 0; i < span.count; i++){
+            strategy->onTick(job.symbol, span.timestamps[i], span.prices[i], account);
+        }
+        lastPrice = span.prices[span.count - 1];
+        result.ticks += span.count;
+    });
+
+    std::unordered_map<std::string, double> marks;
+    if(result.ticks > 0){
+        marks[job.symbol] = lastPrice;
+    }
+    result.finalEquity = account.equity(marks);
+    result.pnl = result.finalEquity - job.startingCash;
+    result.trades = account.tradeCount();
+    result.rejected = account.rejectedCount();
+    return result;
+}
+
+
+std::vector<BacktestResult> Backtester::run(const std::vector<BacktestJob>& jobs, size_t threads, BacktestSummary& summary){
+    // Map every file up front; workers only ever read the shared readers
+    for(const BacktestJob& job : jobs){
+        auto& reader = readers[job.symbol];
+        if(!reader){
+            reader = std::make_unique<TickReader>(TickStore::pathFor(directory, job.symbol));
+        }
+    }
+
+    if(threads == 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::max<size_t>(1, std::min(threads, jobs.size()));
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<WorkerQueue> queues(threads);
+    for(size_t i = 0; i < jobs.size(); i++){
+        queues[i % threads].jobs.push_back(i);
+    }
+
+    std::vector<BacktestResult> results(jobs.size());
+    std::atomic<size_t> steals{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    // Owners take from the back of their own deque, thieves from the front of someone else's
+    auto nextJob = [&](size_t self, size_t& job){
+        {
+            std::lock_guard<std::mutex> lock(queues[self].mutex);
+            if(!queues[self].jobs.empty()){
+                job = queues[self].jobs.back();
+                queues[self].jobs.pop_back();
+                return true;
+            }
+        }
+        for(size_t offset = 1; offset < threads; offset++){
+            WorkerQueue& victim = queues[(self + offset) % threads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.jobs.empty()){
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                steals++;
+                return true;
+            }
+        }
+        return false; // nothing is ever added once running, so every queue is drained
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for(size_t self = 0; self < threads; self++){
+        workers.emplace_back([&, self]{
+            size_t job;
+            while(nextJob(self, job)){
+                try{
+                    results[job] = runJob(jobs[job]);
+                } catch (...){
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if(!error){
+                        error = std::current_exception();
+                    }
+                }
+            }
+        });
+    }
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+    if(error){
+        std::rethrow_exception(error);
+    }
+
+    summary.jobs = jobs.size();
+    summary.threads = threads;
+    summary.steals = steals.load();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    summary.ticks = 0;
+    for(const BacktestResult& result : results){
+        summary.ticks += result.ticks;
+    }
+    summary.ticksPerSecond = (summary.seconds > 0) ? summary.ticks / summary.seconds : 0.0;
+    return results;
+}
@@ -0,0 +1,139 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include "positions.h"
+#include "tickstore.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// In-memory stand-in for one user's Users.Balance and Positions rows.
+// buy/sell apply the same checks as TradeBuy / TradeSell (positive quantity, enough
+// cash at the trade price, enough shares held) and the same average-cost rules as
+// PositionBook, but report a rejection instead of throwing so strategies can probe.
+class Account {
+
+    private:
+        double cash;
+        std::unordered_map<std::string, Position> positions;
+        size_t trades = 0;
+        size_t rejections = 0;
+
+    public:
+
+    explicit Account(double cash);
+
+    bool buy(const std::string& symbol, int quantity, double price);
+
+    bool sell(const std::string& symbol, int quantity, double price);
+
+    double balance() const { return cash; }
+
+    int quantity(const std::string& symbol) const;
+
+    // Cash plus every holding valued the way viewPortfolio does: quantity * current price.
+    // Symbols missing from `marks` are valued at cost.
+    double equity(const std::unordered_map<std::string, double>& marks) const;
+
+    size_t tradeCount() const { return trades; }
+
+    size_t rejectedCount() const { return rejections; }
+};
+
+
+// Sees every tick of one symbol in order and trades through the account
+class Strategy {
+    public:
+    virtual ~Strategy() = default;
+
+    virtual void onTick(const std::string& symbol, int64_t timestamp, double price, Account& account) = 0;
+};
+
+// Goes all in when the fast simple moving average crosses above the slow one, flat when it crosses below
+class MovingAverageCrossover : public Strategy {
+    private:
+        size_t fast;
+        size_t slow;
+        std::vector<double> window;   // ring buffer of the last `slow` prices
+        size_t seen = 0;
+        double fastSum = 0.0;
+        double slowSum = 0.0;
+        bool above = false;
+
+    public:
+    MovingAverageCrossover(size_t fast, size_t slow);
+
+    void onTick(const std::string& symbol, int64_t timestamp, double price, Account& account) override;
+};
+
+// Buys when the price drops `threshold` (a fraction) below its moving average, sells once it recovers to it
+class MeanReversion : public Strategy {
+    private:
+        size_t length;
+        double threshold;
+        std::vector<double> window;
+        size_t seen = 0;
+        double sum = 0.0;
+
+    public:
+    MeanReversion(size_t length, double threshold);
+
+    void onTick(const std::string& symbol, int64_t timestamp, double price, Account& account) override;
+};
+
+
+// One strategy/parameter combination over one symbol
+struct BacktestJob {
+    std::string name;
+    std::string symbol;
+    std::function<std::unique_ptr<Strategy>()> makeStrategy;
+    double startingCash = 100000.0;
+};
+
+struct BacktestResult {
+    std::string name;
+    std::string symbol;
+    double startingCash = 0.0;
+    double finalEquity = 0.0;
+    double pnl = 0.0;
+    size_t trades = 0;
+    size_t rejected = 0;
+    uint64_t ticks = 0;
+};
+
+struct BacktestSummary {
+    size_t jobs = 0;
+    size_t threads = 0;
+    size_t steals = 0;           // jobs a worker took from another worker's queue
+    uint64_t ticks = 0;          // simulated ticks across every job
+    double seconds = 0.0;
+    double ticksPerSecond = 0.0;
+};
+
+
+// Runs jobs in parallel over one read-only set of mapped tick files.
+// Each worker owns a deque of jobs and steals from the others once it runs dry,
+// so a few long series do not leave the remaining cores idle.
+class Backtester {
+
+    private:
+        std::string directory;
+        int64_t from;
+        int64_t to;
+        std::unordered_map<std::string, std::unique_ptr<TickReader>> readers;
+
+        BacktestResult runJob(const BacktestJob& job) const;
+
+    public:
+
+    Backtester(const std::string& directory, int64_t from = INT64_MIN, int64_t to = INT64_MAX);
+
+    // threads 0 uses every hardware thread. Results come back in job order.
+    std::vector<BacktestResult> run(const std::vector<BacktestJob>& jobs, size_t threads, BacktestSummary& summary);
+};
+
+#endif // BACKTEST_H
@@ -0,0 +1,210 @@
+#include "batchdriver.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace {
+    const char* const KIND_NAMES[BatchCommand::KINDS] = {
+        "create", "login", "deposit", "withdraw", "buy", "sell", "portfolio", "transactions"
+    };
+
+    // Swallows what viewPortfolio / viewTransactions print
+    class NullBuffer : public std::streambuf {
+        protected:
+        int overflow(int c) override { return c; }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    };
+}
+
+
+BatchDriver::BatchDriver(Database& db, size_t workers)
+    : db(db), workerCount(workers)
+{
+    if(workerCount == 0){
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(const char* name : KIND_NAMES){
+        histograms.push_back(Metrics::histogram(std::string("Batch::") + name));
+    }
+}
+
+
+bool BatchDriver::parse(const std::string& text, size_t line, BatchCommand& command){
+    std::istringstream in(text);
+    std::string verb;
+    if(!(in >> verb) || verb[0] == '#'){
+        return false;
+    }
+
+    auto kind = std::find(std::begin(KIND_NAMES), std::end(KIND_NAMES), verb);
+    if(kind == std::end(KIND_NAMES)){
+        throw std::runtime_error("line " + std::to_string(line) + ": unknown command '" + verb + "'");
+    }
+    command = BatchCommand();
+    command.kind = static_cast<BatchCommand::Kind>(kind - std::begin(KIND_NAMES));
+    command.line = line;
+
+    bool complete = static_cast<bool>(in >> command.username);
+    switch(command.kind){
+        case BatchCommand::Create:
+        case BatchCommand::Login:
+            complete = complete && (in >> command.password);
+            break;
+        case BatchCommand::Deposit:
+        case BatchCommand::Withdraw:
+            complete = complete && (in >> command.amount);
+            break;
+        case BatchCommand::Buy:
+        case BatchCommand::Sell:
+            complete = complete && (in >> command.symbol >> command.quantity);
+            break;
+        default:
+            break;
+    }
+    if(!complete){
+        throw std::runtime_error("line " + std::to_string(line) + ": missing arguments for '" + verb + "'");
+    }
+    return true;
+}
+
+
+BatchStats BatchDriver::run(std::istream& commands){
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(size_t i = 0; i < workerCount; i++){
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    NullBuffer discard;
+    std::streambuf* console = std::cout.rdbuf(&discard);
+
+    auto start = std::chrono::steady_clock::now();
+    for(auto& worker : workers){
+        worker->thread = std::thread(&BatchDriver::workerLoop, this, std::ref(*worker));
+    }
+
+    uint64_t rejected = 0;
+    std::hash<std::string> route;
+    std::string text;
+    size_t line = 0;
+    while(std::getline(commands, text)){
+        line++;
+        BatchCommand command;
+        try{
+            if(!parse(text, line, command)){
+                continue;
+            }
+        } catch (const std::exception& e){
+            std::cerr << e.what() << "\n";
+            rejected++;
+            continue;
+        }
+
+        Worker& worker = *workers[route(command.username) % workerCount];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.drained.wait(lock, [&]{ return worker.queue.size() < queueLimit; });
+        worker.queue.push_back(std::move(command));
+        worker.wake.notify_one();
+    }
+
+    for(auto& worker : workers){
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->closed = true;
+        }
+        worker->wake.notify_one();
+    }
+    for(auto& worker : workers){
+        worker->thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(console);
+
+    BatchStats stats;
+    stats.workers = workerCount;
+    stats.seconds = seconds;
+    stats.failed = rejected;
+    stats.commands = rejected;
+    for(const auto& worker : workers){
+        stats.commands += worker->commands;
+        stats.failed += worker->failed;
+    }
+    stats.commandsPerSecond = (seconds > 0) ? stats.commands / seconds : 0.0;
+    for(const HistogramSummary& summary : Metrics::histograms()){
+        if(summary.name.compare(0, 7, "Batch::") == 0){
+            stats.latencies.push_back(summary);
+        }
+    }
+    return stats;
+}
+
+
+void BatchDriver::workerLoop(Worker& worker){
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    while(true){
+        worker.wake.wait(lock, [&]{ return !worker.queue.empty() || worker.closed; });
+        if(worker.queue.empty()){
+            break;
+        }
+        BatchCommand command = std::move(worker.queue.front());
+        worker.queue.pop_front();
+        worker.drained.notify_one();
+        lock.unlock();
+
+        try{
+            LatencyTimer timer(histograms[command.kind]);
+            execute(worker, command);
+        } catch (const std::exception& e){
+            std::cerr << "line " << command.line << " (" << KIND_NAMES[command.kind] << " "
+                      << command.username << "): " << e.what() << "\n";
+            worker.failed++;
+        }
+        worker.commands++;
+        lock.lock();
+    }
+}
+
+
+void BatchDriver::execute(Worker& worker, const BatchCommand& command){
+    if(command.kind == BatchCommand::Create){
+        worker.sessions[command.username] = db.createUser(command.username, command.password);
+        return;
+    }
+    if(command.kind == BatchCommand::Login){
+        worker.sessions[command.username] = db.loginUser(command.username, command.password);
+        return;
+    }
+
+    auto session = worker.sessions.find(command.username);
+    if(session == worker.sessions.end()){
+        throw std::runtime_error("not logged in");
+    }
+    int userID = session->second;
+
+    switch(command.kind){
+        case BatchCommand::Deposit:
+            db.depositMoney(userID, command.amount);
+            break;
+        case BatchCommand::Withdraw:
+            db.withdrawMoney(userID, command.amount);
+            break;
+        case BatchCommand::Buy:
+            db.buyStock(userID, command.symbol, command.quantity);
+            break;
+        case BatchCommand::Sell:
+            db.sellStock(userID, command.symbol, command.quantity);
+            break;
+        case BatchCommand::Portfolio:
+            db.viewPortfolio(userID);
+            break;
+        case BatchCommand::Transactions:
+            db.viewTransactions(userID);
+            break;
+        default:
+            break;
+    }
+}
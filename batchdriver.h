@@ -0,0 +1,89 @@
+#ifndef BATCHDRIVER_H
+#define BATCHDRIVER_H
+
+#include "database.h"
+#include "metrics.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// One line of a batch script:
+//   create <username> <password>        login <username> <password>
+//   deposit <username> <amount>         withdraw <username> <amount>
+//   buy <username> <symbol> <quantity>  sell <username> <symbol> <quantity>
+//   portfolio <username>                transactions <username>
+// Blank lines and lines starting with '#' are skipped.
+struct BatchCommand {
+    enum Kind { Create, Login, Deposit, Withdraw, Buy, Sell, Portfolio, Transactions, KINDS };
+
+    Kind kind = Login;
+    size_t line = 0;
+    std::string username;
+    std::string password;
+    std::string symbol;
+    int quantity = 0;
+    double amount = 0.0;
+};
+
+struct BatchStats {
+    uint64_t commands = 0;
+    uint64_t failed = 0;
+    size_t workers = 0;
+    double seconds = 0.0;
+    double commandsPerSecond = 0.0;
+    std::vector<HistogramSummary> latencies;   // one per command kind that ran
+};
+
+
+// Runs a command stream against one Database from a fixed set of worker threads.
+// Every command for a given username goes to the same worker, so each user's commands run
+// in script order while different users run in parallel; the reader keeps queuing without
+// waiting for results. Connect the Database with a pool at least as large as the worker
+// count so every worker keeps a connection of its own.
+class BatchDriver {
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable drained;
+            std::deque<BatchCommand> queue;
+            bool closed = false;
+            std::unordered_map<std::string, int> sessions;   // username -> UserID, this worker's users only
+            uint64_t commands = 0;
+            uint64_t failed = 0;
+            std::thread thread;
+        };
+
+        Database& db;
+        size_t workerCount;
+        size_t queueLimit = 4096;   // per worker, so a fast reader cannot buffer a whole file
+        std::vector<size_t> histograms;
+
+        void workerLoop(Worker& worker);
+
+        void execute(Worker& worker, const BatchCommand& command);
+
+    public:
+
+    // workers 0 uses every hardware thread
+    BatchDriver(Database& db, size_t workers);
+
+    // Parses and dispatches until the stream ends, then waits for every worker to finish.
+    // Output from portfolio and transactions commands is discarded while the batch runs.
+    BatchStats run(std::istream& commands);
+
+    size_t workers() const { return workerCount; }
+
+    // False for blank and comment lines; throws with the line number if the line is not a valid command
+    static bool parse(const std::string& text, size_t line, BatchCommand& command);
+};
+
+#endif // BATCHDRIVER_H
@@ -0,0 +1,320 @@
+#include "../database.h"
+#include "../asyncdatabase.h"
+#include "../sessionpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Seeds the storage behind a MySQL X Protocol URL or embedded://<directory> with its own
+// users, symbols and trade history, then times each Database entry point in turn and reports
+// ops/sec, p50/p99/p999 latency and MySQL round trips per call (always 0 when embedded).
+// Users and symbols are tagged with the run's start time, so repeated runs against one
+// database never collide.
+//
+// buyStockAsync issues the same buys from one thread through AsyncDatabase, keeping
+// --inflight of them outstanding, to show what overlapping round trips buys over one at a time.
+//
+// Usage: DatabaseBench <url> [--users N] [--symbols N] [--history N] [--ops N]
+//                      [--inflight N] [--journal path] [--json path]
+
+
+namespace {
+    struct Config {
+        std::string url;
+        size_t users = 50;
+        size_t symbols = 100;
+        size_t history = 200;      // seeded trades per user
+        size_t ops = 2000;         // timed calls per method
+        size_t inflight = 16;      // outstanding requests in the async run
+        std::string journalPath;   // empty: trades go straight to storage
+        std::string jsonPath;
+    };
+
+    struct MethodResult {
+        std::string method;
+        size_t ops = 0;
+        size_t failures = 0;
+        double opsPerSecond = 0.0;
+        double p50Micros = 0.0;
+        double p99Micros = 0.0;
+        double p999Micros = 0.0;
+        double roundTripsPerOp = 0.0;
+    };
+
+
+    // Serves one fixed CSV payload so seeding goes through the normal ingest path
+    class SeedQuoteSource : public QuoteSource {
+        private:
+            std::string payload;
+
+        public:
+        explicit SeedQuoteSource(std::string payload) : payload(std::move(payload)) {}
+
+        std::string read() override { return payload; }
+    };
+
+
+    MethodResult measure(const std::string& method, size_t ops, const std::function<void(size_t)>& call){
+        std::vector<double> latencies;
+        latencies.reserve(ops);
+        size_t roundTrips = 0;
+        MethodResult result;
+        result.method = method;
+
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < ops; i++){
+            SessionPool::threadRoundTrips() = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            try{
+                call(i);
+            } catch (const std::exception&){
+                result.failures++;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            roundTrips += SessionPool::threadRoundTrips();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p){
+            if(latencies.empty()){
+                return 0.0;
+            }
+            return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+        };
+
+        result.ops = ops;
+        result.opsPerSecond = (seconds > 0) ? ops / seconds : 0.0;
+        result.p50Micros = percentile(0.50);
+        result.p99Micros = percentile(0.99);
+        result.p999Micros = percentile(0.999);
+        result.roundTripsPerOp = (ops > 0) ? static_cast<double>(roundTrips) / ops : 0.0;
+        return result;
+    }
+
+
+    // Issues every call from this thread, waiting only once `inflight` are outstanding. Latency is
+    // issue to collection, so it includes time spent queued behind earlier requests.
+    MethodResult measureInFlight(const std::string& method, size_t ops, size_t inflight,
+                                 const std::function<std::future<void>(size_t)>& issue){
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> latencies;
+        latencies.reserve(ops);
+        std::deque<std::pair<Clock::time_point, std::future<void>>> outstanding;
+        MethodResult result;
+        result.method = method;
+
+        auto collect = [&]{
+            try{
+                outstanding.front().second.get();
+            } catch (const std::exception&){
+                result.failures++;
+            }
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - outstanding.front().first).count());
+            outstanding.pop_front();
+        };
+
+        auto start = Clock::now();
+        for(size_t i = 0; i < ops; i++){
+            if(outstanding.size() == inflight){
+                collect();
+            }
+            outstanding.emplace_back(Clock::now(), issue(i));
+        }
+        while(!outstanding.empty()){
+            collect();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p){
+            if(latencies.empty()){
+                return 0.0;
+            }
+            return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+        };
+
+        result.ops = ops;
+        result.opsPerSecond = (seconds > 0) ? ops / seconds : 0.0;
+        result.p50Micros = percentile(0.50);
+        result.p99Micros = percentile(0.99);
+        result.p999Micros = percentile(0.999);
+        return result;
+    }
+
+
+    std::string toJson(const Config& config, const std::vector<MethodResult>& results){
+        std::ostringstream out;
+        out << "{\n  \"config\": {\"users\": " << config.users << ", \"symbols\": " << config.symbols
+            << ", \"history\": " << config.history << ", \"ops\": " << config.ops
+            << ", \"inflight\": " << config.inflight
+            << ", \"journal\": " << (config.journalPath.empty() ? "false" : "true") << "},\n  \"results\": [\n";
+        for(size_t i = 0; i < results.size(); i++){
+            const MethodResult& result = results[i];
+            out << "    {\"method\": \"" << result.method << "\", \"ops\": " << result.ops
+                << ", \"failures\": " << result.failures
+                << ", \"opsPerSec\": " << result.opsPerSecond
+                << ", \"p50Micros\": " << result.p50Micros
+                << ", \"p99Micros\": " << result.p99Micros
+                << ", \"p999Micros\": " << result.p999Micros
+                << ", \"roundTripsPerOp\": " << result.roundTripsPerOp << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return out.str();
+    }
+
+
+    bool parseArgs(int argc, char** argv, Config& config){
+        if(argc < 2){
+            return false;
+        }
+        config.url = argv[1];
+        for(int i = 2; i + 1 < argc; i += 2){
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if(flag == "--users"){
+                config.users = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--symbols"){
+                config.symbols = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--history"){
+                config.history = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--ops"){
+                config.ops = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--inflight"){
+                config.inflight = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--journal"){
+                config.journalPath = value;
+            } else if(flag == "--json"){
+                config.jsonPath = value;
+            } else {
+                return false;
+            }
+        }
+        return config.users > 0 && config.symbols > 0 && config.inflight > 0;
+    }
+}
+
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parseArgs(argc, argv, config)){
+        std::cerr << "Usage: DatabaseBench <url> [--users N] [--symbols N] [--history N] [--ops N]"
+                     " [--inflight N] [--journal path] [--json path]\n";
+        return 1;
+    }
+
+    Database db;
+    db.connect(config.url, 0, false);
+    if(!config.journalPath.empty()){
+        db.enableJournal(config.journalPath);
+    }
+
+    std::string tag = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() % 1000000);
+    std::mt19937_64 rng(42);
+
+    // Seed symbols through ingestQuotes, then users with cash and `history` trades each
+    std::vector<std::string> symbols;
+    std::string csv;
+    for(size_t i = 0; i < config.symbols; i++){
+        symbols.push_back("B" + tag + "_" + std::to_string(i));
+        csv += symbols.back() + "," + std::to_string(10 + (i % 490)) + ",1000,Bench " + std::to_string(i) + "\n";
+    }
+    SeedQuoteSource seedQuotes(csv);
+    db.ingestQuotes(seedQuotes);
+
+    std::cerr << "Seeding " << config.users << " users x " << config.history << " trades..." << std::endl;
+    std::vector<int> userIDs;
+    std::vector<std::string> usernames;
+    std::uniform_int_distribution<size_t> pickSymbol(0, symbols.size() - 1);
+    for(size_t u = 0; u < config.users; u++){
+        usernames.push_back("bench_" + tag + "_" + std::to_string(u));
+        userIDs.push_back(db.createUser(usernames.back(), "bench"));
+        db.depositMoney(userIDs.back(), 1e9);
+
+        std::vector<Order> basket;
+        for(size_t t = 0; t < config.history; t++){
+            basket.push_back(Order{symbols[pickSymbol(rng)], Side::Buy, 1 + static_cast<int>(t % 5)});
+            if(basket.size() == 100 || t + 1 == config.history){
+                db.submitBatch(userIDs.back(), basket);
+                basket.clear();
+            }
+        }
+    }
+
+    // viewPortfolio / viewTransactions print; keep that out of the timings and the terminal
+    std::ostringstream discard;
+    std::streambuf* console = std::cout.rdbuf();
+
+    std::uniform_int_distribution<size_t> pickUser(0, userIDs.size() - 1);
+    std::vector<std::pair<int, std::string>> bought;
+    bought.reserve(config.ops);
+
+    std::vector<MethodResult> results;
+    results.push_back(measure("createUser", config.ops, [&](size_t i){
+        db.createUser("bench_" + tag + "_new_" + std::to_string(i), "bench");
+    }));
+    results.push_back(measure("loginUser", config.ops, [&](size_t){
+        db.loginUser(usernames[pickUser(rng)], "bench");
+    }));
+    results.push_back(measure("depositMoney", config.ops, [&](size_t){
+        db.depositMoney(userIDs[pickUser(rng)], 100.0);
+    }));
+    results.push_back(measure("buyStock", config.ops, [&](size_t){
+        int userID = userIDs[pickUser(rng)];
+        const std::string& symbol = symbols[pickSymbol(rng)];
+        db.buyStock(userID, symbol, 1);
+        bought.emplace_back(userID, symbol);
+    }));
+    results.push_back(measure("sellStock", std::min(config.ops, bought.size()), [&](size_t i){
+        db.sellStock(bought[i].first, bought[i].second, 1);
+    }));
+    {
+        // Same thread, but with up to `inflight` buys outstanding on the executor
+        AsyncDatabase async(db, config.inflight);
+        results.push_back(measureInFlight("buyStockAsync", config.ops, config.inflight, [&](size_t){
+            return async.buyStockAsync(userIDs[pickUser(rng)], symbols[pickSymbol(rng)], 1);
+        }));
+    }
+
+    std::cout.rdbuf(discard.rdbuf());
+    results.push_back(measure("viewPortfolio", config.ops, [&](size_t){
+        db.viewPortfolio(userIDs[pickUser(rng)]);
+        discard.str("");
+    }));
+    results.push_back(measure("viewTransactions", config.ops, [&](size_t){
+        db.viewTransactions(userIDs[pickUser(rng)]);
+        discard.str("");
+    }));
+    std::cout.rdbuf(console);
+
+    for(const MethodResult& result : results){
+        std::cout << result.method << ": " << static_cast<uint64_t>(result.opsPerSecond) << " ops/s"
+                  << " | p50 " << result.p50Micros << " us"
+                  << " | p99 " << result.p99Micros << " us"
+                  << " | p999 " << result.p999Micros << " us"
+                  << " | " << result.roundTripsPerOp << " round trips/op"
+                  << (result.failures ? " | " + std::to_string(result.failures) + " failed" : "") << "\n";
+    }
+
+    // Per-method and per-statement breakdown from the built-in histograms
+    std::cerr << Metrics::report();
+
+    std::string json = toJson(config, results);
+    if(config.jsonPath.empty()){
+        std::cout << json;
+    } else {
+        std::ofstream(config.jsonPath) << json;
+    }
+    return 0;
+}
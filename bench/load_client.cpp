@@ -0,0 +1,321 @@
+#include "../protocol.h"
+#include "../metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Opens many connections to a running OrderServer (TradingApp --serve), registers a fresh
+// user on each and funds it, then keeps a fixed number of market orders in flight per
+// connection for the run: buy, sell, buy, sell... one share at a time, so positions stay flat.
+// Reports sustained orders/sec, rejects and round-trip latency as seen by the client.
+// Usernames are tagged with the process ID and start time, so repeated runs never collide.
+//
+// Usage: LoadClient <host> <port> [--connections N] [--threads N] [--seconds N]
+//                   [--pipeline N] [--symbol SYM]
+
+
+namespace {
+    struct Config {
+        std::string host;
+        std::string port;
+        size_t connections = 100;
+        size_t threads = 4;
+        size_t seconds = 10;
+        size_t pipeline = 8;       // orders in flight per connection
+        std::string symbol = "AAPL";
+    };
+
+    struct Client {
+        int fd = -1;
+        std::string in;
+        size_t inOffset = 0;
+        std::string out;
+        size_t outOffset = 0;
+        uint32_t nextID = 0;
+        size_t setupReplies = 0;   // Register and Deposit must both succeed before trading
+        bool trading = false;
+        bool buyNext = true;
+        std::deque<std::chrono::steady_clock::time_point> sent;   // responses arrive in request order
+    };
+
+    struct ThreadTotals {
+        uint64_t orders = 0;
+        uint64_t rejected = 0;
+        uint64_t failedConnections = 0;
+    };
+
+    const size_t ORDER_LATENCY = Metrics::histogram("LoadClient::order");
+    constexpr double FUNDING = 1e9;
+
+    std::atomic<bool> running{true};
+
+
+    int connectTo(const Config& config){
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if(getaddrinfo(config.host.c_str(), config.port.c_str(), &hints, &addresses) != 0){
+            return -1;
+        }
+        int fd = -1;
+        for(addrinfo* address = addresses; address; address = address->ai_next){
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if(fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) == 0){
+                break;
+            }
+            if(fd >= 0){
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if(fd >= 0){
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+        return fd;
+    }
+
+
+    void sendOrder(const Config& config, Client& client){
+        PayloadWriter order;
+        order.str(config.symbol).i32(1);
+        appendFrame(client.out, client.buyNext ? MessageType::Buy : MessageType::Sell, client.nextID++, order.bytes());
+        client.buyNext = !client.buyNext;
+        client.sent.push_back(std::chrono::steady_clock::now());
+    }
+
+
+    // Handles every complete response; false if the connection should be dropped
+    bool receive(const Config& config, Client& client, ThreadTotals& totals){
+        Frame frame;
+        try{
+            while(takeFrame(client.in, client.inOffset, frame)){
+                if(!client.trading){
+                    if(frame.type != MessageType::Ok){
+                        PayloadReader reason(frame.payload);
+                        std::cerr << "Setup rejected: " << reason.str() << "\n";
+                        return false;
+                    }
+                    if(++client.setupReplies == 2){
+                        client.trading = true;
+                        for(size_t i = 0; i < config.pipeline; i++){
+                            sendOrder(config, client);
+                        }
+                    }
+                    continue;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                Metrics::record(ORDER_LATENCY, std::chrono::duration_cast<std::chrono::nanoseconds>(now - client.sent.front()).count());
+                client.sent.pop_front();
+                totals.orders++;
+                if(frame.type != MessageType::Ok){
+                    totals.rejected++;
+                }
+                if(running.load(std::memory_order_relaxed)){
+                    sendOrder(config, client);
+                }
+            }
+        } catch (const std::exception& e){
+            std::cerr << "Bad frame from server: " << e.what() << "\n";
+            return false;
+        }
+        if(client.inOffset == client.in.size()){
+            client.in.clear();
+            client.inOffset = 0;
+        }
+        return true;
+    }
+
+
+    void runThread(const Config& config, size_t first, size_t count, const std::string& tag, ThreadTotals& totals){
+        std::vector<Client> clients(count);
+        for(size_t i = 0; i < count; i++){
+            Client& client = clients[i];
+            client.fd = connectTo(config);
+            if(client.fd < 0){
+                totals.failedConnections++;
+                continue;
+            }
+            PayloadWriter account;
+            account.str("load_" + tag + "_" + std::to_string(first + i)).str("load");
+            appendFrame(client.out, MessageType::Register, client.nextID++, account.bytes());
+            PayloadWriter funding;
+            funding.f64(FUNDING);
+            appendFrame(client.out, MessageType::Deposit, client.nextID++, funding.bytes());
+        }
+
+        std::vector<pollfd> polled;
+        std::vector<Client*> owners;
+        char buffer[16 * 1024];
+        while(true){
+            polled.clear();
+            owners.clear();
+            for(Client& client : clients){
+                // Once stopped, wait only for the orders still in flight
+                if(client.fd < 0 || (!running && client.sent.empty())){
+                    continue;
+                }
+                short events = POLLIN;
+                if(client.outOffset < client.out.size()){
+                    events |= POLLOUT;
+                }
+                polled.push_back(pollfd{client.fd, events, 0});
+                owners.push_back(&client);
+            }
+            if(polled.empty()){
+                break;
+            }
+            if(poll(polled.data(), polled.size(), 100) < 0 && errno != EINTR){
+                break;
+            }
+
+            for(size_t i = 0; i < polled.size(); i++){
+                Client& client = *owners[i];
+                bool healthy = true;
+                if(polled[i].revents & POLLOUT){
+                    ssize_t written = send(client.fd, client.out.data() + client.outOffset,
+                                           client.out.size() - client.outOffset, 0);
+                    if(written > 0){
+                        client.outOffset += written;
+                        if(client.outOffset == client.out.size()){
+                            client.out.clear();
+                            client.outOffset = 0;
+                        }
+                    } else if(written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                        healthy = false;
+                    }
+                }
+                if(healthy && (polled[i].revents & (POLLIN | POLLHUP | POLLERR))){
+                    ssize_t count = recv(client.fd, buffer, sizeof(buffer), 0);
+                    if(count > 0){
+                        client.in.append(buffer, count);
+                        healthy = receive(config, client, totals);
+                    } else if(count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+                        healthy = false;
+                    }
+                }
+                if(!healthy){
+                    close(client.fd);
+                    client.fd = -1;
+                    totals.failedConnections++;
+                }
+            }
+        }
+
+        for(Client& client : clients){
+            if(client.fd >= 0){
+                close(client.fd);
+            }
+        }
+    }
+
+
+    // Thousands of sockets need more descriptors than the usual default soft limit
+    void raiseDescriptorLimit(){
+        rlimit limit;
+        if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+
+    bool parseArgs(int argc, char** argv, Config& config){
+        if(argc < 3){
+            return false;
+        }
+        config.host = argv[1];
+        config.port = argv[2];
+        for(int i = 3; i + 1 < argc; i += 2){
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if(flag == "--connections"){
+                config.connections = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--threads"){
+                config.threads = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--seconds"){
+                config.seconds = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--pipeline"){
+                config.pipeline = std::strtoull(value.c_str(), nullptr, 10);
+            } else if(flag == "--symbol"){
+                config.symbol = value;
+            } else {
+                return false;
+            }
+        }
+        return config.connections > 0 && config.threads > 0 && config.pipeline > 0;
+    }
+}
+
+
+int main(int argc, char** argv){
+    Config config;
+    if(!parseArgs(argc, argv, config)){
+        std::cerr << "Usage: LoadClient <host> <port> [--connections N] [--threads N] [--seconds N]"
+                     " [--pipeline N] [--symbol SYM]\n";
+        return 1;
+    }
+    raiseDescriptorLimit();
+    config.threads = std::min(config.threads, config.connections);
+
+    std::string tag = std::to_string(getpid()) + "_"
+                    + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    std::vector<ThreadTotals> totals(config.threads);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    size_t first = 0;
+    for(size_t t = 0; t < config.threads; t++){
+        size_t count = config.connections / config.threads + (t < config.connections % config.threads ? 1 : 0);
+        threads.emplace_back(runThread, std::cref(config), first, count, tag, std::ref(totals[t]));
+        first += count;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(config.seconds));
+    running = false;
+    for(std::thread& thread : threads){
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ThreadTotals sum;
+    for(const ThreadTotals& part : totals){
+        sum.orders += part.orders;
+        sum.rejected += part.rejected;
+        sum.failedConnections += part.failedConnections;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Connections:      " << config.connections << " (" << sum.failedConnections << " failed)\n"
+              << "Pipeline:         " << config.pipeline << " orders per connection\n"
+              << "Orders:           " << sum.orders << " (" << sum.rejected << " rejected)\n"
+              << "Elapsed:          " << seconds << " s\n"
+              << "Orders/sec:       " << static_cast<uint64_t>(seconds > 0 ? sum.orders / seconds : 0.0) << "\n";
+    for(const HistogramSummary& latency : Metrics::histograms()){
+        if(latency.name == "LoadClient::order" && latency.count > 0){
+            std::cout << "Latency:          p50 " << latency.p50Micros << " us | p99 " << latency.p99Micros
+                      << " us | p999 " << latency.p999Micros << " us | max " << latency.maxMicros << " us\n";
+        }
+    }
+    return sum.failedConnections == 0 ? 0 : 2;
+}
@@ -0,0 +1,82 @@
+#include "../lotbook.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Generates a synthetic trade history (buys with a sell mixed in roughly every third trade
+// across a set of symbols), then reports how fast LotBook rebuilds a ledger from it under each
+// lot method and how fast incremental fills apply to a loaded user.
+//
+// Usage: LotBench [transactionCount] [symbolCount]
+
+int main(int argc, char** argv){
+    size_t transactionCount = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t symbolCount = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 50;
+
+    std::vector<std::string> symbols;
+    for(size_t i = 0; i < symbolCount; i++){
+        symbols.push_back("SYM" + std::to_string(i));
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<size_t> pickSymbol(0, symbolCount - 1);
+    std::uniform_int_distribution<int> pickQuantity(1, 100);
+    std::uniform_int_distribution<int> pickSide(0, 2);
+    std::normal_distribution<double> step(0.0, 0.5);
+
+    std::vector<TransactionRecord> history(transactionCount);
+    std::vector<double> prices(symbolCount, 100.0);
+    for(size_t i = 0; i < transactionCount; i++){
+        size_t symbol = pickSymbol(rng);
+        prices[symbol] = std::max(1.0, prices[symbol] + step(rng));
+        TransactionRecord& record = history[i];
+        record.userID = 1;
+        record.symbol = symbols[symbol];
+        record.side = (pickSide(rng) == 0) ? Side::Sell : Side::Buy;
+        record.quantity = pickQuantity(rng);
+        record.price = prices[symbol];
+        record.transactionID = static_cast<int64_t>(i + 1);
+    }
+
+    const std::pair<LotMethod, const char*> methods[] = {
+        {LotMethod::FIFO, "FIFO"}, {LotMethod::LIFO, "LIFO"}, {LotMethod::AverageCost, "AverageCost"}};
+
+    for(const auto& method : methods){
+        LotBook book(method.first);
+
+        auto rebuildStart = std::chrono::steady_clock::now();
+        size_t position = 0;
+        size_t replayed = 0;
+        book.rebuild(1, [&](TransactionRecord& record){
+            if(position == history.size()){
+                return false;
+            }
+            record = history[position++];
+            return true;
+        }, &replayed);
+        auto rebuildEnd = std::chrono::steady_clock::now();
+
+        auto applyStart = std::chrono::steady_clock::now();
+        for(const TransactionRecord& record : history){
+            if(record.side == Side::Buy){
+                book.applyBuy(1, record.symbol, record.quantity, record.price);
+            } else {
+                book.applySell(1, record.symbol, record.quantity, record.price);
+            }
+        }
+        auto applyEnd = std::chrono::steady_clock::now();
+
+        double rebuildSeconds = std::chrono::duration<double>(rebuildEnd - rebuildStart).count();
+        double applyNanos = std::chrono::duration<double, std::nano>(applyEnd - applyStart).count() / history.size();
+
+        std::cout << method.second << "\n"
+                  << "  Rebuild rows/sec:   " << static_cast<uint64_t>(replayed / rebuildSeconds) << "\n"
+                  << "  Apply avg:          " << applyNanos << " ns\n"
+                  << "  Realized P&L:       " << book.realized(1) << "\n"
+                  << "  Open symbols:       " << book.positions(1).size() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "../orderbook.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Drives a single OrderBook with a synthetic flow of passive adds, cancels and
+// marketable orders around a drifting mid price, then reports throughput and
+// the latency distribution of the calls that produced fills.
+//
+// Usage: OrderBookBench [orderCount]
+
+int main(int argc, char** argv){
+    size_t orderCount = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> action(0, 99);
+    std::uniform_int_distribution<int> offset(1, 50);
+    std::uniform_int_distribution<int> size(1, 500);
+
+    OrderBook book;
+    std::vector<Fill> fills;
+    fills.reserve(1024);
+
+    std::vector<uint64_t> live;
+    live.reserve(orderCount);
+    std::vector<double> matchLatencies;
+    matchLatencies.reserve(orderCount / 4);
+
+    int64_t mid = 10000; // $100.00
+    uint64_t nextID = 1;
+    size_t totalFills = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < orderCount; i++){
+        int roll = action(rng);
+        Side side = (roll & 1) ? Side::Buy : Side::Sell;
+
+        if(roll < 25 && !live.empty()){
+            // Cancel a random live order (it may already have been filled)
+            size_t pick = rng() % live.size();
+            book.cancelOrder(live[pick]);
+            live[pick] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        int64_t price;
+        if(roll < 85){
+            price = (side == Side::Buy) ? mid - offset(rng) : mid + offset(rng);
+        } else {
+            price = (side == Side::Buy) ? mid + offset(rng) : mid - offset(rng);
+        }
+
+        fills.clear();
+        auto t0 = std::chrono::steady_clock::now();
+        int resting = book.addOrder(nextID, 1, side, price, size(rng), fills);
+        auto t1 = std::chrono::steady_clock::now();
+
+        if(!fills.empty()){
+            matchLatencies.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            totalFills += fills.size();
+            mid = fills.back().priceTicks;
+        }
+        if(resting > 0){
+            live.push_back(nextID);
+        }
+        nextID++;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::sort(matchLatencies.begin(), matchLatencies.end());
+    auto percentile = [&](double p){
+        if(matchLatencies.empty()){
+            return 0.0;
+        }
+        size_t idx = static_cast<size_t>(p * (matchLatencies.size() - 1));
+        return matchLatencies[idx];
+    };
+
+    std::cout << "Operations:       " << orderCount << "\n"
+              << "Fills:            " << totalFills << "\n"
+              << "Resting at end:   " << book.restingOrders() << "\n"
+              << "Elapsed:          " << seconds << " s\n"
+              << "Orders/sec:       " << static_cast<uint64_t>(orderCount / seconds) << "\n"
+              << "Match p50:        " << percentile(0.50) << " ns\n"
+              << "Match p99:        " << percentile(0.99) << " ns\n";
+
+    return 0;
+}
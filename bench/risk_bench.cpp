@@ -0,0 +1,75 @@
+#include "../riskengine.h"
+#include "../metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Times RiskEngine::check with every limit switched on: first on one thread, then with each
+// thread checking orders for its own block of users, which should scale with no contention.
+// A fixed share of orders is sized to break each rule so the reject counters move.
+//
+// Usage: RiskBench [checksPerThread] [threads]
+
+namespace {
+    uint64_t runChecks(RiskEngine& engine, int firstUser, size_t checks, uint64_t& passed){
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < checks; i++){
+            RiskOrder order;
+            order.userID = firstUser + static_cast<int>(i % 1024);
+            order.side = (i % 4 == 0) ? Side::Sell : Side::Buy;
+            order.quantity = (i % 97 == 0) ? 5000 : 10;   // breaks the notional limit
+            order.price = 100.0;
+            order.buyingPower = (i % 89 == 0) ? 50.0 : 1e6;
+            order.position = (i % 83 == 0) ? 995 : 100;
+            passed += (engine.check(order) == RiskRule::None);
+        }
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv){
+    size_t checks = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    size_t threadCount = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+    RiskEngine engine;
+    RiskLimits limits;
+    limits.maxOrderNotional = 100000.0;
+    limits.maxPosition = 1000;
+    limits.maxOrdersPerSecond = 1000000;
+    engine.setDefaultLimits(limits);
+
+    uint64_t passed = 0;
+    uint64_t nanos = runChecks(engine, 0, checks, passed);
+    std::cout << "One thread:       " << static_cast<double>(nanos) / checks << " ns/check ("
+              << passed << " passed)\n";
+
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> threadNanos(threadCount);
+    std::atomic<uint64_t> threadPassed{0};
+    for(size_t t = 0; t < threadCount; t++){
+        threads.emplace_back([&, t]{
+            uint64_t local = 0;
+            threadNanos[t] = runChecks(engine, static_cast<int>((t + 1) * 1024), checks, local);
+            threadPassed += local;
+        });
+    }
+    for(std::thread& thread : threads){
+        thread.join();
+    }
+    uint64_t slowest = 0;
+    for(uint64_t value : threadNanos){
+        slowest = std::max(slowest, value);
+    }
+    std::cout << threadCount << " threads:       " << static_cast<double>(slowest) / checks << " ns/check, "
+              << static_cast<uint64_t>(checks * threadCount / (slowest / 1e9)) << " checks/sec\n";
+
+    std::cout << "Rejected:         notional " << RiskEngine::rejected(RiskRule::MaxNotional)
+              << ", position " << RiskEngine::rejected(RiskRule::MaxPosition)
+              << ", buying power " << RiskEngine::rejected(RiskRule::BuyingPower)
+              << ", rate " << RiskEngine::rejected(RiskRule::OrderRate) << "\n";
+    return 0;
+}
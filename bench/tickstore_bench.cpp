@@ -0,0 +1,76 @@
+#include "../tickstore.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Appends a synthetic random-walk tick history to a scratch file, then reports
+// append throughput, full-scan throughput (summing prices and volumes) and the
+// cost of seeking to random timestamps.
+//
+// Usage: TickStoreBench [tickCount] [path]
+
+int main(int argc, char** argv){
+    size_t tickCount = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    std::string path = (argc > 2) ? argv[2] : "tickstore_bench.ticks";
+    std::remove(path.c_str());
+
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> step(0.0, 0.05);
+    std::uniform_int_distribution<int64_t> volume(1, 10000);
+
+    int64_t firstTimestamp = 1700000000000000000LL;
+    int64_t timestamp = firstTimestamp;
+    double price = 100.0;
+
+    auto appendStart = std::chrono::steady_clock::now();
+    {
+        TickWriter writer(path);
+        for(size_t i = 0; i < tickCount; i++){
+            timestamp += 1000000; // 1 ms apart
+            price += step(rng);
+            writer.append(timestamp, price, volume(rng));
+        }
+        writer.flush();
+    }
+    auto appendEnd = std::chrono::steady_clock::now();
+
+    TickReader reader(path);
+
+    auto scanStart = std::chrono::steady_clock::now();
+    double priceSum = 0;
+    int64_t volumeSum = 0;
+    size_t scanned = 0;
+    reader.scan(INT64_MIN, INT64_MAX, [&](const TickSpan& span){
+        for(size_t i = 0; i < span.count; i++){
+            priceSum += span.prices[i];
+            volumeSum += span.volumes[i];
+        }
+        scanned += span.count;
+    });
+    auto scanEnd = std::chrono::steady_clock::now();
+
+    size_t seekCount = 1000000;
+    std::uniform_int_distribution<int64_t> target(firstTimestamp, timestamp);
+    uint64_t seekChecksum = 0;
+    auto seekStart = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < seekCount; i++){
+        seekChecksum += reader.seek(target(rng));
+    }
+    auto seekEnd = std::chrono::steady_clock::now();
+
+    double appendSeconds = std::chrono::duration<double>(appendEnd - appendStart).count();
+    double scanSeconds = std::chrono::duration<double>(scanEnd - scanStart).count();
+    double seekNanos = std::chrono::duration<double, std::nano>(seekEnd - seekStart).count() / seekCount;
+
+    std::cout << "Ticks:            " << reader.size() << "\n"
+              << "Appends/sec:      " << static_cast<uint64_t>(tickCount / appendSeconds) << "\n"
+              << "Scanned:          " << scanned << " (checksum " << priceSum << ", " << volumeSum << ")\n"
+              << "Scan ticks/sec:   " << static_cast<uint64_t>(scanned / scanSeconds) << "\n"
+              << "Seek avg:         " << seekNanos << " ns (checksum " << seekChecksum << ")\n";
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -4,489 +4,1369 @@
 #include <unordered_map>
 #include <fstream>
 #include <thread>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+
+namespace {
+    // One latency histogram per public entry point; trivial accessors are left untimed
+    const size_t CONNECT_LATENCY = Metrics::histogram("Database::connect");
+    const size_t CREATE_USER_LATENCY = Metrics::histogram("Database::createUser");
+    const size_t LOGIN_USER_LATENCY = Metrics::histogram("Database::loginUser");
+    const size_t GET_BALANCE_LATENCY = Metrics::histogram("Database::getBalance");
+    const size_t DEPOSIT_MONEY_LATENCY = Metrics::histogram("Database::depositMoney");
+    const size_t WITHDRAW_MONEY_LATENCY = Metrics::histogram("Database::withdrawMoney");
+    const size_t BUY_STOCK_LATENCY = Metrics::histogram("Database::buyStock");
+    const size_t SELL_STOCK_LATENCY = Metrics::histogram("Database::sellStock");
+    const size_t SUBMIT_BATCH_LATENCY = Metrics::histogram("Database::submitBatch");
+    const size_t PLACE_LIMIT_ORDER_LATENCY = Metrics::histogram("Database::placeLimitOrder");
+    const size_t CANCEL_ORDER_LATENCY = Metrics::histogram("Database::cancelOrder");
+    const size_t VIEW_PORTFOLIO_LATENCY = Metrics::histogram("Database::viewPortfolio");
+    const size_t VIEW_TRANSACTIONS_LATENCY = Metrics::histogram("Database::viewTransactions");
+    const size_t VIEW_PNL_LATENCY = Metrics::histogram("Database::viewPnL");
+    const size_t LOAD_LOTS_LATENCY = Metrics::histogram("Database::loadLots");
+    const size_t REBUILD_POSITIONS_LATENCY = Metrics::histogram("Database::rebuildPositions");
+    const size_t ENABLE_JOURNAL_LATENCY = Metrics::histogram("Database::enableJournal");
+    const size_t UPDATE_STOCK_PRICES_LATENCY = Metrics::histogram("Database::updateStockPrices");
+    const size_t INGEST_QUOTES_LATENCY = Metrics::histogram("Database::ingestQuotes");
+    const size_t PUBLISH_PRICES_LATENCY = Metrics::histogram("Database::publishPrices");
+    const size_t GET_SENTIMENT_LATENCY = Metrics::histogram("Database::getSentiment");
+    const size_t RETURN_STOCKS_LATENCY = Metrics::histogram("Database::returnStocks");
+
+    // Versioned writes that lose to another session this many times in a row give up
+    constexpr int MAX_STALE_RETRIES = 8;
+}
 
 
-void Database::connect(const std::string& url){
-    if(session){
+void Database::connect(const std::string& url, size_t poolSize, bool refreshOnConnect){
+    LatencyTimer timer(CONNECT_LATENCY);
+    if(storage){
         std::cerr << "Session already exists. Please close it before creating a new one." << std::endl;
         return;
     }
-    session = std::make_unique<mysqlx::Session>(url); //needed to use std::make_unique to initialize session
-    if(session){
-        std::cout << "SESSION FOUND" << std::endl;
-    }
-    schema = std::make_unique<mysqlx::Schema>(session->getSchema("trading", true)); //createSchema
-    std::thread updateStocksThread (&Database::updateStockPrices, this); // Update stock prices on connection
-    updateStocksThread.detach();
-}
+    storage = openStorage(url, poolSize);
 
-mysqlx::Schema &Database::getSchema() const{
-    return *schema;
-}
+    // First run against an existing database: materialize positions from the history
+    for(int userID : storage->tradersMissingPositions()){
+        rebuildPositions(userID);
+    }
 
+    loadPrices();
 
-mysqlx::Table Database::getTable(const std::string & name){
-    return schema->getTable(name);
+    if(refreshOnConnect){
+        std::thread updateStocksThread (&Database::updateStockPrices, this); // Update stock prices on connection
+        updateStocksThread.detach();
+    }
 }
 
+
 Database::~Database(){
-    if(session){
-        session ->close();
-    }
+    // Apply what the journal still holds while the storage it writes into is alive
+    journal.reset();
 }
 
 Database::Database() 
 {
-    // Constructor body is empty because the schema will be initialized when connect() is called
+    // Constructor body is empty because storage is opened when connect() is called
 }
 
 
 
 int Database::createUser(const std::string& username, const std::string& password) {
-    // Get the Users table
-    mysqlx::Table users = schema->getTable("Users");
+    LatencyTimer timer(CREATE_USER_LATENCY);
+    return storage->createUser(username, password);
+}
+
 
-    // Check if the user already exists
-    mysqlx::RowResult check = users.select("Username")
-                                      .where("Username = :username")
-                                      .bind("username", username)
-                                      .execute();
-    if(check.count()>0){
-        throw std::runtime_error("User already exists with the given username.");
+int Database::loginUser (const std::string& username, const std::string& password){
+    LatencyTimer timer(LOGIN_USER_LATENCY);
+    AccountVersion account;
+    int userID = storage->findUser(username, password, account);
+    if(userID < 0){
+        throw std::runtime_error("Invalid username or password.");
     }
+    // The same read warms the cache, so the first trade skips a balance lookup
+    accounts.store(userID, account);
+    return userID;
+}
 
 
+std::string Database::startSession(const std::string& username, const std::string& password){
+    return accounts.openSession(loginUser(username, password));
+}
 
-    // Insert new user with default balance of 0.0
-    users.insert("Username", "Password", "Balance")
-         .values(username, password, 0.0)
-         .execute();
 
-    // Retrieve the newly created user's ID
-    mysqlx::RowResult result = users.select("UserID")
-                                 .where("Username = :username AND Password = :password")
-                                 .bind("username", username)
-                                 .bind("password", password)
-                                 .execute();
+int Database::sessionUser(const std::string& token){
+    int userID = accounts.sessionUser(token);
+    if(userID < 0){
+        throw std::runtime_error("Session not found or already ended.");
+    }
+    return userID;
+}
 
-    mysqlx::Row row = result.fetchOne();
 
-    if (!row.isNull()) {
-        return row[0].get<int>(); // Return the UserID
-    } else {
-        throw std::runtime_error("Failed to retrieve newly created user.");
-    }
+void Database::endSession(const std::string& token){
+    accounts.closeSession(token);
 }
 
 
-int Database::loginUser (const std::string& username, const std::string& password){
-    mysqlx::Table users = schema->getTable("Users");
+double Database::getBalance (int userID){
+    LatencyTimer timer(GET_BALANCE_LATENCY);
+    if(journal){
+        std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+        return cachedBalance(userID);
+    }
+    // Reflects every write made through this process; another process's deposit shows up once
+    // a write here comes back stale
+    return accountOf(userID).balance;
+}
 
-    mysqlx::RowResult check = users.select("UserID")
-                                .where("Username = :username AND Password = :password")
-                                .bind("username", username)
-                                .bind("password", password)
-                                .execute();
 
-    mysqlx::Row row = check.fetchOne();
+double Database::storedBalance (int userID){
+    AccountVersion account;
+    if(!storage->account(userID, account)){
+        throw std::runtime_error("User not found.");
+    }
+    return account.balance;
+}
+
 
-    if(row.isNull()){
-        throw std::runtime_error("Invalid username or password.");
+AccountVersion Database::accountOf(int userID){
+    AccountVersion account;
+    if(accounts.read(userID, account)){
+        return account;
     }
-    else{
-        return row.get(0);
+    if(!storage->account(userID, account)){
+        throw std::runtime_error("User not found.");
     }
-
+    accounts.store(userID, account);
+    return account;
 }
 
 
-double Database::getBalance (int userID){
-    mysqlx::Table users = schema->getTable("Users");
+int Database::writeAccount(int userID, double required, const std::function<int(AccountVersion&)>& write){
+    AccountVersion account = accountOf(userID);
+    bool confirmed = false;
+    for(int attempt = 0; attempt < MAX_STALE_RETRIES; attempt++){
+        // The cache can only be short if another process added money; one read settles it
+        // before the request is turned away
+        if(required > account.balance && !confirmed){
+            if(!storage->account(userID, account)){
+                accounts.forget(userID);
+                return TRADE_USER_NOT_FOUND;
+            }
+            accounts.store(userID, account);
+            confirmed = true;
+        }
+        if(required > account.balance){
+            return TRADE_INSUFFICIENT;
+        }
 
-    mysqlx::RowResult result = users.select("Balance")
-                                .where("UserID = :userID")
-                                .bind("userID", userID)
-                                .execute();
+        int status = write(account);
+        if(status == TRADE_USER_NOT_FOUND){
+            accounts.forget(userID);
+            return status;
+        }
+        accounts.store(userID, account);
+        if(status != TRADE_STALE){
+            return status;
+        }
+        confirmed = true;   // a stale write reports the stored state
+    }
+    throw std::runtime_error("The account kept changing during this request; try again.");
+}
 
 
+void Database::depositMoney(int userID, double amount){
+    LatencyTimer timer(DEPOSIT_MONEY_LATENCY);
+    if(amount <=0){
+        throw std::runtime_error("Deposit amount must be positive.");
+    }
+    if(journal){
+        uint64_t sequence;
+        {
+            std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+            sequence = enqueueCash(userID, JournalEntry::Deposit, amount);
+        }
+        awaitDurable(sequence, {userID});
+        return;
+    }
+
+    int status = writeAccount(userID, 0.0, [&](AccountVersion& account){
+        return storage->adjustBalance(userID, amount, account);
+    });
+    if(status == TRADE_USER_NOT_FOUND){
+        throw std::runtime_error("User not found.");
+    }
+}
 
-    mysqlx::Row row = result.fetchOne();
+void Database::withdrawMoney (int userId, double amount){
+    LatencyTimer timer(WITHDRAW_MONEY_LATENCY);
+    if(amount <=0){
+        throw std::runtime_error("Withdrawal amount must be positive.");
+    }
+    if(journal){
+        uint64_t sequence;
+        {
+            std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+            sequence = enqueueCash(userId, JournalEntry::Withdraw, amount);
+        }
+        awaitDurable(sequence, {userId});
+        return;
+    }
 
-    if(row.isNull()){
+    int status = writeAccount(userId, amount, [&](AccountVersion& account){
+        return storage->adjustBalance(userId, -amount, account);
+    });
+    if(status == TRADE_USER_NOT_FOUND){
         throw std::runtime_error("User not found.");
     }
-    else{
-        return row.get(0);
+    if(status == TRADE_INSUFFICIENT){
+        throw std::runtime_error("Insufficient funds for withdrawal.");
+    }
+}
+
+
+void Database::buyStock (int userID, const std::string& stockSymbol, int quantity){
+    LatencyTimer timer(BUY_STOCK_LATENCY);
+    if (quantity <= 0) {
+        throw std::runtime_error("Quantity to buy must be positive.");
     }
 
+    auto call = storage->beginCall();
+    double price = priceOf(stockSymbol);
+    checkRisk(userID, stockSymbol, Side::Buy, quantity, price);
+    tradeAtPrice(userID, stockSymbol, Side::Buy, quantity, price);
+
 }
 
 
-void Database::depositMoney(int userID, double amount){
-    if(amount <=0){
-        throw std::runtime_error("Deposit amount must be positive.");
+void Database::sellStock (int userID, const std::string& stockSymbol, int quantity){
+    LatencyTimer timer(SELL_STOCK_LATENCY);
+    if (quantity <= 0) {
+        throw std::runtime_error("Quantity to sell must be positive.");
     }
 
-    mysqlx::Table users = schema->getTable("Users");
+    auto call = storage->beginCall();
 
-    mysqlx::RowResult result = users.select("Balance")
-                                .where("UserID = :userID")
-                                .bind("userID", userID)
-                                .execute();
+    // Fail fast from the mirror; storage re-checks against the locked position
+    if(heldQuantity(userID, stockSymbol) < quantity){
+        throw std::runtime_error("Insufficient stock to sell.");
+    }
 
-    auto row = result.fetchOne();
+    double price = priceOf(stockSymbol);
+    checkRisk(userID, stockSymbol, Side::Sell, quantity, price);
+    tradeAtPrice(userID, stockSymbol, Side::Sell, quantity, price);
 
-    if(row.isNull()){
-        throw std::runtime_error("User not found.");
+}
+
+
+void Database::checkRisk(int userID, const std::string& stockSymbol, Side side, int quantity, double price){
+    RiskOrder order;
+    order.userID = userID;
+    order.side = side;
+    order.quantity = quantity;
+    order.price = price;
+
+    // Only gather the account state a rule will actually look at
+    if(side == Side::Buy){
+        RiskLimits limits = risk.limitsFor(userID);
+        if(limits.checkBuyingPower && journal){
+            std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+            order.buyingPower = cachedBalance(userID);
+        } else if(limits.checkBuyingPower){
+            AccountVersion account = accountOf(userID);
+            // As in writeAccount: the cache can only be short if another process added money, so
+            // confirm with one read before the rule turns the order away
+            if(price * quantity > account.balance){
+                if(!storage->account(userID, account)){
+                    throw std::runtime_error("User not found.");
+                }
+                accounts.store(userID, account);
+            }
+            order.buyingPower = account.balance;
+        }
+        if(limits.maxPosition > 0){
+            order.position = heldQuantity(userID, stockSymbol);
+        }
     }
-    else{
-        double currentBalance = row.get(0);
-        double newBalance  = currentBalance + amount; 
-        users.update()
-                .set("Balance", newBalance)
-                .where("UserID = :userID")
-                .bind("userID", userID)
-                .execute();
+
+    RiskRule rule = risk.check(order);
+    if(rule != RiskRule::None){
+        throw std::runtime_error(RiskEngine::describe(rule));
     }
 }
 
-void Database::withdrawMoney (int userId, double amount){
-    if(amount <=0){
-        throw std::runtime_error("Withdrawal amount must be positive.");
+
+void Database::tradeAtPrice(int userID, const std::string& stockSymbol, Side side, int quantity, double price){
+    if(journal){
+        uint64_t sequence;
+        {
+            std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+            sequence = enqueueTrade(userID, stockSymbol, side, quantity, price);
+        }
+        awaitDurable(sequence, {userID});
+        return;
     }
 
-    mysqlx::Table users = schema->getTable("Users");
+    auto call = storage->beginCall();
+    loadPositions(userID);
+    PositionBook::PendingFill pendingPositions(positions, {userID});
+    LotBook::PendingFill pending(lots, {userID});
 
-    mysqlx::RowResult result = users.select("Balance")
-                                .where("UserID = :userID")
-                                .bind("userID", userId)
-                                .execute();
-    
-    auto row = result.fetchOne();
+    // Funds are checked against the cached balance first; storage re-checks at the cached version
+    int status = writeAccount(userID, (side == Side::Buy) ? price * quantity : 0.0, [&](AccountVersion& account){
+        return storage->trade(userID, stockSymbol, side, quantity, price, account);
+    });
+    if(status == TRADE_USER_NOT_FOUND){
+        throw std::runtime_error("User not found");
+    }
+    if(status == TRADE_INSUFFICIENT){
+        if(side == Side::Buy){
+            throw TradeRejected(userID, "Insufficient funds to buy stock.");
+        }
+        // Another session sold first; drop the stale mirrors so the next read reloads them
+        positions.unload(userID);
+        lots.unload(userID);
+        throw TradeRejected(userID, "Insufficient stock to sell.");
+    }
 
-    if(row.isNull()){
-        throw std::runtime_error("User not found.");
+    if(side == Side::Buy){
+        positions.applyBuy(userID, stockSymbol, quantity, price);
+        lots.applyBuy(userID, stockSymbol, quantity, price);
+    } else {
+        positions.applySell(userID, stockSymbol, quantity);
+        lots.applySell(userID, stockSymbol, quantity, price);
     }
+}
+
+
+std::vector<OrderResult> Database::submitBatch(int userID, const std::vector<Order>& orders){
+    LatencyTimer timer(SUBMIT_BATCH_LATENCY);
+    std::vector<OrderResult> results(orders.size());
+    if(orders.empty()){
+        return results;
+    }
+
+    // Validates against storage, so storage must hold every journaled change and no new ones
+    // may land until this commits; the cached balance is reloaded afterwards
+    std::unique_lock<std::recursive_mutex> ledgerLock(ledgerMutex, std::defer_lock);
+    if(journal){
+        ledgerLock.lock();
+        journal->drain();
+        balances.erase(userID);
+    }
+
+    auto call = storage->beginCall();
+    loadPositions(userID);
 
-    else{
-        double currentBalance = row.get(0);
-        if(currentBalance < amount){
-            throw std::runtime_error("Insufficient funds for withdrawal.");
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, size_t> symbolIndex;
+    for(const Order& order : orders){
+        if(symbolIndex.emplace(order.symbol, symbols.size()).second){
+            symbols.push_back(order.symbol);
         }
-        double newBalance = currentBalance - amount;
+    }
 
-        users.update()
-                .set("Balance", newBalance)
-                .where("UserID = :userId")
-                .bind("userId", userId)
-                .execute();
+    // Every leg is priced from the same in-process snapshot, no Stocks round trip
+    std::unordered_map<std::string, double> prices;
+    for(const std::string& symbol : symbols){
+        double price;
+        if(lookupPrice(symbol, price)){
+            prices[symbol] = price;
+        }
+    }
 
+    // Pre-trade limits per leg, against the in-memory balance and positions with the earlier legs
+    // applied as the storage pass below applies them; a leg a rule refuses never reaches storage
+    std::vector<RiskRule> refused(orders.size(), RiskRule::None);
+    RiskLimits limits = risk.limitsFor(userID);
+    double balance = 0.0;
+    double change = 0.0;   // what the legs passed so far add to the balance
+    bool confirmed = journal != nullptr;   // the ledger balance was just reloaded from storage
+    if(limits.checkBuyingPower){
+        balance = journal ? cachedBalance(userID) : accountOf(userID).balance;
     }
-    
+    std::unordered_map<std::string, int> held;
+    for(size_t i = 0; i < orders.size(); i++){
+        const Order& order = orders[i];
+        auto price = prices.find(order.symbol);
+        if(order.quantity <= 0 || price == prices.end()){
+            continue;   // reported by the storage pass
+        }
+        double notional = price->second * order.quantity;
+        auto position = held.find(order.symbol);
+        if(position == held.end()){
+            position = held.emplace(order.symbol, positions.quantity(userID, order.symbol)).first;
+        }
 
-}
+        // As in checkRisk: the cache can only be short if another process added money
+        if(order.side == Side::Buy && limits.checkBuyingPower && notional > balance + change && !confirmed){
+            AccountVersion account;
+            if(!storage->account(userID, account)){
+                throw std::runtime_error("User not found.");
+            }
+            accounts.store(userID, account);
+            balance = account.balance;
+            confirmed = true;
+        }
 
+        RiskOrder riskOrder;
+        riskOrder.userID = userID;
+        riskOrder.side = order.side;
+        riskOrder.quantity = order.quantity;
+        riskOrder.price = price->second;
+        riskOrder.buyingPower = balance + change;
+        riskOrder.position = position->second;
+        refused[i] = risk.check(riskOrder);
+        if(refused[i] != RiskRule::None){
+            continue;
+        }
+        if(order.side == Side::Buy){
+            change -= notional;
+            position->second += order.quantity;
+        } else if(position->second >= order.quantity){
+            change += notional;
+            position->second -= order.quantity;
+        }
+    }
 
-void Database::buyStock (int userID, const std::string& stockSymbol, int quantity){
-    mysqlx::Table users = schema->getTable("Users");
-    mysqlx::Table stocks = schema->getTable("Stocks");
-    mysqlx::Table transactions = schema->getTable("Transactions");
-
-    // Check if user exists
-    mysqlx::RowResult userCheck = users.select("UserID")
-                                        .where("UserID = :userID")
-                                        .bind("userID", userID)
-                                        .execute();
-    
-    mysqlx::Row userRow = userCheck.fetchOne();
-
-    if(userRow.isNull()){
-        throw std::runtime_error("User not found");
+    // Validate every leg against the locked balance and positions, applying accepted legs as we go
+    PositionBook::PendingFill pendingPositions(positions, {userID});
+    LotBook::PendingFill pending(lots, {userID});
+    std::unordered_map<std::string, Position> committed;
+    storage->transact({userID}, symbols, [&](std::unordered_map<int, AccountState>& accounts,
+                                             std::vector<TransactionRecord>& trades){
+        AccountState& account = accounts[userID];
+        for(size_t i = 0; i < orders.size(); i++){
+            const Order& order = orders[i];
+            OrderResult& result = results[i];
+
+            auto price = prices.find(order.symbol);
+            if(order.quantity <= 0){
+                result.error = "Quantity must be positive.";
+                continue;
+            }
+            if(price == prices.end()){
+                result.error = "Stock not found with the given symbol.";
+                continue;
+            }
+            if(refused[i] != RiskRule::None){
+                result.error = RiskEngine::describe(refused[i]);
+                continue;
+            }
+
+            double notional = price->second * order.quantity;
+            Position& position = account.positions[order.symbol];
+
+            if(order.side == Side::Buy){
+                if(notional > account.balance){
+                    result.error = "Insufficient funds to buy stock.";
+                    continue;
+                }
+                account.balance -= notional;
+                position.quantity += order.quantity;
+                position.costBasis += notional;
+            } else {
+                if(position.quantity < order.quantity){
+                    result.error = "Insufficient stock to sell.";
+                    continue;
+                }
+                account.balance += notional;
+                position.costBasis -= position.costBasis * order.quantity / position.quantity;
+                position.quantity -= order.quantity;
+            }
+
+            result.accepted = true;
+            result.price = price->second;
+            committed[order.symbol] = position;
+            trades.push_back(TransactionRecord{userID, order.symbol, order.side, order.quantity, price->second, ""});
+        }
+        return !trades.empty();
+    });
+
+    // transact wrote the balance without going through the cache
+    accounts.forget(userID);
+    for(auto& entry : committed){
+        positions.set(userID, entry.first, entry.second);
+    }
+    for(size_t i = 0; i < orders.size(); i++){
+        if(!results[i].accepted){
+            continue;
+        }
+        if(orders[i].side == Side::Buy){
+            lots.applyBuy(userID, orders[i].symbol, orders[i].quantity, results[i].price);
+        } else {
+            lots.applySell(userID, orders[i].symbol, orders[i].quantity, results[i].price);
+        }
     }
 
-    double userBalance = getBalance(userID);
+    return results;
+}
 
-    // Get stock price and check if stock exists
 
-    mysqlx::RowResult stockPrice = stocks.select("StockPrice")
-                                        .where("Symbol = :stockSymbol")
-                                        .bind("stockSymbol", stockSymbol)
-                                        .execute();
-    
-    mysqlx::Row stockRow = stockPrice.fetchOne();
+void Database::loadPositions(int userID){
+    if(positions.isLoaded(userID)){
+        return;
+    }
 
-    if(stockRow.isNull()){
-        throw std::runtime_error("Stock not found with the given symbol.");
+    // Positions rows only match the ledger once the journal has been applied
+    std::unique_lock<std::recursive_mutex> ledgerLock(ledgerMutex, std::defer_lock);
+    if(journal){
+        ledgerLock.lock();
+        if(positions.isLoaded(userID)){
+            return;
+        }
+        journal->drain();
     }
 
-    double stockPriceValue = (double) stockRow.get(0);
+    // Without the journal nothing holds fills back, so a load that overlapped one is redone
+    for(int attempt = 0; attempt < MAX_STALE_RETRIES; attempt++){
+        uint64_t generation = positions.generation(userID);
+        if(positions.load(userID, storage->positions(userID), generation)){
+            return;
+        }
+    }
+    throw std::runtime_error("The account kept changing during this request; try again.");
+}
 
 
-    // Check if user has enough balance
+void Database::loadLots(int userID){
+    if(lots.isLoaded(userID)){
+        return;
+    }
+    LatencyTimer timer(LOAD_LOTS_LATENCY);
+
+    // Held across the replay so no journaled fill lands between the history read and the install
+    std::unique_lock<std::recursive_mutex> ledgerLock(ledgerMutex, std::defer_lock);
+    if(journal){
+        ledgerLock.lock();
+        if(lots.isLoaded(userID)){
+            return;
+        }
+        journal->drain();
+    }
 
-    if(stockPriceValue * quantity > userBalance){
-        throw std::runtime_error("Insufficient funds to buy stock.");
+    // Without the journal nothing holds fills back, so a rebuild that overlapped one is redone
+    for(int attempt = 0; attempt < MAX_STALE_RETRIES; attempt++){
+        TransactionCursor history = transactionCursor(userID, TransactionFilter(), HISTORY_PAGE_ROWS * 8);
+        if(lots.rebuild(userID, [&history](TransactionRecord& record){ return history.next(record); })){
+            return;
+        }
     }
+    throw std::runtime_error("The account kept changing during this request; try again.");
+}
 
 
-    //Deduct amount from user balance  
+int Database::heldQuantity(int userID, const std::string& stockSymbol){
+    loadPositions(userID);
+    return positions.quantity(userID, stockSymbol);
+}
 
-    withdrawMoney (userID, stockPriceValue * quantity);
 
+int Database::rebuildPositions(int userID){
+    LatencyTimer timer(REBUILD_POSITIONS_LATENCY);
+    std::unique_lock<std::recursive_mutex> ledgerLock(ledgerMutex, std::defer_lock);
+    if(journal){
+        ledgerLock.lock();
+        journal->drain();
+    }
 
-    // Insert transaction record
+    // Replay the history in order so average-cost relief matches the live write path
+    uint64_t generation = positions.generation(userID);
+    TransactionCursor history = transactionCursor(userID);
+
+    std::unordered_map<std::string, Position> rebuilt;
+    TransactionRecord record;
+    while(history.next(record)){
+        Position& position = rebuilt[record.symbol];
+        if(record.side == Side::Buy){
+            position.quantity += record.quantity;
+            position.costBasis += record.price * record.quantity;
+        } else if(position.quantity > 0){
+            int relievedQuantity = std::min(record.quantity, position.quantity);
+            position.costBasis -= position.costBasis * relievedQuantity / position.quantity;
+            position.quantity -= relievedQuantity;
+        }
+    }
+
+    for(auto iter = rebuilt.begin(); iter != rebuilt.end();){
+        if(iter->second.quantity == 0){
+            iter = rebuilt.erase(iter);
+        } else {
+            iter++;
+        }
+    }
 
-    transactions.insert("UserID", "Symbol", "Quantity", "PriceAtTransaction", "Type")
-                .values(userID, stockSymbol, quantity, stockPriceValue, "Buy")
-                .execute();
+    // Compare against what is stored before overwriting it
+    int mismatches = 0;
+    std::unordered_map<std::string, int> storedQuantities;
+    for(auto& entry : storage->positions(userID)){
+        storedQuantities[entry.first] = entry.second.quantity;
+    }
+    for(auto& entry : rebuilt){
+        auto found = storedQuantities.find(entry.first);
+        int storedQuantity = (found == storedQuantities.end()) ? 0 : found->second;
+        if(storedQuantity != entry.second.quantity){
+            std::cout << "Position mismatch for " << entry.first << ": stored " << storedQuantity
+                      << ", recomputed " << entry.second.quantity << "\n";
+            mismatches++;
+        }
+        storedQuantities.erase(entry.first);
+    }
+    for(auto& entry : storedQuantities){
+        std::cout << "Position mismatch for " << entry.first << ": stored " << entry.second
+                  << ", recomputed 0\n";
+        mismatches++;
+    }
 
+    storage->replacePositions(userID, rebuilt);
+    // A fill overlapped the rebuild; the next access reads what storage holds now
+    if(!positions.load(userID, std::move(rebuilt), generation)){
+        positions.unload(userID);
+    }
+    lots.unload(userID);
+    return mismatches;
 }
 
 
-void Database::sellStock (int userID, const std::string& stockSymbol, int quantity){
+uint64_t Database::placeLimitOrder (int userID, const std::string& stockSymbol, Side side, int quantity, double limitPrice){
+    LatencyTimer timer(PLACE_LIMIT_ORDER_LATENCY);
     if (quantity <= 0) {
-        throw std::runtime_error("Quantity to sell must be positive.");
+        throw std::runtime_error("Order quantity must be positive.");
+    }
+    if (limitPrice <= 0) {
+        throw std::runtime_error("Limit price must be positive.");
     }
 
+    auto call = storage->beginCall();
+    priceOf(stockSymbol); // throws if the symbol is unknown
 
-    mysqlx::Table users = schema->getTable("Users");
-    mysqlx::Table stocks = schema->getTable("Stocks");
-    mysqlx::Table transactions = schema->getTable("Transactions");
+    // Pre-trade checks use the limit price, the worst price this order can fill at.
+    // Funds and shares are not reserved, persistFill re-checks them when a fill lands.
 
-    // Check if user exists
-    mysqlx::RowResult userCheck = users.select("UserID")
-                                        .where("UserID = :userID")
-                                        .bind("userID", userID)
-                                        .execute();
-    
-    mysqlx::Row userRow = userCheck.fetchOne();
+    if(side == Side::Sell && heldQuantity(userID, stockSymbol) < quantity){
+        throw std::runtime_error("Insufficient stock to sell.");
+    }
+    checkRisk(userID, stockSymbol, side, quantity, limitPrice);
+
+    std::vector<Fill> fills;
+    uint64_t orderID = engine.submitLimit(stockSymbol, userID, side, limitPrice, quantity, fills);
+
+    int filled = 0;
+    size_t failed = fills.size();   // first fill this order could not settle
+    std::string reason;
+    for(size_t i = 0; i < fills.size(); i++){
+        Fill fill = fills[i];   // extend below can grow `fills`
+        try{
+            persistFill(stockSymbol, fill);
+            filled += fill.quantity;
+        } catch (const TradeRejected& e){
+            if(e.userID == userID){
+                failed = i;
+                reason = e.what();
+                break;
+            }
+            // The maker can no longer back its order, so the rest of it goes too; the shares
+            // it would have filled go back into this order and match against what is left
+            engine.cancel(fill.makerUserID, fill.makerOrderID);
+            notifyOrder(OrderNotice{fill.makerUserID, fill.makerOrderID, stockSymbol, fill.quantity, false, e.what()});
+            engine.extend(stockSymbol, orderID, userID, side, limitPrice, fill.quantity, fills);
+        } catch (const std::exception& e){
+            failed = i;
+            reason = e.what();
+            break;
+        }
+    }
 
-    if(userRow.isNull()){
-        throw std::runtime_error("User not found");
+    if(failed < fills.size()){
+        // Pull this order first so its remainder cannot cross the makers going back in front of it
+        engine.cancel(userID, orderID);
+        for(size_t i = fills.size(); i-- > failed;){
+            engine.restore(stockSymbol, fills[i]);
+        }
+        throw std::runtime_error("Order " + std::to_string(orderID) + " filled " + std::to_string(filled) + " of "
+                                 + std::to_string(quantity) + " shares and the rest was cancelled: " + reason);
     }
+    return orderID;
+}
 
-    double userBalance = getBalance(userID);
 
-    // Get stock price and check if stock exists
+void Database::cancelOrder (int userID, uint64_t orderID){
+    LatencyTimer timer(CANCEL_ORDER_LATENCY);
+    if(!engine.cancel(userID, orderID)){
+        throw std::runtime_error("No open order with the given ID.");
+    }
+}
 
-    mysqlx::RowResult stockPrice = stocks.select("StockPrice")
-                                        .where("Symbol = :stockSymbol")
-                                        .bind("stockSymbol", stockSymbol)
-                                        .execute();
-    
-    mysqlx::Row stockRow = stockPrice.fetchOne();
 
-    if(stockRow.isNull()){
-        throw std::runtime_error("Stock not found with the given symbol.");
+void Database::persistFill(const std::string& stockSymbol, const Fill& fill){
+    int buyerID = (fill.takerSide == Side::Buy) ? fill.takerUserID : fill.makerUserID;
+    int sellerID = (fill.takerSide == Side::Buy) ? fill.makerUserID : fill.takerUserID;
+    double price = fromTicks(fill.priceTicks);
+    double notional = price * fill.quantity;
+
+    if(journal){
+        uint64_t sequence;
+        {
+            // Both legs are checked before either is queued, so the journal never holds half a fill
+            std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+            loadPositions(sellerID);
+            if(positions.quantity(sellerID, stockSymbol) < fill.quantity){
+                throw TradeRejected(sellerID, "Seller no longer holds enough stock for this fill.");
+            }
+            if(cachedBalance(buyerID) < notional){
+                throw TradeRejected(buyerID, "Insufficient funds to buy stock.");
+            }
+            JournalRecord bought = checkTrade(buyerID, stockSymbol, Side::Buy, fill.quantity, price);
+            JournalRecord sold = checkTrade(sellerID, stockSymbol, Side::Sell, fill.quantity, price);
+            sequence = journal->enqueue(std::vector<JournalRecord>{bought, sold});
+            applyTrade(bought);
+            applyTrade(sold);
+        }
+        awaitDurable(sequence, {buyerID, sellerID});
+        fillCount++;
+        return;
+    }
+
+    auto call = storage->beginCall();
+    loadPositions(buyerID);
+    loadPositions(sellerID);
+    PositionBook::PendingFill pendingPositions(positions, {buyerID, sellerID});
+    LotBook::PendingFill pending(lots, {buyerID, sellerID});
+
+    // Both legs are checked against the locked rows and commit together or not at all
+    try{
+        storage->transact({buyerID, sellerID}, {stockSymbol}, [&](std::unordered_map<int, AccountState>& accounts,
+                                                                   std::vector<TransactionRecord>& trades){
+            Position& sold = accounts[sellerID].positions[stockSymbol];
+            if(sold.quantity < fill.quantity){
+                throw TradeRejected(sellerID, "Seller no longer holds enough stock for this fill.");
+            }
+            AccountState& buyer = accounts[buyerID];
+            if(buyer.balance < notional){
+                throw TradeRejected(buyerID, "Insufficient funds to buy stock.");
+            }
+
+            buyer.balance -= notional;
+            accounts[sellerID].balance += notional;
+            addToPosition(buyer.positions[stockSymbol], fill.quantity, price);
+            relievePosition(sold, fill.quantity);
+
+            trades.push_back(TransactionRecord{buyerID, stockSymbol, Side::Buy, fill.quantity, price, ""});
+            trades.push_back(TransactionRecord{sellerID, stockSymbol, Side::Sell, fill.quantity, price, ""});
+            return true;
+        });
+    } catch (...){
+        // The mirror may have been stale; reload both on next use
+        positions.unload(buyerID);
+        positions.unload(sellerID);
+        lots.unload(buyerID);
+        lots.unload(sellerID);
+        throw;
     }
+    accounts.forget(buyerID);
+    accounts.forget(sellerID);
+
+    positions.applyBuy(buyerID, stockSymbol, fill.quantity, price);
+    positions.applySell(sellerID, stockSymbol, fill.quantity);
+    lots.applyBuy(buyerID, stockSymbol, fill.quantity, price);
+    lots.applySell(sellerID, stockSymbol, fill.quantity, price);
+    fillCount++;
+}
+
 
-    double stockPriceValue = (double) stockRow.get(0);
+void Database::persistMarketFill(const std::string& stockSymbol, const Fill& fill){
+    // The market took the other side, so the resting order's owner trades like a market order
+    Side side = (fill.takerSide == Side::Buy) ? Side::Sell : Side::Buy;
+    tradeAtPrice(fill.makerUserID, stockSymbol, side, fill.quantity, fromTicks(fill.priceTicks));
+    fillCount++;
+}
 
-    // Check if user has enough stock to sell
 
-    mysqlx::RowResult result = transactions.select("Type", "SUM(Quantity)")
-        .where("UserID = :userID AND Symbol = :stockSymbol")
-        .groupBy("Type")
-        .bind("userID", userID)
-        .bind("stockSymbol", stockSymbol)
-        .execute();
+double& Database::cachedBalance(int userID){
+    auto found = balances.find(userID);
+    if(found != balances.end()){
+        return found->second;
+    }
+    journal->drain();
+    return balances[userID] = storedBalance(userID);
+}
 
-    int totalQuantity = 0;
-    std::vector<mysqlx::Row> resultRows = result.fetchAll();
 
-    for(auto & row : resultRows){
-        std::string type = (std::string)row.get(0);
-        double quantityDouble = row.get(1).get<double>();
-        int summedQuantity = static_cast<int>(quantityDouble);
+JournalRecord Database::checkTrade(int userID, const std::string& stockSymbol, Side side, int quantity, double price){
+    double balance = cachedBalance(userID);
+    loadPositions(userID);
 
-        if(type == "Buy"){
-            totalQuantity += summedQuantity; // Add bought stocks
-        } else if(type == "Sell"){
-            totalQuantity -= summedQuantity; // Subtract sold stocks
+    JournalRecord record;
+    record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.userID = userID;
+    record.symbol = stockSymbol;
+    record.quantity = quantity;
+    record.price = price;
+
+    // The same checks TradeBuy / TradeSell make against the locked rows
+    if(side == Side::Buy){
+        if(price * quantity > balance){
+            throw TradeRejected(userID, "Insufficient funds to buy stock.");
         }
+        record.type = JournalEntry::Buy;
+    } else {
+        Position held = positions.position(userID, stockSymbol);
+        if(held.quantity < quantity){
+            throw TradeRejected(userID, "Insufficient stock to sell.");
+        }
+        record.type = JournalEntry::Sell;
+        record.costRelieved = held.costBasis * quantity / held.quantity;   // what applySell will take off
+    }
+    return record;
+}
 
+
+void Database::applyTrade(const JournalRecord& record){
+    double& balance = cachedBalance(record.userID);
+    if(record.type == JournalEntry::Buy){
+        balance -= record.price * record.quantity;
+        positions.applyBuy(record.userID, record.symbol, record.quantity, record.price);
+        lots.applyBuy(record.userID, record.symbol, record.quantity, record.price);
+    } else {
+        balance += record.price * record.quantity;
+        positions.applySell(record.userID, record.symbol, record.quantity);
+        lots.applySell(record.userID, record.symbol, record.quantity, record.price);
     }
+}
+
 
+uint64_t Database::enqueueTrade(int userID, const std::string& stockSymbol, Side side, int quantity, double price){
+    JournalRecord record = checkTrade(userID, stockSymbol, side, quantity, price);
+    uint64_t sequence = journal->enqueue(record);
+    applyTrade(record);
+    return sequence;
+}
 
 
-    if(totalQuantity < quantity){
-        throw std::runtime_error("Insufficient stock to sell.");
+uint64_t Database::enqueueCash(int userID, JournalEntry type, double amount){
+    double& balance = cachedBalance(userID);
+    if(type == JournalEntry::Withdraw && balance < amount){
+        throw std::runtime_error("Insufficient funds for withdrawal.");
     }
 
-    // Add amount to user balance
+    JournalRecord record;
+    record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.type = type;
+    record.userID = userID;
+    record.price = amount;
 
-    double totalSaleValue = stockPriceValue * quantity;
+    uint64_t sequence = journal->enqueue(record);
+    balance += (type == JournalEntry::Deposit) ? amount : -amount;
+    return sequence;
+}
 
-    depositMoney(userID, totalSaleValue);
 
-    // Insert transaction record
+void Database::awaitDurable(uint64_t sequence, std::initializer_list<int> userIDs){
+    try{
+        journal->waitDurable(sequence);
+    } catch (...){
+        std::lock_guard<std::recursive_mutex> lock(ledgerMutex);
+        for(int userID : userIDs){
+            balances.erase(userID);
+            positions.unload(userID);
+            lots.unload(userID);
+        }
+        throw;
+    }
+}
 
-    transactions.insert("UserID", "Symbol", "Quantity", "PriceAtTransaction", "Type")
-                .values(userID, stockSymbol, quantity, stockPriceValue, "Sell")
-                .execute();
 
+void Database::recordTicks(const std::string& directory){
+    try{
+        ticks = std::make_unique<TickStore>(directory);
+    } catch (const std::exception& e){
+        std::cerr << "Not recording ticks: " << e.what() << std::endl;
+    }
 }
 
-void Database::viewPortfolio(int userID){
-    mysqlx::Table transactions = schema->getTable("Transactions");
-    mysqlx::Table stocks = schema->getTable("Stocks");
 
-    //Check if user has transactions
+void Database::enableJournal(const std::string& path){
+    LatencyTimer timer(ENABLE_JOURNAL_LATENCY);
+    if(journal){
+        return;
+    }
 
-    mysqlx::RowResult userCheck = transactions.select("UserID")
-        .where("UserID = :userID")
-        .bind("userID", userID)
-        .execute();
+    uint64_t applied = storage->journalCheckpoint();
 
-    if (userCheck.fetchOne().isNull()) {
-        std::cout << "No transactions found for user ID: " << userID << std::endl;
+    auto opened = std::make_unique<TradeJournal>(path, storage->storeID());
+    std::vector<JournalRecord> tail = opened->recover(applied);
+    if(!tail.empty()){
+        std::cout << "Applying " << tail.size() << " journaled change(s) that had not reached storage..." << std::endl;
+        storage->applyJournal(tail);
+        applied = tail.back().sequence;
+    }
+
+    opened->start([this](const std::vector<JournalRecord>& batch){ storage->applyJournal(batch); }, applied);
+    journal = std::move(opened);
+}
+
+
+void Database::viewPortfolio(int userID){
+    LatencyTimer timer(VIEW_PORTFOLIO_LATENCY);
+    PortfolioSnapshot snapshot = portfolioSnapshot(userID);
+
+    if (snapshot.holdings.empty()) {
+        std::cout << "No holdings found for user ID: " << userID << std::endl;
         return;
     }
 
-    mysqlx::RowResult result = transactions.select("Symbol", "Type", "SUM(Quantity)")
-        .where("UserID =:userID")
-        .groupBy("Symbol", "Type")
-        .bind("userID", userID)
-        .execute();
+    for (const Holding& holding : snapshot.holdings){
+        std::cout << "Stock: " << holding.symbol
+                << " | Quantity: " << holding.quantity
+                << " | Price: $" << holding.price
+                << " | Total Value: $" << holding.marketValue
+                << "\n";
+    }
+    for (const std::string& symbol : snapshot.unpriced){
+        std::cout << "No price available for " << symbol << "; valued at $0\n";
+    }
+
+    std::cout << "Portfolio Value: $" << snapshot.marketValue
+              << " | Cost Basis: $" << snapshot.costBasis << "\n";
+    std::cout << "Prices as of snapshot version " << snapshot.priceVersion << "\n";
 
-    std::unordered_map<std::string, int> portfolio;
-    std::vector <mysqlx::Row> resultRows = result.fetchAll();
+}
 
-    for( auto & row : resultRows){
-        std::string symbol = (std::string) row.get(0);
-        std::string type = (std::string) row.get(1);    
-        double quantityDouble = row.get(2).get<double>();
-        int quantity = static_cast<int>(quantityDouble);
 
-        if(type == "Buy"){
-            portfolio[symbol] += quantity; // Add bought stocks
-        } else if(type == "Sell"){
-            portfolio[symbol] -= quantity; // Subtract sold stocks
+uint64_t Database::readPrices(const std::vector<std::string>& symbols, std::vector<PriceQuote>& quotes) const{
+    quotes.assign(symbols.size(), PriceQuote());
+    uint64_t version = 0;
+    for(int attempt = 0; attempt < MAX_STALE_RETRIES; attempt++){
+        version = prices.version();
+        bool consistent = true;
+        for(size_t i = 0; i < symbols.size(); i++){
+            quotes[i] = PriceQuote();
+            prices.read(symbols[i], quotes[i]);
+            // Slots are written before the table version moves, so a newer quote is from a
+            // publish still in progress
+            consistent = consistent && quotes[i].version <= version;
+        }
+        if(consistent && prices.version() == version){
+            break;
         }
     }
+    return version;
+}
 
-    for ( auto iter = portfolio.begin(); iter != portfolio.end(); iter++){
-            // Get stock price and check if stock exists
 
-        if(iter->second == 0){
-            continue; 
-        }
+PortfolioSnapshot Database::portfolioSnapshot(int userID){
+    loadPositions(userID);
 
-        mysqlx::RowResult stockPrice = stocks.select("StockPrice")
-                                        .where("Symbol = :stockSymbol")
-                                        .bind("stockSymbol", iter->first)
-                                        .execute();
-    
-        mysqlx::Row stockRow = stockPrice.fetchOne();
+    PortfolioSnapshot snapshot;
+    snapshot.userID = userID;
+    std::vector<std::pair<std::string, Position>> held = positions.holdings(userID);
+    std::sort(held.begin(), held.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
 
-        double stockPriceValue = stockRow.get(0).get<double>();
+    std::vector<std::string> symbols;
+    symbols.reserve(held.size());
+    for (const auto& entry : held){
+        symbols.push_back(entry.first);
+    }
+    std::vector<PriceQuote> quotes;
+    snapshot.priceVersion = readPrices(symbols, quotes);
+
+    // Anything not in the price table yet comes from a single storage read, not one per symbol.
+    // Those prices stay in this snapshot; only publishPrices writes the table, so listeners and
+    // resting orders see every price that enters it.
+    std::unordered_map<std::string, double> listed;
+    for (const PriceQuote& quote : quotes){
+        if(quote.version == 0){
+            for (auto& stock : storage->stockPrices()){
+                listed.insert(std::move(stock));
+            }
+            break;
+        }
+    }
 
-        std::cout << "Stock: " << iter->first
-                << " | Quantity: " << iter->second
-                << " | Price: $" << stockPriceValue
-                << " | Total Value: $" << (iter->second * stockPriceValue)
-                << "\n";
+    snapshot.holdings.reserve(held.size());
+    for (size_t i = 0; i < held.size(); i++){
+        double price = quotes[i].price;
+        if(quotes[i].version == 0){
+            auto found = listed.find(held[i].first);
+            if(found != listed.end()){
+                price = found->second;
+            } else {
+                snapshot.unpriced.push_back(held[i].first);
+            }
+        }
+        Holding holding{held[i].first, held[i].second.quantity, price};
+        holding.costBasis = held[i].second.costBasis;
+        holding.marketValue = holding.quantity * holding.price;
+        snapshot.marketValue += holding.marketValue;
+        snapshot.costBasis += holding.costBasis;
+        snapshot.holdings.push_back(std::move(holding));
     }
+    return snapshot;
+}
+
+
+std::vector<Holding> Database::holdings(int userID){
+    return portfolioSnapshot(userID).holdings;
+}
+
+
+void Database::setRiskLimits(const RiskLimits& limits){
+    risk.setDefaultLimits(limits);
+}
+
+
+void Database::setUserRiskLimits(int userID, const RiskLimits& limits){
+    risk.setLimits(userID, limits);
+}
+
+
+RiskLimits Database::riskLimits(int userID){
+    return risk.limitsFor(userID);
+}
+
 
+void Database::setLotMethod(LotMethod method){
+    lots.setMethod(method);
 }
 
 
-void Database::viewTransactions (int userID){
-    mysqlx::Table transactions = schema->getTable("Transactions");
+LotMethod Database::lotMethod() const{
+    return lots.method();
+}
+
 
-    //Check if the user has transactions
+double Database::realizedPnL(int userID){
+    loadLots(userID);
+    return lots.realized(userID);
+}
 
-    mysqlx::RowResult userCheck = transactions.select("Date", "Type", "Quantity", "Symbol", "PriceAtTransaction")
-        .where("UserID = :userID")
-        .orderBy("Date ASC")
-        .bind("userID", userID)
-        .execute();
 
-    std::vector <mysqlx::Row> resultRows = userCheck.fetchAll();
+PnLSnapshot Database::pnl(int userID){
+    loadLots(userID);
 
-    if(resultRows.empty()){
+    PnLSnapshot snapshot;
+    snapshot.userID = userID;
+    snapshot.method = lots.method();
+    std::vector<LotPosition> open = lots.positions(userID);
+    std::vector<std::string> symbols;
+    symbols.reserve(open.size());
+    for (const LotPosition& position : open){
+        symbols.push_back(position.symbol);
+    }
+    std::vector<PriceQuote> quotes;
+    snapshot.priceVersion = readPrices(symbols, quotes);
+
+    for (size_t i = 0; i < open.size(); i++){
+        const LotPosition& position = open[i];
+        PnLLine line;
+        line.symbol = position.symbol;
+        line.quantity = position.quantity;
+        line.costBasis = position.costBasis;
+        line.realized = position.realized;
+        // Closed symbols need no price; an open one storage no longer lists is marked at cost
+        if(position.quantity != 0){
+            line.price = (quotes[i].version != 0) ? quotes[i].price : position.costBasis / position.quantity;
+            line.marketValue = line.price * line.quantity;
+            line.unrealized = line.marketValue - line.costBasis;
+        }
+        snapshot.realized += line.realized;
+        snapshot.unrealized += line.unrealized;
+        snapshot.lines.push_back(std::move(line));
+    }
+    return snapshot;
+}
+
+
+void Database::viewPnL(int userID){
+    LatencyTimer timer(VIEW_PNL_LATENCY);
+    PnLSnapshot snapshot = pnl(userID);
+
+    if (snapshot.lines.empty()) {
+        std::cout << "No trades found for user ID: " << userID << std::endl;
+        return;
+    }
+
+    const char* method = (snapshot.method == LotMethod::FIFO) ? "FIFO"
+                       : (snapshot.method == LotMethod::LIFO) ? "LIFO" : "average cost";
+    std::cout << "P&L for user ID: " << userID << " (" << method << " lots)\n";
+    for (const PnLLine& line : snapshot.lines){
+        std::cout << "Stock: " << line.symbol
+                  << " | Quantity: " << line.quantity
+                  << " | Cost Basis: $" << line.costBasis
+                  << " | Market Value: $" << line.marketValue
+                  << " | Unrealized: $" << line.unrealized
+                  << " | Realized: $" << line.realized
+                  << "\n";
+    }
+    std::cout << "Total Unrealized: $" << snapshot.unrealized
+              << " | Total Realized: $" << snapshot.realized << "\n";
+    std::cout << "Prices as of snapshot version " << snapshot.priceVersion << "\n";
+}
+
+
+TransactionCursor Database::transactionCursor(int userID, const TransactionFilter& filter, size_t pageSize){
+    return TransactionCursor(*storage, userID, filter, pageSize);
+}
+
+
+void Database::viewTransactions (int userID, const TransactionFilter& filter){
+    LatencyTimer timer(VIEW_TRANSACTIONS_LATENCY);
+    if(journal){
+        journal->drain();
+    }
+
+    TransactionCursor history = transactionCursor(userID, filter);
+    TransactionRecord record;
+    if(!history.next(record)){
         std::cout << "No transactions found for user ID: " << userID << std::endl;
         return;
     }
 
     std::cout << "Transactions for user ID: " << userID << std::endl;
 
-    for (auto& row : resultRows){
-        std::string date = (std::string) row.get(0);
-        std::string type = (std::string) row.get(1);
-        int quantity = (int) row.get(2);
-        std::string symbol = (std::string) row.get(3);
-        double priceAtTransaction = (double) row.get(4);
-
-        std::cout << "Date: " << date
-                  << " | Type: " << type
-                  << " | Quantity: " << quantity
-                  << " | Symbol: " << symbol
-                  << " | Price at Transaction: $" << priceAtTransaction
+    do {
+        std::cout << "Date: " << record.date
+                  << " | Type: " << (record.side == Side::Buy ? "Buy" : "Sell")
+                  << " | Quantity: " << record.quantity
+                  << " | Symbol: " << record.symbol
+                  << " | Price at Transaction: $" << record.price
                   << "\n";
+    } while(history.next(record));
+    std::cout << std::flush;
+}
+
+
+void Database::loadPrices(){
+    prices.apply(storage->stockPrices());
+}
+
+
+bool Database::lookupPrice(const std::string& stockSymbol, double& price){
+    PriceQuote quote;
+    if(prices.read(stockSymbol, quote)){
+        price = quote.price;
+        return true;
     }
 
+    // Symbols listed after the last refresh are read from storage until a refresh publishes
+    // them; the price table only changes through publishPrices, so listeners and resting
+    // orders never miss a price
+    return storage->stockPrice(stockSymbol, price);
+}
+
 
+double Database::priceOf(const std::string& stockSymbol){
+    double price;
+    if(!lookupPrice(stockSymbol, price)){
+        throw std::runtime_error("Stock not found with the given symbol.");
+    }
+    return price;
 }
 
 
-void Database::updateStockPrices() {
-    int result = std::system ("python3 /Users/aadeshshah/TradingApp/update_stocks.py"); // Assuming you have a Python script to update stock prices
-    // if(result != 0) {
-    //     std::cerr << "Failed to update stock prices. Please check the Python script or API is overused" << std::endl;
-    // } else {
-    //     std::cout << "Stock prices updated successfully." << std::endl;
-    // }
+bool Database::currentPrice(const std::string& stockSymbol, PriceQuote& quote) const{
+    return prices.read(stockSymbol, quote);
+}
+
 
-    
+uint64_t Database::priceVersion() const{
+    return prices.version();
 }
 
 
-std::string execCommand(const std::string& cmd) {
-    std::array<char, 128> buffer;
-    std::string result;
+std::vector<std::string> Database::ingestQuotes(QuoteSource& source){
+    LatencyTimer timer(INGEST_QUOTES_LATENCY);
+    std::string payload = source.read();
+    std::vector<Quote> quotes;
+    quotes.reserve(256);
+    parseQuotes(payload, quotes);
+
+    // History keeps every quote seen, not just the ones that moved
+    if(ticks && !quotes.empty()){
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        // One symbol's file failing must not cost the others their ticks
+        for(const Quote& quote : quotes){
+            try{
+                ticks->appendClamped(std::string(quote.symbol), now, quote.price, quote.volume);
+            } catch (const std::exception& e){
+                std::cerr << "Failed to record a tick for " << quote.symbol << ": " << e.what() << std::endl;
+            }
+        }
+        ticks->flush();
+    }
+
+    // Only quotes that move a price (or introduce a symbol) go any further
+    std::vector<const Quote*> changedQuotes;
+    std::vector<std::pair<std::string, double>> updates;
+    for(const Quote& quote : quotes){
+        PriceQuote current;
+        std::string symbol(quote.symbol);
+        if(prices.read(symbol, current) && current.price == quote.price){
+            continue;
+        }
+        changedQuotes.push_back(&quote);
+        updates.emplace_back(std::move(symbol), quote.price);
+    }
 
-    // Open pipe to file
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        throw std::runtime_error("popen() failed!");
+    std::vector<std::string> changed;
+    if(updates.empty()){
+        return changed;
     }
 
-    // read until end of process:
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result += buffer.data();
+    storage->upsertQuotes(changedQuotes);
+
+    publishPrices(updates);
+
+    changed.reserve(updates.size());
+    for(auto& update : updates){
+        changed.push_back(std::move(update.first));
     }
-    return result;
+    return changed;
 }
 
-std::string Database::getSentiment(const std::string& stockSymbol, bool useTwitter) {
-    std::string cmd = "python3 /Users/aadeshshah/TradingApp/sentiment.py " 
-                    + stockSymbol + " " + (useTwitter ? "1" : "0");
 
-    std::string output = execCommand(cmd);
-    if (output.empty()) {
-        throw std::runtime_error("Python script returned no output.");
+size_t Database::publishPrices(const std::vector<std::pair<std::string, double>>& updates){
+    LatencyTimer timer(PUBLISH_PRICES_LATENCY);
+    std::vector<PriceMove> moves;
+    moves.reserve(updates.size());
+    for(const auto& update : updates){
+        PriceQuote current;
+        double previous = prices.read(update.first, current) ? current.price : 0.0;
+        moves.push_back(PriceMove{update.first, previous, update.second});
     }
-    return output; // return the captured sentiment string
+
+    prices.apply(updates);
+
+    {
+        std::lock_guard<std::mutex> lock(listenersMutex);
+        for(const PriceListener& listener : priceListeners){
+            listener(moves);
+        }
+    }
+
+    // Orders are triggered in update order so a given sequence of prices always yields the same fills
+    size_t triggered = 0;
+    std::vector<Fill> fills;
+    std::vector<const Fill*> retry;
+    for(const auto& update : updates){
+        fills.clear();
+        retry.clear();
+        engine.onMarketPrice(update.first, update.second, fills);
+        for(const Fill& fill : fills){
+            try{
+                persistMarketFill(update.first, fill);
+                triggered++;
+            } catch (const TradeRejected& e){
+                notifyOrder(OrderNotice{fill.makerUserID, fill.makerOrderID, update.first, fill.quantity, false, e.what()});
+            } catch (const std::exception& e){
+                // Not the owner's doing; the order goes back and triggers again on the next price
+                retry.push_back(&fill);
+                notifyOrder(OrderNotice{fill.makerUserID, fill.makerOrderID, update.first, fill.quantity, true, e.what()});
+            }
+        }
+        for(auto fill = retry.rbegin(); fill != retry.rend(); ++fill){
+            engine.restore(update.first, **fill);
+        }
+    }
+    return triggered;
 }
 
 
-std::vector<std::string> Database::returnStocks(){
-    std::vector<std::string> names;
-    mysqlx::Table stocks = schema->getTable("Stocks");
+void Database::addPriceListener(PriceListener listener){
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    priceListeners.push_back(std::move(listener));
+}
 
-    mysqlx::RowResult stockNames = stocks.select("Symbol")
-                                   .execute();
 
-    std::vector <mysqlx::Row> resultRows = stockNames.fetchAll();
+void Database::addOrderListener(OrderListener listener){
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    orderListeners.push_back(std::move(listener));
+}
+
 
-    for (auto& row : resultRows){
-        names.emplace_back((std::string) row.get(0));
+void Database::notifyOrder(const OrderNotice& notice){
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    if(orderListeners.empty()){
+        std::cerr << "Order " << notice.orderID << " (" << notice.symbol << ", user " << notice.userID << ") "
+                  << (notice.restored ? "returned to the book" : "cancelled") << " after a failed fill of "
+                  << notice.quantity << ": " << notice.reason << std::endl;
+        return;
+    }
+    for(const OrderListener& listener : orderListeners){
+        listener(notice);
     }
+}
 
-    return names;
 
-} 
+uint64_t Database::fillsExecuted() const{
+    return fillCount.load();
+}
 
 
+void Database::setQuoteSource(std::unique_ptr<QuoteSource> source){
+    std::lock_guard<std::mutex> lock(quoteSourceMutex);
+    quoteSource = std::move(source);
+}
+
+
+std::vector<std::string> Database::updateStockPrices() {
+    LatencyTimer timer(UPDATE_STOCK_PRICES_LATENCY);
+    std::lock_guard<std::mutex> lock(quoteSourceMutex);
+    if(!quoteSource){
+        quoteSource = std::make_unique<PipeQuoteSource>("python3 /Users/aadeshshah/TradingApp/update_stocks.py --csv");
+    }
+
+    try{
+        return ingestQuotes(*quoteSource);
+    } catch (const std::exception& e){
+        std::cerr << "Failed to update stock prices: " << e.what() << std::endl;
+        return {};
+    }
+}
+
+
+void Database::setSentimentScript(const std::string& path){
+    std::lock_guard<std::mutex> lock(sentimentMutex);
+    sentimentScript = path;
+}
 
+
+std::string Database::getSentiment(const std::string& stockSymbol, bool useTwitter) {
+    LatencyTimer timer(GET_SENTIMENT_LATENCY);
+    SentimentWorker* worker;
+    {
+        // FinBERT is loaded once by this long-lived worker, started the first time it is needed
+        std::lock_guard<std::mutex> lock(sentimentMutex);
+        if(!sentimentWorker){
+            sentimentWorker = std::make_unique<SentimentWorker>(sentimentScript, SENTIMENT_CONCURRENCY);
+        }
+        worker = sentimentWorker.get();
+    }
+    std::string output = worker->request(stockSymbol, useTwitter).get();
+    if (output.empty()) {
+        throw std::runtime_error("Sentiment worker returned no output.");
+    }
+    return output; // return the captured sentiment string
+}
+
+
+std::vector<std::string> Database::returnStocks(){
+    LatencyTimer timer(RETURN_STOCKS_LATENCY);
+    return storage->stockSymbols();
+}
+
+
+std::vector<std::string> Database::heldSymbols(){
+    return positions.symbols();
+}
+
+
+size_t Database::lastCallRoundTrips() const{
+    return storage->roundTrips();
+}
@@ -1,27 +1,224 @@
-#include <xdevapi.h>
 #include <string_view>
 #include <iostream>
 #include <string>
 #include <memory>  // for std::unique_ptr
+#include <vector>
+#include "orderbook.h"
+#include "positions.h"
+#include "lotbook.h"
+#include "riskengine.h"
+#include "storage.h"
+#include "accountcache.h"
+#include "sentimentworker.h"
+#include "pricetable.h"
+#include "quotefeed.h"
+#include "tickstore.h"
+#include "journal.h"
+#include "metrics.h"
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
 
 
 #ifndef DATABASE_H
 #define DATABASE_H
 
 
+// One leg of a basket passed to Database::submitBatch
+struct Order {
+    std::string symbol;
+    Side side;
+    int quantity;
+};
+
+struct OrderResult {
+    bool accepted = false;
+    double price = 0.0;
+    std::string error;
+};
+
+
+// A published price and the one it replaced (0 for a symbol seen for the first time)
+struct PriceMove {
+    std::string symbol;
+    double previous;
+    double price;
+};
+
+// One line of a portfolio: a held symbol valued at the cached price
+struct Holding {
+    std::string symbol;
+    int quantity;
+    double price;
+    double costBasis = 0.0;
+    double marketValue = 0.0;   // quantity * price
+};
+
+// A whole portfolio valued from the in-memory positions and price table. Every line is read
+// under one positions lock, so a concurrent fill cannot show up in some lines and not others.
+struct PortfolioSnapshot {
+    int userID = 0;
+    std::vector<Holding> holdings;   // by symbol
+    std::vector<std::string> unpriced;   // held but unknown to storage; valued at 0
+    double marketValue = 0.0;
+    double costBasis = 0.0;
+    uint64_t priceVersion = 0;   // price table version when the prices were read
+};
+
+using PriceListener = std::function<void(const std::vector<PriceMove>&)>;
+
+// A resting order that lost quantity without trading, because a fill against it failed
+struct OrderNotice {
+    int userID;
+    uint64_t orderID;
+    std::string symbol;
+    int quantity;
+    bool restored;   // put back in the book; otherwise the rest of the order was cancelled
+    std::string reason;
+};
+
+using OrderListener = std::function<void(const OrderNotice&)>;
+
+// A trade refused because of one account's funds or holdings, as opposed to a storage or
+// journal failure. Fill settlement uses `userID` to decide whose order to drop.
+class TradeRejected : public std::runtime_error {
+
+    public:
+        const int userID;
+
+    TradeRejected(int userID, const std::string& reason) : std::runtime_error(reason), userID(userID) {}
+};
+
+
+// Requests the sentiment worker processes at once; the refresher keeps this many in flight
+constexpr size_t SENTIMENT_CONCURRENCY = 8;
+
+// One symbol's P&L under the current lot method; closed symbols keep their realized part
+struct PnLLine {
+    std::string symbol;
+    int quantity = 0;
+    double costBasis = 0.0;
+    double price = 0.0;
+    double marketValue = 0.0;
+    double realized = 0.0;
+    double unrealized = 0.0;   // marketValue - costBasis
+};
+
+struct PnLSnapshot {
+    int userID = 0;
+    LotMethod method = LotMethod::FIFO;
+    std::vector<PnLLine> lines;   // by symbol
+    double realized = 0.0;
+    double unrealized = 0.0;
+    uint64_t priceVersion = 0;
+};
+
+// Rows a history cursor holds at once
+constexpr size_t HISTORY_PAGE_ROWS = 500;
+
+
 class Database {
 
     private: 
-        std::unique_ptr<mysqlx::Session> session;
-        std::unique_ptr<mysqlx::Schema> schema;
+        std::unique_ptr<Storage> storage;
+        MatchingEngine engine;
+        PositionBook positions;
+        LotBook lots;
+        RiskEngine risk;
+        PriceTable prices;
+        std::mutex quoteSourceMutex;
+        std::unique_ptr<QuoteSource> quoteSource;
+        std::mutex sentimentMutex;
+        std::string sentimentScript = "sentiment.py";
+        std::unique_ptr<SentimentWorker> sentimentWorker;
+        std::unique_ptr<TickStore> ticks;
+        std::mutex listenersMutex;
+        std::vector<PriceListener> priceListeners;
+        std::vector<OrderListener> orderListeners;
+        std::atomic<uint64_t> fillCount{0};
 
-    public:
+        // With the journal on, balances and the positions mirror are the ledger trades are checked
+        // against; storage trails it by whatever the journal has not applied yet
+        std::recursive_mutex ledgerMutex;
+        std::unordered_map<int, double> balances;
+
+        // Without the journal: balances and versions as storage last reported them, plus sessions
+        AccountCache accounts;
+        std::unique_ptr<TradeJournal> journal;   // last, so it stops before the storage it flushes into
+
+        void loadPrices();
+
+        // Price from the in-process table, falling back to storage for symbols it has not seen;
+        // the fallback is not cached
+        bool lookupPrice(const std::string& stockSymbol, double& price);
+
+        double priceOf(const std::string& stockSymbol);
+
+        void loadPositions(int userID);
+
+        // Rebuilds the user's lots from the full history the first time they are needed
+        void loadLots(int userID);
+
+        int heldQuantity(int userID, const std::string& stockSymbol);
+
+        double storedBalance(int userID);
+
+        // The cached account, read from storage on a miss
+        AccountVersion accountOf(int userID);
+
+        // Runs a versioned storage write at the cached account's version, re-checking `required`
+        // against the balance and retrying while other sessions get in first. Returns the final
+        // TRADE_* status with the cache holding what storage reported.
+        int writeAccount(int userID, double required, const std::function<int(AccountVersion&)>& write);
+
+        // Caller holds ledgerMutex. Loads the balance once storage has caught up with the journal.
+        double& cachedBalance(int userID);
+
+        // Caller holds ledgerMutex. Checks a trade against the ledger and returns its journal
+        // record without changing anything
+        JournalRecord checkTrade(int userID, const std::string& stockSymbol, Side side, int quantity, double price);
+
+        // Caller holds ledgerMutex. Applies a checked trade to the ledger once the journal has taken it
+        void applyTrade(const JournalRecord& record);
+
+        // Caller holds ledgerMutex. Checks, queues for the journal, then applies to the ledger; the
+        // caller waits on the returned sequence after releasing the lock.
+        uint64_t enqueueTrade(int userID, const std::string& stockSymbol, Side side, int quantity, double price);
+
+        uint64_t enqueueCash(int userID, JournalEntry type, double amount);
+
+        // Waits for `sequence` to be durable. If the write failed the ledger holds changes that
+        // neither the journal nor storage has, so the users' cached state is dropped before rethrowing.
+        void awaitDurable(uint64_t sequence, std::initializer_list<int> userIDs);
+
+        // Runs the pre-trade risk rules against the in-memory balance and position; throws the
+        // rule's reason on a reject, before anything is written
+        void checkRisk(int userID, const std::string& stockSymbol, Side side, int quantity, double price);
 
-    void connect(const std::string& url); 
-    
-    mysqlx::Schema &getSchema() const;
+        // Runs a checked trade at a given price and updates the positions mirror
+        void tradeAtPrice(int userID, const std::string& stockSymbol, Side side, int quantity, double price);
 
-    mysqlx::Table getTable(const std::string & name);
+        void persistFill(const std::string& stockSymbol, const Fill& fill);
+
+        // Settles a resting order the market price crossed against the user's account
+        void persistMarketFill(const std::string& stockSymbol, const Fill& fill);
+
+        // Reads the symbols' cached prices as of one table version and returns it, re-reading
+        // while a publish lands mid-read. A quote left at version 0 has no price.
+        uint64_t readPrices(const std::vector<std::string>& symbols, std::vector<PriceQuote>& quotes) const;
+
+        // Tells order listeners, or stderr when there are none
+        void notifyOrder(const OrderNotice& notice);
+
+    public:
+
+    // url is a MySQL X Protocol URL, or embedded://<directory> to run on the in-process store.
+    // poolSize 0 sizes the MySQL session pool to the number of hardware threads.
+    // refreshOnConnect false skips the initial quote pull (replay feeds prices itself).
+    void connect(const std::string& url, size_t poolSize = 0, bool refreshOnConnect = true);
 
     ~Database();
 
@@ -31,6 +228,14 @@ class Database {
 
     int loginUser (const std::string& username, const std::string& password);
 
+    // Logs in and returns a token that stands for the user until endSession
+    std::string startSession(const std::string& username, const std::string& password);
+
+    // Throws if the token was never issued or its session has ended
+    int sessionUser(const std::string& token);
+
+    void endSession(const std::string& token);
+
     double getBalance (int userID);
 
     void depositMoney(int userID, double amount);
@@ -41,15 +246,112 @@ class Database {
 
     void sellStock (int userID, const std::string& stockSymbol, int quantity);
 
+    // Validates a basket against one locked balance/position snapshot and writes every
+    // accepted leg in a single transaction. Legs are applied in order, so sells can fund later buys.
+    // Each leg passes the pre-trade risk rules first; a refused leg carries the rule in its error.
+    std::vector<OrderResult> submitBatch(int userID, const std::vector<Order>& orders);
+
+    // Rests a limit order on the in-memory book; only the resulting fills touch storage.
+    // A maker that can no longer pay or deliver loses the rest of its order and is notified,
+    // and this order matches those shares again against the rest of the book. If a fill fails
+    // because of this order's own account, or in storage, this order's remainder is cancelled,
+    // makers of the unsettled fills go back at their old priority, and the call throws with
+    // the shares that did fill.
+    uint64_t placeLimitOrder (int userID, const std::string& stockSymbol, Side side, int quantity, double limitPrice);
+
+    void cancelOrder (int userID, uint64_t orderID);
+
     void viewPortfolio(int userID);
 
-    void viewTransactions(int userID);
+    // What viewPortfolio prints, for callers that render it themselves. Costs no storage round
+    // trip once the user's positions are loaded; symbols missing from the price table are
+    // fetched together in one.
+    PortfolioSnapshot portfolioSnapshot(int userID);
+
+    // portfolioSnapshot(userID).holdings
+    std::vector<Holding> holdings(int userID);
+
+    // Limits for every user without limits of their own
+    void setRiskLimits(const RiskLimits& limits);
+
+    void setUserRiskLimits(int userID, const RiskLimits& limits);
+
+    RiskLimits riskLimits(int userID);
+
+    // Switches how sells close lots; every user's lots rebuild from history on next use
+    void setLotMethod(LotMethod method);
+
+    LotMethod lotMethod() const;
+
+    // Realized P&L over the whole history; a running total once the user's lots are loaded
+    double realizedPnL(int userID);
 
-    void updateStockPrices();
+    // Realized and unrealized P&L per symbol against the live price table
+    PnLSnapshot pnl(int userID);
+
+    void viewPnL(int userID);
+
+    // Streams the history oldest first, one page of pageSize rows in memory at a time
+    TransactionCursor transactionCursor(int userID, const TransactionFilter& filter = TransactionFilter(),
+                                        size_t pageSize = HISTORY_PAGE_ROWS);
+
+    // Prints each row as its page arrives, so a long history costs no more memory than a short one
+    void viewTransactions(int userID, const TransactionFilter& filter = TransactionFilter());
+
+    // Recomputes the user's Positions rows from Transactions; returns how many symbols differed
+    int rebuildPositions(int userID);
+
+    // Appends every quote refresh to per-symbol tick files under `directory`, for history and
+    // replay. Call before connect. A directory that cannot be created only costs the recording.
+    void recordTicks(const std::string& directory);
+
+    // Routes trades, deposits and withdrawals through a local write-ahead journal: they are
+    // acknowledged once fsync'd and reach storage in batches. Replays whatever a crash left unapplied.
+    void enableJournal(const std::string& path);
+
+    // Pulls one refresh from the quote source (update_stocks.py --csv by default);
+    // returns the symbols whose price changed
+    std::vector<std::string> updateStockPrices();
+
+    // Parses a source's payload, publishes changed prices to the price table and
+    // upserts them into storage in one write; returns the changed symbols
+    std::vector<std::string> ingestQuotes(QuoteSource& source);
+
+    void setQuoteSource(std::unique_ptr<QuoteSource> source);
+
+    // Publishes prices to the price table, tells price listeners what moved and executes
+    // resting limit orders the new prices cross. ingestQuotes and replay both end here.
+    // A triggered order whose owner cannot pay or deliver is dropped and its owner notified;
+    // one that failed for another reason goes back in the book. Returns the orders settled.
+    size_t publishPrices(const std::vector<std::pair<std::string, double>>& updates);
+
+    // Called on the publishing thread after every publishPrices
+    void addPriceListener(PriceListener listener);
+
+    // Called on the settling thread when a fill against a resting order fails
+    void addOrderListener(OrderListener listener);
+
+    // Fills settled against storage since startup, both order-vs-order and market-triggered
+    uint64_t fillsExecuted() const;
+
+    // Lock-free read of the cached price; false if the symbol has never been priced
+    bool currentPrice(const std::string& stockSymbol, PriceQuote& quote) const;
+
+    uint64_t priceVersion() const;
+
+    // The sentiment worker runs `python3 <path> --serve`; sentiment.py in the working directory by
+    // default. Call before the first getSentiment.
+    void setSentimentScript(const std::string& path);
 
     std::string getSentiment(const std::string& stockSymbol, bool useTwitter);
 
     std::vector<std::string> returnStocks();
+
+    // Symbols held by any user whose positions are loaded in memory
+    std::vector<std::string> heldSymbols();
+
+    // Round trips issued by this thread's most recent Database call
+    size_t lastCallRoundTrips() const;
 }
 
 ;
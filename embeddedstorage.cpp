@@ -0,0 +1,758 @@
+#include "embeddedstorage.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+    // Fields are tab-separated and records newline-terminated, so both are escaped inside a field
+    std::string escape(const std::string& field){
+        std::string escaped;
+        escaped.reserve(field.size());
+        for(char c : field){
+            switch(c){
+                case '\\': escaped += "\\\\"; break;
+                case '\t': escaped += "\\t"; break;
+                case '\n': escaped += "\\n"; break;
+                default: escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    std::vector<std::string> splitRecord(const std::string& contents, size_t begin, size_t end){
+        std::vector<std::string> fields(1);
+        for(size_t i = begin; i < end; i++){
+            char c = contents[i];
+            if(c == '\t'){
+                fields.emplace_back();
+            } else if(c == '\\' && i + 1 < end){
+                char next = contents[++i];
+                fields.back() += (next == 't') ? '\t' : (next == 'n') ? '\n' : next;
+            } else {
+                fields.back() += c;
+            }
+        }
+        return fields;
+    }
+
+    void addRecord(std::string& block, std::initializer_list<std::string> fields){
+        bool first = true;
+        for(const std::string& field : fields){
+            if(!first){
+                block += '\t';
+            }
+            block += escape(field);
+            first = false;
+        }
+        block += '\n';
+    }
+
+    std::string number(double value){
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        return buffer;
+    }
+
+    // Same shape as a MySQL DATETIME read back as a string
+    std::string formatDate(int64_t nanoseconds){
+        std::time_t seconds = static_cast<std::time_t>(nanoseconds / 1000000000);
+        std::tm local{};
+        localtime_r(&seconds, &local);
+        char buffer[32];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+        return buffer;
+    }
+
+    std::string now(){
+        return formatDate(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    bool samePosition(const Position& a, const Position& b){
+        return a.quantity == b.quantity && a.costBasis == b.costBasis;
+    }
+
+    std::string readAll(int fd){
+        std::string contents;
+        char buffer[65536];
+        ssize_t got;
+        ::lseek(fd, 0, SEEK_SET);
+        while((got = ::read(fd, buffer, sizeof(buffer))) > 0){
+            contents.append(buffer, static_cast<size_t>(got));
+        }
+        return contents;
+    }
+
+    bool writeAll(int fd, const std::string& data){
+        const char* cursor = data.data();
+        size_t remaining = data.size();
+        while(remaining > 0){
+            ssize_t written = ::write(fd, cursor, remaining);
+            if(written < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+            cursor += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool syncFile(int fd){
+#ifdef __APPLE__
+        if(::fcntl(fd, F_FULLFSYNC) == 0){
+            return true;
+        }
+        return ::fsync(fd) == 0;
+#else
+        return ::fdatasync(fd) == 0;
+#endif
+    }
+}
+
+
+
+EmbeddedStorage::EmbeddedStorage(const std::string& directory, uint64_t compactBytes)
+    : directory(directory), compactBytes(compactBytes)
+{
+    if(::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST){
+        throw std::runtime_error("Could not create embedded store directory: " + directory);
+    }
+
+    // Held until close; a second process would replay, append and compact the same files
+    lockFd = ::open((directory + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(lockFd < 0){
+        throw std::runtime_error("Could not open embedded store lock in " + directory);
+    }
+    if(::flock(lockFd, LOCK_EX | LOCK_NB) != 0){
+        ::close(lockFd);
+        throw std::runtime_error("Embedded store " + directory + " is in use by another process.");
+    }
+
+    try{
+        load();
+    } catch (...){
+        if(logFd >= 0){
+            ::close(logFd);
+        }
+        ::close(lockFd);
+        throw;
+    }
+}
+
+
+void EmbeddedStorage::load(){
+    loadIdentity();
+
+    int snapshotFd = ::open((directory + "/snapshot").c_str(), O_RDONLY | O_CLOEXEC);
+    if(snapshotFd >= 0){
+        std::string snapshot = readAll(snapshotFd);
+        ::close(snapshotFd);
+        replay(snapshot);
+    }
+    uint64_t covered = generation;
+
+    logFd = ::open((directory + "/log").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(logFd < 0){
+        throw std::runtime_error("Could not open embedded store log in " + directory);
+    }
+
+    // A log the snapshot already covers was being compacted away when the process stopped
+    std::string log = readAll(logFd);
+    if(log.compare(0, 2, "G\t") != 0 || std::strtoull(log.c_str() + 2, nullptr, 10) <= covered){
+        startLog();
+        return;
+    }
+
+    logBytes = replay(log);
+    if(logBytes < log.size()){
+        std::cerr << "Embedded store: discarding " << (log.size() - logBytes) << " bytes of torn log tail." << std::endl;
+        if(::ftruncate(logFd, static_cast<off_t>(logBytes)) != 0){
+            throw std::runtime_error("Could not truncate torn embedded store log.");
+        }
+    }
+}
+
+
+EmbeddedStorage::~EmbeddedStorage(){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    try{
+        writeSnapshot();
+    } catch (const std::exception& e){
+        std::cerr << e.what() << " The log still holds every change." << std::endl;
+    }
+    ::close(logFd);
+    ::close(lockFd);
+}
+
+
+size_t EmbeddedStorage::replay(const std::string& contents){
+    std::vector<std::vector<std::string>> block;
+    size_t complete = 0;
+    size_t lineStart = 0;
+    size_t newline;
+    while((newline = contents.find('\n', lineStart)) != std::string::npos){
+        std::vector<std::string> fields = splitRecord(contents, lineStart, newline);
+        lineStart = newline + 1;
+        if(fields[0] != "E"){
+            block.push_back(std::move(fields));
+            continue;
+        }
+        for(const std::vector<std::string>& record : block){
+            applyRecord(record);
+        }
+        block.clear();
+        complete = lineStart;
+    }
+    return complete;
+}
+
+
+void EmbeddedStorage::applyRecord(const std::vector<std::string>& fields){
+    auto field = [&](size_t index) -> const std::string& {
+        if(index >= fields.size()){
+            throw std::runtime_error("Corrupt embedded store record.");
+        }
+        return fields[index];
+    };
+    auto integer = [&](size_t index){ return std::strtoll(field(index).c_str(), nullptr, 10); };
+    auto real = [&](size_t index){ return std::strtod(field(index).c_str(), nullptr); };
+
+    const std::string& type = field(0);
+    if(type == "U"){
+        int userID = static_cast<int>(integer(1));
+        UserRow& row = users[userID];
+        row.username = field(2);
+        row.password = field(3);
+        usernames[row.username] = userID;
+        nextUserID = std::max(nextUserID, userID + 1);
+    } else if(type == "B"){
+        UserRow& row = users[static_cast<int>(integer(1))];
+        row.balance = real(2);
+        row.version++;
+    } else if(type == "P"){
+        UserRow& row = users[static_cast<int>(integer(1))];
+        int quantity = static_cast<int>(integer(3));
+        if(quantity == 0){
+            row.positions.erase(field(2));
+        } else {
+            Position& position = row.positions[field(2)];
+            position.quantity = quantity;
+            position.costBasis = real(4);
+        }
+    } else if(type == "T"){
+        TransactionRecord record;
+        record.userID = static_cast<int>(integer(1));
+        record.symbol = field(2);
+        record.side = (field(3) == "S") ? Side::Sell : Side::Buy;
+        record.quantity = static_cast<int>(integer(4));
+        record.price = real(5);
+        record.date = field(6);
+        record.transactionID = nextTransactionID++;
+        // Journal replays can carry dates older than the newest row; keep the history in key
+        // order so pages can seek into it. Ties go last, matching their higher ID.
+        std::vector<TransactionRecord>& history = users[record.userID].transactions;
+        auto position = std::upper_bound(history.begin(), history.end(), record.date,
+            [](const std::string& date, const TransactionRecord& row){ return date < row.date; });
+        history.insert(position, std::move(record));
+    } else if(type == "S"){
+        StockRow& row = stocks[field(1)];
+        row.price = real(2);
+        if(!field(3).empty()){
+            row.companyName = field(3);
+        }
+    } else if(type == "C"){
+        appliedSequence = static_cast<uint64_t>(integer(1));
+    } else if(type == "G"){
+        generation = static_cast<uint64_t>(integer(1));
+    } else {
+        throw std::runtime_error("Corrupt embedded store record.");
+    }
+}
+
+
+void EmbeddedStorage::commit(const std::string& block){
+    if(!writeAll(logFd, block)){
+        // Cut off whatever part of the block made it so the next block does not run into it
+        if(::ftruncate(logFd, static_cast<off_t>(logBytes)) != 0){
+            std::cerr << "Could not truncate the embedded store log after a failed write." << std::endl;
+        }
+        throw std::runtime_error("Could not write to the embedded store log.");
+    }
+    logBytes += block.size();
+    replay(block);
+
+    if(logBytes >= compactBytes){
+        try{
+            writeSnapshot();
+        } catch (const std::exception& e){
+            std::cerr << e.what() << std::endl;   // the change itself is logged; compaction retries next time
+        }
+    }
+}
+
+
+void EmbeddedStorage::writeSnapshot(){
+    std::string out;
+    addRecord(out, {"G", std::to_string(generation)});
+    for(const auto& stock : stocks){
+        addRecord(out, {"S", stock.first, number(stock.second.price), stock.second.companyName});
+    }
+    for(const auto& user : users){
+        std::string userID = std::to_string(user.first);
+        const UserRow& row = user.second;
+        addRecord(out, {"U", userID, row.username, row.password});
+        addRecord(out, {"B", userID, number(row.balance)});
+        for(const auto& position : row.positions){
+            addRecord(out, {"P", userID, position.first, std::to_string(position.second.quantity),
+                            number(position.second.costBasis)});
+        }
+        for(const TransactionRecord& record : row.transactions){
+            addRecord(out, {"T", userID, record.symbol, record.side == Side::Buy ? "B" : "S",
+                            std::to_string(record.quantity), number(record.price), record.date});
+        }
+    }
+    addRecord(out, {"C", std::to_string(appliedSequence)});
+    addRecord(out, {"E"});
+
+    // Written beside the old snapshot and renamed over it, so a crash leaves one or the other
+    std::string path = directory + "/snapshot";
+    std::string staging = path + ".tmp";
+    int fd = ::open(staging.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0){
+        throw std::runtime_error("Could not write embedded store snapshot.");
+    }
+    bool written = writeAll(fd, out) && syncFile(fd);
+    ::close(fd);
+    if(!written || ::rename(staging.c_str(), path.c_str()) != 0){
+        throw std::runtime_error("Could not write embedded store snapshot.");
+    }
+
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if(directoryFd >= 0){
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+
+    startLog();
+}
+
+
+void EmbeddedStorage::loadIdentity(){
+    std::string path = directory + "/storeid";
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd >= 0){
+        identity = readAll(fd);
+        ::close(fd);
+        if(!identity.empty()){
+            return;
+        }
+    }
+
+    // Staged and renamed like the snapshot, so the ID is never seen half written
+    identity = randomHex(16);
+    std::string staging = path + ".tmp";
+    fd = ::open(staging.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool written = fd >= 0 && writeAll(fd, identity) && syncFile(fd);
+    if(fd >= 0){
+        ::close(fd);
+    }
+    if(!written || ::rename(staging.c_str(), path.c_str()) != 0){
+        throw std::runtime_error("Could not write embedded store identity in " + directory);
+    }
+}
+
+
+void EmbeddedStorage::startLog(){
+    if(::ftruncate(logFd, 0) != 0){
+        throw std::runtime_error("Could not reset the embedded store log.");
+    }
+    generation++;
+    std::string header;
+    addRecord(header, {"G", std::to_string(generation)});
+    addRecord(header, {"E"});
+    if(!writeAll(logFd, header)){
+        throw std::runtime_error("Could not write to the embedded store log.");
+    }
+    logBytes = header.size();
+}
+
+
+int EmbeddedStorage::createUser(const std::string& username, const std::string& password){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if(usernames.count(username)){
+        throw std::runtime_error("User already exists with the given username.");
+    }
+
+    int userID = nextUserID;
+    std::string block;
+    addRecord(block, {"U", std::to_string(userID), username, password});
+    addRecord(block, {"E"});
+    commit(block);
+    return userID;
+}
+
+
+int EmbeddedStorage::findUser(const std::string& username, const std::string& password, AccountVersion& account){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = usernames.find(username);
+    if(found == usernames.end()){
+        return -1;
+    }
+    const UserRow& row = users.at(found->second);
+    if(row.password != password){
+        return -1;
+    }
+    account.balance = row.balance;
+    account.version = row.version;
+    return found->second;
+}
+
+
+bool EmbeddedStorage::account(int userID, AccountVersion& account){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return false;
+    }
+    account.balance = found->second.balance;
+    account.version = found->second.version;
+    return true;
+}
+
+
+int EmbeddedStorage::adjustBalance(int userID, double delta, AccountVersion& account){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return TRADE_USER_NOT_FOUND;
+    }
+    const UserRow& row = found->second;
+    bool stale = row.version != account.version;
+    if(stale || row.balance + delta < 0){
+        account.balance = row.balance;
+        account.version = row.version;
+        return stale ? TRADE_STALE : TRADE_INSUFFICIENT;
+    }
+
+    std::string block;
+    addRecord(block, {"B", std::to_string(userID), number(row.balance + delta)});
+    addRecord(block, {"E"});
+    commit(block);
+    account.balance = row.balance;
+    account.version = row.version;
+    return TRADE_OK;
+}
+
+
+int EmbeddedStorage::trade(int userID, const std::string& symbol, Side side, int quantity, double price,
+                           AccountVersion& account){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return TRADE_USER_NOT_FOUND;
+    }
+    const UserRow& row = found->second;
+    account.balance = row.balance;
+    if(row.version != account.version){
+        account.version = row.version;
+        return TRADE_STALE;
+    }
+
+    // The same checks TradeBuy / TradeSell make
+    double balance = row.balance;
+    Position position;
+    auto held = row.positions.find(symbol);
+    if(held != row.positions.end()){
+        position = held->second;
+    }
+    if(side == Side::Buy){
+        if(price * quantity > balance){
+            return TRADE_INSUFFICIENT;
+        }
+        balance -= price * quantity;
+        addToPosition(position, quantity, price);
+    } else {
+        if(position.quantity < quantity){
+            return TRADE_INSUFFICIENT;
+        }
+        balance += price * quantity;
+        relievePosition(position, quantity);
+    }
+
+    std::string id = std::to_string(userID);
+    std::string block;
+    addRecord(block, {"B", id, number(balance)});
+    addRecord(block, {"P", id, symbol, std::to_string(position.quantity), number(position.costBasis)});
+    addRecord(block, {"T", id, symbol, side == Side::Buy ? "B" : "S", std::to_string(quantity), number(price), now()});
+    addRecord(block, {"E"});
+    commit(block);
+    account.balance = row.balance;
+    account.version = row.version;
+    return TRADE_OK;
+}
+
+
+bool EmbeddedStorage::transact(const std::vector<int>& userIDs, const std::vector<std::string>& symbols,
+                               const AccountUpdate& update){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    std::unordered_map<int, AccountState> accounts;
+    for(int userID : userIDs){
+        auto found = users.find(userID);
+        if(found == users.end()){
+            throw std::runtime_error("User not found");
+        }
+        AccountState& account = accounts[userID];
+        account.balance = found->second.balance;
+        for(const std::string& symbol : symbols){
+            auto held = found->second.positions.find(symbol);
+            if(held != found->second.positions.end()){
+                account.positions[symbol] = held->second;
+            }
+        }
+    }
+
+    std::unordered_map<int, AccountState> locked = accounts;
+    std::vector<TransactionRecord> trades;
+    if(!update(accounts, trades)){
+        return false;
+    }
+
+    // Log only what the update changed
+    std::string block;
+    for(const auto& account : accounts){
+        std::string id = std::to_string(account.first);
+        const AccountState& before = locked[account.first];
+        if(account.second.balance != before.balance){
+            addRecord(block, {"B", id, number(account.second.balance)});
+        }
+        for(const auto& entry : account.second.positions){
+            auto previous = before.positions.find(entry.first);
+            if(!samePosition(entry.second, previous == before.positions.end() ? Position() : previous->second)){
+                addRecord(block, {"P", id, entry.first, std::to_string(entry.second.quantity),
+                                  number(entry.second.costBasis)});
+            }
+        }
+    }
+    std::string date = now();
+    for(const TransactionRecord& trade : trades){
+        addRecord(block, {"T", std::to_string(trade.userID), trade.symbol, trade.side == Side::Buy ? "B" : "S",
+                          std::to_string(trade.quantity), number(trade.price), date});
+    }
+    if(!block.empty()){
+        addRecord(block, {"E"});
+        commit(block);
+    }
+    return true;
+}
+
+
+std::unordered_map<std::string, Position> EmbeddedStorage::positions(int userID){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return {};
+    }
+    return found->second.positions;
+}
+
+
+void EmbeddedStorage::replacePositions(int userID, const std::unordered_map<std::string, Position>& positions){
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return;
+    }
+
+    std::string id = std::to_string(userID);
+    std::string block;
+    for(const auto& entry : found->second.positions){
+        if(!positions.count(entry.first)){
+            addRecord(block, {"P", id, entry.first, "0", "0"});
+        }
+    }
+    for(const auto& entry : positions){
+        addRecord(block, {"P", id, entry.first, std::to_string(entry.second.quantity), number(entry.second.costBasis)});
+    }
+    if(!block.empty()){
+        addRecord(block, {"E"});
+        commit(block);
+    }
+}
+
+
+std::vector<TransactionRecord> EmbeddedStorage::transactionPage(int userID, const TransactionFilter& filter,
+                                                               const TransactionKey& after, size_t limit){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = users.find(userID);
+    if(found == users.end()){
+        return {};
+    }
+    const std::vector<TransactionRecord>& history = found->second.transactions;
+
+    // Seek to the first row past both the keyset and the start of the range
+    auto row = history.begin();
+    if(!after.date.empty()){
+        row = std::upper_bound(history.begin(), history.end(), after, [](const TransactionKey& key, const TransactionRecord& record){
+            return key.date < record.date || (key.date == record.date && key.transactionID < record.transactionID);
+        });
+    }
+    if(!filter.fromDate.empty()){
+        row = std::lower_bound(row, history.end(), filter.fromDate, [](const TransactionRecord& record, const std::string& date){
+            return record.date < date;
+        });
+    }
+
+    std::vector<TransactionRecord> page;
+    for(; row != history.end() && page.size() < limit; ++row){
+        if(!filter.toDate.empty() && row->date >= filter.toDate){
+            break;
+        }
+        if(filter.symbol.empty() || row->symbol == filter.symbol){
+            page.push_back(*row);
+        }
+    }
+    return page;
+}
+
+
+void EmbeddedStorage::upsertQuotes(const std::vector<const Quote*>& quotes){
+    if(quotes.empty()){
+        return;
+    }
+    std::string block;
+    for(const Quote* quote : quotes){
+        addRecord(block, {"S", std::string(quote->symbol), number(quote->price), std::string(quote->companyName)});
+    }
+    addRecord(block, {"E"});
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    commit(block);
+}
+
+
+std::vector<std::pair<std::string, double>> EmbeddedStorage::stockPrices(){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<std::pair<std::string, double>> priced;
+    priced.reserve(stocks.size());
+    for(const auto& stock : stocks){
+        priced.emplace_back(stock.first, stock.second.price);
+    }
+    return priced;
+}
+
+
+bool EmbeddedStorage::stockPrice(const std::string& symbol, double& price){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = stocks.find(symbol);
+    if(found == stocks.end()){
+        return false;
+    }
+    price = found->second.price;
+    return true;
+}
+
+
+std::vector<std::string> EmbeddedStorage::stockSymbols(){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<std::string> names;
+    names.reserve(stocks.size());
+    for(const auto& stock : stocks){
+        names.push_back(stock.first);
+    }
+    return names;
+}
+
+
+std::string EmbeddedStorage::storeID(){
+    return identity;
+}
+
+
+uint64_t EmbeddedStorage::journalCheckpoint(){
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return appliedSequence;
+}
+
+
+void EmbeddedStorage::applyJournal(const std::vector<JournalRecord>& records){
+    if(records.empty()){
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    // Net to one absolute balance and position per user and symbol, like the MySQL batch
+    std::map<int, double> balancesAfter;
+    std::map<std::pair<int, std::string>, Position> positionsAfter;
+    std::string trades;
+    for(const JournalRecord& record : records){
+        auto found = users.find(record.userID);
+        if(found == users.end()){
+            continue;   // an UPDATE against MySQL would match nothing either
+        }
+        double& balance = balancesAfter.emplace(record.userID, found->second.balance).first->second;
+        auto position = [&]() -> Position& {
+            auto key = std::make_pair(record.userID, record.symbol);
+            auto slot = positionsAfter.find(key);
+            if(slot == positionsAfter.end()){
+                auto held = found->second.positions.find(record.symbol);
+                slot = positionsAfter.emplace(key, held == found->second.positions.end() ? Position() : held->second).first;
+            }
+            return slot->second;
+        };
+
+        switch(record.type){
+            case JournalEntry::Buy:
+                balance -= record.price * record.quantity;
+                addToPosition(position(), record.quantity, record.price);
+                break;
+            case JournalEntry::Sell: {
+                balance += record.price * record.quantity;
+                Position& sold = position();
+                sold.quantity -= record.quantity;
+                sold.costBasis -= record.costRelieved;
+                break;
+            }
+            case JournalEntry::Deposit:
+                balance += record.price;
+                break;
+            case JournalEntry::Withdraw:
+                balance -= record.price;
+                break;
+        }
+        if(record.type == JournalEntry::Buy || record.type == JournalEntry::Sell){
+            addRecord(trades, {"T", std::to_string(record.userID), record.symbol,
+                               record.type == JournalEntry::Buy ? "B" : "S", std::to_string(record.quantity),
+                               number(record.price), formatDate(record.timestamp)});
+        }
+    }
+
+    std::string block;
+    for(const auto& balance : balancesAfter){
+        addRecord(block, {"B", std::to_string(balance.first), number(balance.second)});
+    }
+    for(const auto& position : positionsAfter){
+        addRecord(block, {"P", std::to_string(position.first.first), position.first.second,
+                          std::to_string(position.second.quantity), number(position.second.costBasis)});
+    }
+    block += trades;
+    addRecord(block, {"C", std::to_string(records.back().sequence)});
+    addRecord(block, {"E"});
+    commit(block);
+}
@@ -0,0 +1,131 @@
+#ifndef EMBEDDEDSTORAGE_H
+#define EMBEDDEDSTORAGE_H
+
+#include "storage.h"
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// In-process store for a single-user desktop session: no server, reads are a hash lookup
+// under a shared lock. Users are indexed by ID and by username, each user owns a position
+// map and an append-only transaction vector.
+//
+// Every change is one block of tab-separated records ending in an "E" line, appended to
+// <directory>/log before it is applied, so what is in memory is always a replay of the log.
+// Records carry absolute values (a balance, a whole position) rather than deltas. Once the
+// log passes compactBytes, and on shutdown, the whole state is written to <directory>/snapshot
+// and the log starts over under the next generation number; a log whose generation the
+// snapshot already covers is discarded on open. Blocks are written without an fsync, so a
+// crashed process loses nothing but a power cut can lose the newest ones; enable the trade
+// journal when every acknowledged trade has to survive that too. An open store holds an flock
+// on <directory>/lock, so a second process opening the same directory fails instead of
+// corrupting it.
+class EmbeddedStorage : public Storage {
+
+    private:
+        struct UserRow {
+            std::string username;
+            std::string password;
+            double balance = 0.0;
+            uint64_t version = 0;   // bumped by every applied "B" record, so it restarts on reopen
+            std::unordered_map<std::string, Position> positions;
+            std::vector<TransactionRecord> transactions;   // by (date, transactionID)
+        };
+
+        struct StockRow {
+            std::string companyName;
+            double price = 0.0;
+        };
+
+        std::string directory;
+        std::string identity;   // kept in <directory>/storeid
+        int lockFd = -1;
+        int logFd = -1;
+        uint64_t logBytes = 0;
+        uint64_t compactBytes;
+        uint64_t generation = 0;   // of the current log; the snapshot covers every earlier one
+
+        mutable std::shared_mutex mutex;
+        std::unordered_map<int, UserRow> users;
+        std::unordered_map<std::string, int> usernames;
+        int nextUserID = 1;
+        int64_t nextTransactionID = 1;   // numbered in replay order, so IDs restart on reopen
+        std::unordered_map<std::string, StockRow> stocks;
+        uint64_t appliedSequence = 0;
+
+        // Applies every complete block in `contents`; returns the length of that prefix
+        size_t replay(const std::string& contents);
+
+        void applyRecord(const std::vector<std::string>& fields);
+
+        // Caller holds the exclusive lock. Logs the block, then applies it.
+        void commit(const std::string& block);
+
+        // Caller holds the exclusive lock
+        void writeSnapshot();
+
+        void startLog();
+
+        // Reads the store's ID, creating one for a new directory
+        void loadIdentity();
+
+        // Loads the snapshot and replays the log; the caller holds the directory lock
+        void load();
+
+    public:
+
+    // compactBytes is the log size that triggers a snapshot
+    explicit EmbeddedStorage(const std::string& directory, uint64_t compactBytes = 64 << 20);
+
+    // Snapshots the state so the next open replays nothing
+    ~EmbeddedStorage() override;
+
+    EmbeddedStorage(const EmbeddedStorage&) = delete;
+
+    EmbeddedStorage& operator=(const EmbeddedStorage&) = delete;
+
+    std::unique_ptr<StorageCall> beginCall() override { return nullptr; }
+
+    size_t roundTrips() const override { return 0; }
+
+    int createUser(const std::string& username, const std::string& password) override;
+
+    int findUser(const std::string& username, const std::string& password, AccountVersion& account) override;
+
+    bool account(int userID, AccountVersion& account) override;
+
+    int adjustBalance(int userID, double delta, AccountVersion& account) override;
+
+    int trade(int userID, const std::string& symbol, Side side, int quantity, double price,
+              AccountVersion& account) override;
+
+    bool transact(const std::vector<int>& userIDs, const std::vector<std::string>& symbols,
+                  const AccountUpdate& update) override;
+
+    std::unordered_map<std::string, Position> positions(int userID) override;
+
+    void replacePositions(int userID, const std::unordered_map<std::string, Position>& positions) override;
+
+    std::vector<TransactionRecord> transactionPage(int userID, const TransactionFilter& filter,
+                                                   const TransactionKey& after, size_t limit) override;
+
+    std::vector<int> tradersMissingPositions() override { return {}; }
+
+    void upsertQuotes(const std::vector<const Quote*>& quotes) override;
+
+    std::vector<std::pair<std::string, double>> stockPrices() override;
+
+    bool stockPrice(const std::string& symbol, double& price) override;
+
+    std::vector<std::string> stockSymbols() override;
+
+    std::string storeID() override;
+
+    uint64_t journalCheckpoint() override;
+
+    void applyJournal(const std::vector<JournalRecord>& records) override;
+};
+
+#endif // EMBEDDEDSTORAGE_H
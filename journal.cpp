@@ -0,0 +1,401 @@
+#include "journal.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <unistd.h>
+
+
+namespace {
+    constexpr size_t RECORD_HEADER_BYTES = 2 * sizeof(uint32_t);
+    constexpr char FILE_MAGIC[] = "TJNL1\n";   // then the store ID and a newline
+
+    uint32_t crc32(const char* data, size_t length){
+        static const auto table = []{
+            std::vector<uint32_t> entries(256);
+            for(uint32_t i = 0; i < 256; i++){
+                uint32_t value = i;
+                for(int bit = 0; bit < 8; bit++){
+                    value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for(size_t i = 0; i < length; i++){
+            crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    template<typename T>
+    void put(std::string& out, const T& value){
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool take(const char*& cursor, const char* end, T& value){
+        if(static_cast<size_t>(end - cursor) < sizeof(T)){
+            return false;
+        }
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+
+    void encode(const JournalRecord& record, std::string& out){
+        std::string payload;
+        put(payload, record.sequence);
+        put(payload, record.timestamp);
+        put(payload, static_cast<uint8_t>(record.type));
+        put(payload, static_cast<int32_t>(record.userID));
+        put(payload, static_cast<int32_t>(record.quantity));
+        put(payload, record.price);
+        put(payload, record.costRelieved);
+        put(payload, static_cast<uint16_t>(record.symbol.size()));
+        payload += record.symbol;
+
+        put(out, static_cast<uint32_t>(payload.size()));
+        put(out, crc32(payload.data(), payload.size()));
+        out += payload;
+    }
+
+    bool decode(const char* cursor, const char* end, JournalRecord& record){
+        uint8_t type;
+        int32_t userID;
+        int32_t quantity;
+        uint16_t symbolLength;
+        if(!take(cursor, end, record.sequence) || !take(cursor, end, record.timestamp) ||
+           !take(cursor, end, type) || !take(cursor, end, userID) || !take(cursor, end, quantity) ||
+           !take(cursor, end, record.price) || !take(cursor, end, record.costRelieved) ||
+           !take(cursor, end, symbolLength) || static_cast<size_t>(end - cursor) != symbolLength){
+            return false;
+        }
+        if(type < static_cast<uint8_t>(JournalEntry::Buy) || type > static_cast<uint8_t>(JournalEntry::Withdraw)){
+            return false;
+        }
+        record.type = static_cast<JournalEntry>(type);
+        record.userID = userID;
+        record.quantity = quantity;
+        record.symbol.assign(cursor, symbolLength);
+        return true;
+    }
+
+    bool writeAll(int fd, const std::string& data){
+        const char* cursor = data.data();
+        size_t remaining = data.size();
+        while(remaining > 0){
+            ssize_t written = ::write(fd, cursor, remaining);
+            if(written < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+            cursor += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool syncFile(int fd){
+#ifdef __APPLE__
+        // fsync on macOS stops at the drive cache; F_FULLFSYNC is what actually makes it durable
+        if(::fcntl(fd, F_FULLFSYNC) == 0){
+            return true;
+        }
+        return ::fsync(fd) == 0;
+#else
+        return ::fdatasync(fd) == 0;
+#endif
+    }
+}
+
+
+
+TradeJournal::TradeJournal(const std::string& path, const std::string& storeID, size_t batchLimit,
+                           Clock::duration flushInterval)
+    : path(path), batchLimit(batchLimit), flushInterval(flushInterval)
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0){
+        throw std::runtime_error("Could not open trade journal: " + path);
+    }
+    // Held until close; a second writer would interleave appends and truncate under us
+    if(::flock(fd, LOCK_EX | LOCK_NB) != 0){
+        ::close(fd);
+        throw std::runtime_error("Trade journal " + path + " is in use by another process.");
+    }
+
+    std::string header = std::string(FILE_MAGIC) + storeID + "\n";
+    headerBytes = header.size();
+    std::string existing(header.size(), '\0');
+    ssize_t got = ::pread(fd, &existing[0], existing.size(), 0);
+    // A crash while the header was first written leaves a prefix of it and no records
+    bool tornHeader = got > 0 && got < static_cast<ssize_t>(header.size()) &&
+                      existing.compare(0, static_cast<size_t>(got), header, 0, static_cast<size_t>(got)) == 0;
+    if(got == 0 || tornHeader){
+        if(tornHeader && ::ftruncate(fd, 0) != 0){
+            ::close(fd);
+            throw std::runtime_error("Could not truncate trade journal header: " + path);
+        }
+        if(!writeAll(fd, header) || !syncFile(fd)){
+            ::close(fd);
+            throw std::runtime_error("Could not write trade journal header: " + path);
+        }
+    } else if(got != static_cast<ssize_t>(header.size()) || existing != header){
+        ::close(fd);
+        throw std::runtime_error("Trade journal " + path + " was written for a different store; "
+                                 "apply it against that store or move it aside.");
+    }
+}
+
+
+TradeJournal::~TradeJournal(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    writerWake.notify_all();
+    flusherWake.notify_all();
+
+    if(writerThread.joinable()){
+        writerThread.join();
+    }
+    if(flusherThread.joinable()){
+        flusherThread.join();
+    }
+    ::close(fd);
+}
+
+
+std::vector<JournalRecord> TradeJournal::recover(uint64_t applied){
+    std::string contents;
+    char buffer[65536];
+    ssize_t got;
+    ::lseek(fd, 0, SEEK_SET);
+    while((got = ::read(fd, buffer, sizeof(buffer))) > 0){
+        contents.append(buffer, static_cast<size_t>(got));
+    }
+
+    std::vector<JournalRecord> tail;
+    uint64_t lastSequence = applied;
+    size_t offset = headerBytes;
+    while(contents.size() - offset >= RECORD_HEADER_BYTES){
+        uint32_t length;
+        uint32_t checksum;
+        std::memcpy(&length, contents.data() + offset, sizeof(length));
+        std::memcpy(&checksum, contents.data() + offset + sizeof(length), sizeof(checksum));
+        const char* payload = contents.data() + offset + RECORD_HEADER_BYTES;
+        if(contents.size() - offset - RECORD_HEADER_BYTES < length || crc32(payload, length) != checksum){
+            break;
+        }
+
+        JournalRecord record;
+        if(!decode(payload, payload + length, record)){
+            break;
+        }
+        if(record.sequence > applied){
+            tail.push_back(record);
+        }
+        lastSequence = std::max(lastSequence, record.sequence);
+        offset += RECORD_HEADER_BYTES + length;
+    }
+
+    if(offset < contents.size()){
+        std::cerr << "Trade journal: discarding " << (contents.size() - offset) << " bytes of torn tail." << std::endl;
+        if(::ftruncate(fd, static_cast<off_t>(offset)) != 0){
+            throw std::runtime_error("Could not truncate torn trade journal tail.");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    fileBytes = offset - headerBytes;
+    nextSequence = lastSequence + 1;
+    return tail;
+}
+
+
+void TradeJournal::start(Applier applier, uint64_t applied){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        apply = std::move(applier);
+        nextSequence = std::max(nextSequence, applied + 1);
+        durableSequence = nextSequence - 1;
+        pendingSequence = durableSequence;
+        appliedSequence = applied;
+
+        // Everything recovered has been applied, so the old contents are no longer needed
+        if(appliedSequence == durableSequence && fileBytes > 0 && ::ftruncate(fd, static_cast<off_t>(headerBytes)) == 0){
+            fileBytes = 0;
+        }
+    }
+
+    writerThread = std::thread(&TradeJournal::writerLoop, this);
+    flusherThread = std::thread(&TradeJournal::flusherLoop, this);
+}
+
+
+uint64_t TradeJournal::enqueue(JournalRecord record){
+    std::vector<JournalRecord> single;
+    single.push_back(std::move(record));
+    return enqueue(std::move(single));
+}
+
+
+uint64_t TradeJournal::enqueue(std::vector<JournalRecord> batch){
+    std::lock_guard<std::mutex> lock(mutex);
+    if(failed){
+        throw std::runtime_error("Trade journal is not writable.");
+    }
+    for(JournalRecord& record : batch){
+        record.sequence = nextSequence++;
+        encode(record, pending);
+        pendingSequence = record.sequence;
+        unapplied.push_back(std::move(record));
+        records++;
+    }
+    writerWake.notify_one();
+    return pendingSequence;
+}
+
+
+void TradeJournal::waitDurable(uint64_t sequence){
+    std::unique_lock<std::mutex> lock(mutex);
+    durableChanged.wait(lock, [&]{ return durableSequence >= sequence || failed; });
+    if(durableSequence < sequence){
+        throw std::runtime_error("Trade journal write failed; the trade was not recorded.");
+    }
+}
+
+
+void TradeJournal::drain(){
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = nextSequence - 1;
+    if(appliedSequence >= target){
+        return;
+    }
+    drainRequested = true;
+    flusherWake.notify_one();
+    appliedChanged.wait(lock, [&]{ return appliedSequence >= target || failed; });
+    if(appliedSequence < target){
+        throw std::runtime_error("Trade journal write failed; could not catch up.");
+    }
+}
+
+
+uint64_t TradeJournal::recordCount() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+uint64_t TradeJournal::syncCount() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return syncs;
+}
+
+
+void TradeJournal::writerLoop(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        writerWake.wait(lock, [this]{ return !pending.empty() || truncateRequested || stopping; });
+
+        if(truncateRequested){
+            truncateRequested = false;
+            if(pending.empty() && appliedSequence == durableSequence &&
+               ::ftruncate(fd, static_cast<off_t>(headerBytes)) == 0){
+                fileBytes = 0;
+            }
+        }
+        if(pending.empty()){
+            if(stopping){
+                break;
+            }
+            continue;
+        }
+
+        // Everything queued while the previous fsync ran goes out in this one
+        std::string batch;
+        batch.swap(pending);
+        uint64_t last = pendingSequence;
+        lock.unlock();
+        bool written = writeAll(fd, batch) && syncFile(fd);
+        lock.lock();
+
+        if(!written){
+            std::cerr << "Trade journal write to " << path << " failed: " << std::strerror(errno) << std::endl;
+            failed = true;
+            durableChanged.notify_all();
+            appliedChanged.notify_all();
+            break;
+        }
+        durableSequence = last;
+        fileBytes += batch.size();
+        syncs++;
+        durableChanged.notify_all();
+        flusherWake.notify_one();
+    }
+    writerDone = true;
+    flusherWake.notify_one();
+}
+
+
+void TradeJournal::flusherLoop(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        // Apply in large batches: when enough is durable, on every interval, or when someone drains
+        flusherWake.wait_for(lock, flushInterval, [this]{
+            uint64_t ready = durableSequence - appliedSequence;
+            return (ready > 0 && (ready >= batchLimit || drainRequested)) || (stopping && writerDone);
+        });
+
+        std::vector<JournalRecord> batch;
+        for(const JournalRecord& record : unapplied){
+            if(record.sequence > durableSequence || batch.size() >= batchLimit){
+                break;
+            }
+            batch.push_back(record);
+        }
+        if(batch.empty()){
+            if(stopping && writerDone){
+                break;
+            }
+            continue;
+        }
+
+        lock.unlock();
+        bool applied = true;
+        try{
+            apply(batch);
+        } catch (const std::exception& e){
+            std::cerr << "Failed to apply trade journal batch: " << e.what() << std::endl;
+            applied = false;
+        }
+        lock.lock();
+
+        if(!applied){
+            if(stopping && writerDone){
+                break; // left in the file for recovery on the next start
+            }
+            flusherWake.wait_for(lock, flushInterval);
+            continue;
+        }
+
+        unapplied.erase(unapplied.begin(), unapplied.begin() + static_cast<std::ptrdiff_t>(batch.size()));
+        appliedSequence = batch.back().sequence;
+        if(appliedSequence >= nextSequence - 1){
+            drainRequested = false;
+        }
+        appliedChanged.notify_all();
+
+        if(appliedSequence == durableSequence && fileBytes >= truncateBytes){
+            truncateRequested = true;
+            writerWake.notify_one();
+        }
+    }
+}
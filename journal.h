@@ -0,0 +1,120 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+enum class JournalEntry : uint8_t { Buy = 1, Sell = 2, Deposit = 3, Withdraw = 4 };
+
+struct JournalRecord {
+    uint64_t sequence = 0;       // assigned by TradeJournal::enqueue
+    int64_t timestamp = 0;       // system_clock nanoseconds
+    JournalEntry type = JournalEntry::Buy;
+    int userID = 0;
+    int quantity = 0;            // trades only
+    double price = 0.0;          // per share for trades, the amount for deposits and withdrawals
+    double costRelieved = 0.0;   // sells only: average cost taken off the position
+    std::string symbol;          // trades only
+};
+
+
+// Append-only write-ahead log for account changes.
+// Callers enqueue records and wait for them to be durable; a writer thread fsyncs
+// whatever has accumulated since its last sync, so many concurrent records share one
+// fsync (group commit). A flusher thread hands durable records to the applier in
+// batches and, once everything written has been applied, truncates the file.
+// The file starts with a header naming the store it belongs to and is held under an
+// exclusive flock, so neither another process nor a different store can use it.
+// Each record is [length][crc32][payload]; recovery stops at the first record that
+// is short or fails its checksum, which is where a crash cut the file.
+class TradeJournal {
+
+    public:
+        using Applier = std::function<void(const std::vector<JournalRecord>&)>;
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        std::string path;
+        int fd = -1;
+        uint64_t headerBytes = 0;   // truncation keeps the header
+
+        size_t batchLimit;
+        Clock::duration flushInterval;
+        size_t truncateBytes = 4 << 20;   // only bother truncating once the file is this large
+        Applier apply;
+
+        mutable std::mutex mutex;
+        std::condition_variable writerWake;
+        std::condition_variable flusherWake;
+        std::condition_variable durableChanged;
+        std::condition_variable appliedChanged;
+
+        std::string pending;                   // encoded records not yet written
+        std::deque<JournalRecord> unapplied;   // written or pending, oldest first
+        uint64_t nextSequence = 1;
+        uint64_t pendingSequence = 0;          // last sequence in `pending`
+        uint64_t durableSequence = 0;
+        uint64_t appliedSequence = 0;
+        uint64_t fileBytes = 0;
+        uint64_t syncs = 0;
+        uint64_t records = 0;
+        bool truncateRequested = false;
+        bool drainRequested = false;
+        bool writerDone = false;
+        bool stopping = false;
+        bool failed = false;
+
+        std::thread writerThread;
+        std::thread flusherThread;
+
+        void writerLoop();
+        void flusherLoop();
+
+    public:
+
+    // Throws if another process holds the file or it was written for a store other than storeID
+    TradeJournal(const std::string& path, const std::string& storeID, size_t batchLimit = 512,
+                 Clock::duration flushInterval = std::chrono::milliseconds(200));
+
+    // Writes out and applies what it can, then stops both threads; anything left is recovered next start
+    ~TradeJournal();
+
+    TradeJournal(const TradeJournal&) = delete;
+
+    TradeJournal& operator=(const TradeJournal&) = delete;
+
+    // Reads back every intact record after `appliedSequence` and cuts off a torn tail.
+    // Call once, before start(); the caller applies the returned records itself.
+    std::vector<JournalRecord> recover(uint64_t appliedSequence);
+
+    // `appliedSequence` is the last sequence already reflected downstream
+    void start(Applier applier, uint64_t appliedSequence);
+
+    // Assigns the next sequence and queues the record for the writer; returns the sequence.
+    // Throws without queuing anything once a write has failed.
+    uint64_t enqueue(JournalRecord record);
+
+    // Queues the records under consecutive sequences, all or none; returns the last sequence
+    uint64_t enqueue(std::vector<JournalRecord> records);
+
+    // Blocks until `sequence` is on disk; throws if the journal can no longer write
+    void waitDurable(uint64_t sequence);
+
+    // Blocks until every record enqueued so far has been applied
+    void drain();
+
+    // Records written and fsyncs issued since start; records / syncs is the group commit factor
+    uint64_t recordCount() const;
+
+    uint64_t syncCount() const;
+};
+
+#endif // JOURNAL_H
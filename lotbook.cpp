@@ -0,0 +1,189 @@
+#include "lotbook.h"
+#include <algorithm>
+
+
+LotBook::LotBook(LotMethod method)
+    : lotMethod(method)
+{
+}
+
+
+LotMethod LotBook::method() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lotMethod;
+}
+
+void LotBook::setMethod(LotMethod method){
+    std::lock_guard<std::mutex> lock(mutex);
+    lotMethod = method;
+    users.clear();
+}
+
+
+bool LotBook::isLoaded(int userID) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return users.count(userID) > 0;
+}
+
+void LotBook::unload(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    users.erase(userID);
+}
+
+
+void LotBook::buy(SymbolLots& lots, int quantity, double price){
+    lots.quantity += quantity;
+    lots.costBasis += price * quantity;
+    lots.lots.push_back(Lot{quantity, price});
+}
+
+
+double LotBook::sell(LotMethod method, SymbolLots& lots, int quantity, double price){
+    int closing = std::min(quantity, lots.quantity);
+    if(closing <= 0){
+        return 0.0;
+    }
+
+    double relieved = 0.0;
+    if(method == LotMethod::AverageCost){
+        relieved = lots.costBasis * closing / lots.quantity;
+        // Kept as a single lot at the running average
+        lots.lots.clear();
+        if(lots.quantity > closing){
+            lots.lots.push_back(Lot{lots.quantity - closing, (lots.costBasis - relieved) / (lots.quantity - closing)});
+        }
+    } else {
+        int remaining = closing;
+        while(remaining > 0){
+            Lot& lot = (method == LotMethod::FIFO) ? lots.lots.front() : lots.lots.back();
+            int taken = std::min(remaining, lot.quantity);
+            relieved += lot.price * taken;
+            lot.quantity -= taken;
+            remaining -= taken;
+            if(lot.quantity == 0){
+                if(method == LotMethod::FIFO){
+                    lots.lots.pop_front();
+                } else {
+                    lots.lots.pop_back();
+                }
+            }
+        }
+    }
+
+    lots.quantity -= closing;
+    // Summing lot costs drifts; a closed position has no cost left by definition
+    lots.costBasis = (lots.quantity == 0) ? 0.0 : lots.costBasis - relieved;
+
+    double realized = price * closing - relieved;
+    lots.realized += realized;
+    return realized;
+}
+
+
+void LotBook::replay(LotMethod method, UserLots& ledger, const TransactionRecord& record) const{
+    SymbolLots& lots = ledger.symbols[record.symbol];
+    if(record.side == Side::Buy){
+        buy(lots, record.quantity, record.price);
+    } else {
+        ledger.realized += sell(method, lots, record.quantity, record.price);
+    }
+}
+
+
+uint64_t LotBook::generation(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    return activity[userID].generation;
+}
+
+
+bool LotBook::install(int userID, LotMethod method, uint64_t generation, UserLots ledger){
+    std::lock_guard<std::mutex> lock(mutex);
+    // Built under a method that has since changed; the next access rebuilds
+    if(method != lotMethod){
+        return false;
+    }
+    // A fill still in flight may or may not be in the history read, and one that finished
+    // meanwhile was ignored, so either way the ledger can't be trusted
+    const Activity& fills = activity[userID];
+    if(fills.pending > 0 || fills.generation != generation){
+        return false;
+    }
+    users[userID] = std::move(ledger);
+    return true;
+}
+
+
+void LotBook::beginFill(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    Activity& fills = activity[userID];
+    fills.pending++;
+    fills.generation = ++nextGeneration;
+}
+
+void LotBook::endFill(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    Activity& fills = activity[userID];
+    fills.pending--;
+    fills.generation = ++nextGeneration;
+}
+
+
+LotBook::PendingFill::PendingFill(LotBook& book, std::initializer_list<int> userIDs)
+    : book(book), userIDs(userIDs)
+{
+    for(int userID : this->userIDs){
+        book.beginFill(userID);
+    }
+}
+
+LotBook::PendingFill::~PendingFill(){
+    for(int userID : userIDs){
+        book.endFill(userID);
+    }
+}
+
+
+void LotBook::applyBuy(int userID, const std::string& symbol, int quantity, double price){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return;
+    }
+    buy(user->second.symbols[symbol], quantity, price);
+}
+
+
+void LotBook::applySell(int userID, const std::string& symbol, int quantity, double price){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return;
+    }
+    user->second.realized += sell(lotMethod, user->second.symbols[symbol], quantity, price);
+}
+
+
+double LotBook::realized(int userID) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    return (user == users.end()) ? 0.0 : user->second.realized;
+}
+
+
+std::vector<LotPosition> LotBook::positions(int userID) const{
+    std::vector<LotPosition> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto user = users.find(userID);
+        if(user == users.end()){
+            return result;
+        }
+        result.reserve(user->second.symbols.size());
+        for(const auto& entry : user->second.symbols){
+            const SymbolLots& lots = entry.second;
+            result.push_back(LotPosition{entry.first, lots.quantity, lots.costBasis, lots.realized, lots.lots.size()});
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const LotPosition& a, const LotPosition& b){ return a.symbol < b.symbol; });
+    return result;
+}
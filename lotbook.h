@@ -0,0 +1,150 @@
+#ifndef LOTBOOK_H
+#define LOTBOOK_H
+
+#include "storage.h"
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Which open lots a sell closes
+enum class LotMethod {
+    FIFO,          // oldest first
+    LIFO,          // newest first
+    AverageCost,   // one pooled lot, as Positions.CostBasis does
+};
+
+// One symbol of a user's lot ledger
+struct LotPosition {
+    std::string symbol;
+    int quantity = 0;
+    double costBasis = 0.0;   // cost of the lots still open
+    double realized = 0.0;    // proceeds less relieved cost over every sell so far
+    size_t openLots = 0;
+};
+
+
+// Per-user tax lots, rebuilt from the transaction history on first access and then kept
+// current by Database on every fill. Realized P&L is a running total, so reading it costs
+// nothing; unrealized P&L is one price per open symbol. Users that are not loaded ignore
+// fills, since their next load replays them from storage.
+class LotBook {
+
+    private:
+        struct Lot {
+            int quantity;
+            double price;
+        };
+
+        struct SymbolLots {
+            std::deque<Lot> lots;   // oldest at the front
+            int quantity = 0;
+            double costBasis = 0.0;
+            double realized = 0.0;
+        };
+
+        struct UserLots {
+            std::unordered_map<std::string, SymbolLots> symbols;
+            double realized = 0.0;
+        };
+
+        // Fills a rebuild may have missed: one in flight, or one that began or ended after the
+        // rebuild read `generation`
+        struct Activity {
+            uint64_t generation = 0;
+            int pending = 0;
+        };
+
+        mutable std::mutex mutex;
+        LotMethod lotMethod;
+        std::unordered_map<int, UserLots> users;
+        std::unordered_map<int, Activity> activity;
+        uint64_t nextGeneration = 0;
+
+        static void buy(SymbolLots& lots, int quantity, double price);
+
+        // Closes up to `quantity` shares by `method`; returns the realized P&L. History that
+        // sells more than it held (a Positions rebuild clamps the same way) only closes what is open.
+        static double sell(LotMethod method, SymbolLots& lots, int quantity, double price);
+
+        void replay(LotMethod method, UserLots& ledger, const TransactionRecord& record) const;
+
+        uint64_t generation(int userID);
+
+        // False, leaving the user unloaded, if the method changed or a fill overlapped the rebuild
+        bool install(int userID, LotMethod method, uint64_t generation, UserLots ledger);
+
+        void beginFill(int userID);
+
+        void endFill(int userID);
+
+    public:
+
+        // Marks users as having a fill on its way to storage for as long as it lives. Without
+        // this, a fill committed after a rebuild read the history but applied before the rebuild
+        // installed would be lost, since fills for users that are not loaded are ignored.
+        class PendingFill {
+
+            private:
+                LotBook& book;
+                std::vector<int> userIDs;
+
+            public:
+
+            PendingFill(LotBook& book, std::initializer_list<int> userIDs);
+
+            ~PendingFill();
+
+            PendingFill(const PendingFill&) = delete;
+            PendingFill& operator=(const PendingFill&) = delete;
+        };
+
+    explicit LotBook(LotMethod method = LotMethod::FIFO);
+
+    LotMethod method() const;
+
+    // Unloads every user, so the next access rebuilds under the new method
+    void setMethod(LotMethod method);
+
+    bool isLoaded(int userID) const;
+
+    void unload(int userID);
+
+    // Replaces the user's ledger with one built from `next`, which fills in the next
+    // transaction oldest first and returns false at the end. The ledger is built without
+    // holding the book's lock, and is thrown away if the method changed or a PendingFill for
+    // the user was live at any point meanwhile; the caller retries then. Returns false if the
+    // ledger was thrown away, and counts the transactions replayed in `replayed`.
+    template<typename Next>
+    bool rebuild(int userID, Next next, size_t* replayed = nullptr){
+        LotMethod method = this->method();
+        uint64_t started = generation(userID);
+        UserLots ledger;
+        TransactionRecord record;
+        size_t count = 0;
+        while(next(record)){
+            replay(method, ledger, record);
+            count++;
+        }
+        if(replayed){
+            *replayed = count;
+        }
+        return install(userID, method, started, std::move(ledger));
+    }
+
+    void applyBuy(int userID, const std::string& symbol, int quantity, double price);
+
+    void applySell(int userID, const std::string& symbol, int quantity, double price);
+
+    double realized(int userID) const;
+
+    // Open and closed symbols, by symbol
+    std::vector<LotPosition> positions(int userID) const;
+};
+
+#endif // LOTBOOK_H
@@ -0,0 +1,280 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace {
+    // One thread's recordings. Only the owning thread writes; histograms are allocated on first use.
+    struct ThreadSlot {
+        std::array<std::atomic<LatencyHistogram*>, Metrics::MAX_HISTOGRAMS> histograms{};
+        std::array<std::atomic<uint64_t>, Metrics::COUNTERS> counters{};
+
+        ~ThreadSlot(){
+            for(auto& histogram : histograms){
+                delete histogram.load();
+            }
+        }
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::string> names;
+        std::unordered_map<std::string, size_t> ids;
+        std::vector<std::unique_ptr<ThreadSlot>> slots;
+        std::vector<ThreadSlot*> released;
+    };
+
+    Registry& registry(){
+        static Registry* instance = new Registry();   // never destroyed: threads may record during exit
+        return *instance;
+    }
+
+    // Leases a slot for the life of the thread and gives it back when the thread exits
+    struct SlotLease {
+        ThreadSlot* slot;
+
+        SlotLease(){
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if(!shared.released.empty()){
+                slot = shared.released.back();
+                shared.released.pop_back();
+            } else {
+                shared.slots.push_back(std::make_unique<ThreadSlot>());
+                slot = shared.slots.back().get();
+            }
+        }
+
+        ~SlotLease(){
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.released.push_back(slot);
+        }
+    };
+
+    ThreadSlot& threadSlot(){
+        thread_local SlotLease lease;
+        return *lease.slot;
+    }
+
+    // Single writer, so a relaxed load and store is enough and skips the locked instruction
+    void bump(std::atomic<uint64_t>& value, uint64_t amount){
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    double percentile(const std::vector<uint64_t>& counts, uint64_t total, double fraction){
+        if(total == 0){
+            return 0.0;
+        }
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+        uint64_t seen = 0;
+        for(size_t bucket = 0; bucket < counts.size(); bucket++){
+            seen += counts[bucket];
+            if(seen >= target){
+                return LatencyHistogram::upperBound(bucket) / 1000.0;
+            }
+        }
+        return LatencyHistogram::upperBound(counts.size() - 1) / 1000.0;
+    }
+}
+
+
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos){
+    nanos = std::min<uint64_t>(nanos, (uint64_t(1) << MAX_VALUE_BITS) - 1);
+    if(nanos < (uint64_t(2) << SUB_BUCKET_BITS)){
+        return static_cast<size_t>(nanos);
+    }
+    int msb = 63 - __builtin_clzll(nanos);
+    int shift = msb - SUB_BUCKET_BITS;
+    size_t sub = static_cast<size_t>(nanos >> shift) - (size_t(1) << SUB_BUCKET_BITS);
+    return (static_cast<size_t>(shift + 1) << SUB_BUCKET_BITS) + sub;
+}
+
+
+uint64_t LatencyHistogram::upperBound(size_t bucket){
+    if(bucket < (size_t(2) << SUB_BUCKET_BITS)){
+        return bucket;
+    }
+    int shift = static_cast<int>(bucket >> SUB_BUCKET_BITS) - 1;
+    uint64_t sub = (bucket & ((size_t(1) << SUB_BUCKET_BITS) - 1)) + (uint64_t(1) << SUB_BUCKET_BITS);
+    return ((sub + 1) << shift) - 1;
+}
+
+
+void LatencyHistogram::record(uint64_t nanos){
+    bump(counts[bucketOf(nanos)], 1);
+    bump(total, 1);
+    bump(sum, nanos);
+    if(nanos > max.load(std::memory_order_relaxed)){
+        max.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+
+void LatencyHistogram::mergeInto(std::vector<uint64_t>& mergedCounts, uint64_t& mergedTotal, uint64_t& mergedSum, uint64_t& mergedMax) const{
+    mergedCounts.resize(BUCKETS, 0);
+    for(size_t bucket = 0; bucket < BUCKETS; bucket++){
+        mergedCounts[bucket] += counts[bucket].load(std::memory_order_relaxed);
+    }
+    mergedTotal += total.load(std::memory_order_relaxed);
+    mergedSum += sum.load(std::memory_order_relaxed);
+    mergedMax = std::max(mergedMax, max.load(std::memory_order_relaxed));
+}
+
+
+
+size_t Metrics::histogram(const std::string& name){
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    auto found = shared.ids.find(name);
+    if(found != shared.ids.end()){
+        return found->second;
+    }
+    if(shared.names.size() >= MAX_HISTOGRAMS){
+        throw std::runtime_error("Too many metric histograms registered.");
+    }
+    shared.names.push_back(name);
+    return shared.ids[name] = shared.names.size() - 1;
+}
+
+
+void Metrics::record(size_t histogram, uint64_t nanos){
+    std::atomic<LatencyHistogram*>& entry = threadSlot().histograms[histogram];
+    LatencyHistogram* target = entry.load(std::memory_order_relaxed);
+    if(!target){
+        target = new LatencyHistogram();
+        entry.store(target, std::memory_order_release);
+    }
+    target->record(nanos);
+}
+
+
+void Metrics::add(Counter counter, uint64_t amount){
+    bump(threadSlot().counters[counter], amount);
+}
+
+
+std::vector<HistogramSummary> Metrics::histograms(){
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    std::vector<HistogramSummary> summaries;
+    for(size_t id = 0; id < shared.names.size(); id++){
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        for(const auto& slot : shared.slots){
+            if(LatencyHistogram* histogram = slot->histograms[id].load(std::memory_order_acquire)){
+                histogram->mergeInto(counts, total, sum, max);
+            }
+        }
+        if(total == 0){
+            continue;
+        }
+
+        HistogramSummary summary;
+        summary.name = shared.names[id];
+        summary.count = total;
+        summary.meanMicros = sum / 1000.0 / total;
+        summary.p50Micros = percentile(counts, total, 0.50);
+        summary.p90Micros = percentile(counts, total, 0.90);
+        summary.p99Micros = percentile(counts, total, 0.99);
+        summary.p999Micros = percentile(counts, total, 0.999);
+        summary.maxMicros = max / 1000.0;
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+
+uint64_t Metrics::counter(Counter counter){
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    uint64_t total = 0;
+    for(const auto& slot : shared.slots){
+        total += slot->counters[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+
+std::string Metrics::report(){
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << std::left << std::setw(28) << "histogram" << std::right
+        << std::setw(12) << "count" << std::setw(12) << "mean us" << std::setw(12) << "p50 us"
+        << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "p999 us"
+        << std::setw(12) << "max us" << "\n";
+    for(const HistogramSummary& summary : histograms()){
+        out << std::left << std::setw(28) << summary.name << std::right
+            << std::setw(12) << summary.count << std::setw(12) << summary.meanMicros
+            << std::setw(12) << summary.p50Micros << std::setw(12) << summary.p90Micros
+            << std::setw(12) << summary.p99Micros << std::setw(12) << summary.p999Micros
+            << std::setw(12) << summary.maxMicros << "\n";
+    }
+    out << "statements issued: " << counter(Statements) << "\n"
+        << "rows fetched:      " << counter(RowsFetched) << "\n"
+        << "bytes returned:    " << counter(BytesReturned) << "\n"
+        << "risk rejects:      rate " << counter(RiskOrderRate) << ", notional " << counter(RiskMaxNotional)
+        << ", position " << counter(RiskMaxPosition) << ", buying power " << counter(RiskBuyingPower) << "\n";
+    return out.str();
+}
+
+
+void Metrics::dump(const std::string& path){
+    // Written beside the target and renamed over it so a reader never sees half a report
+    std::string staging = path + ".tmp";
+    {
+        std::ofstream out(staging, std::ios::trunc);
+        if(!out){
+            throw std::runtime_error("Could not write metrics to " + path);
+        }
+        out << report();
+    }
+    if(std::rename(staging.c_str(), path.c_str()) != 0){
+        throw std::runtime_error("Could not write metrics to " + path);
+    }
+}
+
+
+
+MetricsDumper::MetricsDumper(const std::string& path, std::chrono::steady_clock::duration interval)
+    : path(path), interval(interval)
+{
+    thread = std::thread(&MetricsDumper::run, this);
+}
+
+
+MetricsDumper::~MetricsDumper(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+
+void MetricsDumper::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        bool stop = wake.wait_for(lock, interval, [this]{ return stopping; });
+        try{
+            Metrics::dump(path);
+        } catch (const std::exception& e){
+            std::cerr << e.what() << std::endl;
+        }
+        if(stop){
+            break;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Log-linear latency histogram in the style of HdrHistogram: values below 64ns get a bucket
+// each, every power of two above that is split into 32 buckets (about 3% relative error).
+// Values are nanoseconds and are clamped at 2^40 (about 18 minutes).
+// Written by one thread only; other threads may read it at any time.
+class LatencyHistogram {
+
+    public:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr int MAX_VALUE_BITS = 40;
+        static constexpr size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+        static size_t bucketOf(uint64_t nanos);
+
+        // Highest value that lands in the bucket
+        static uint64_t upperBound(size_t bucket);
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+    public:
+
+    void record(uint64_t nanos);
+
+    // Adds this histogram into a merged view
+    void mergeInto(std::vector<uint64_t>& mergedCounts, uint64_t& mergedTotal, uint64_t& mergedSum, uint64_t& mergedMax) const;
+};
+
+
+struct HistogramSummary {
+    std::string name;
+    uint64_t count = 0;
+    double meanMicros = 0.0;
+    double p50Micros = 0.0;
+    double p90Micros = 0.0;
+    double p99Micros = 0.0;
+    double p999Micros = 0.0;
+    double maxMicros = 0.0;
+};
+
+
+// Process-wide latency histograms and counters.
+// Each thread records into its own slot (plain relaxed stores, no shared cache lines and no
+// locks), and readers merge every slot when asked. Slots of exited threads are handed to the
+// next new thread, so their counts are kept and memory stays bounded by peak thread count.
+class Metrics {
+
+    public:
+        enum Counter : size_t { Statements, RowsFetched, BytesReturned,
+                                RiskOrderRate, RiskMaxNotional, RiskMaxPosition, RiskBuyingPower, COUNTERS };
+
+        static constexpr size_t MAX_HISTOGRAMS = 64;
+
+        // Registers a histogram once; the same name always returns the same id
+        static size_t histogram(const std::string& name);
+
+        static void record(size_t histogram, uint64_t nanos);
+
+        static void add(Counter counter, uint64_t amount = 1);
+
+        // Merged over every thread, in registration order; histograms never recorded are left out
+        static std::vector<HistogramSummary> histograms();
+
+        static uint64_t counter(Counter counter);
+
+        // Human-readable table of every histogram and counter
+        static std::string report();
+
+        static void dump(const std::string& path);
+};
+
+
+// Records the time from construction to destruction into a histogram
+class LatencyTimer {
+
+    private:
+        size_t histogram;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+
+    explicit LatencyTimer(size_t histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~LatencyTimer(){
+        Metrics::record(histogram, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
+
+
+// Rewrites Metrics::report() to a file on a fixed interval until destroyed
+class MetricsDumper {
+
+    private:
+        std::string path;
+        std::chrono::steady_clock::duration interval;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread thread;
+
+        void run();
+
+    public:
+
+    MetricsDumper(const std::string& path, std::chrono::steady_clock::duration interval);
+
+    // Writes one last report before returning
+    ~MetricsDumper();
+
+    MetricsDumper(const MetricsDumper&) = delete;
+
+    MetricsDumper& operator=(const MetricsDumper&) = delete;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,690 @@
+#include "mysqlstorage.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+
+namespace {
+    // Keeps the thread's outermost session checked out for one Database call
+    class PinnedSession : public StorageCall {
+        private:
+            SessionPool::Handle conn;
+
+        public:
+        explicit PinnedSession(SessionPool::Handle conn) : conn(std::move(conn)) {}
+    };
+
+    std::string placeholderList(size_t count){
+        std::string placeholders;
+        for(size_t i = 0; i < count; i++){
+            placeholders += (i == 0) ? "?" : ", ?";
+        }
+        return placeholders;
+    }
+
+    // Stored as the COMMENT of TradeBuy and TradeSell; bump it whenever either one changes
+    constexpr const char* TRADE_PROCEDURES_VERSION = "trade-procedures 2";
+
+    // Named lock held while installing them, so concurrent connects don't race on DROP/CREATE
+    constexpr const char* TRADE_PROCEDURES_LOCK = "trading.TradeProcedures";
+    constexpr int TRADE_PROCEDURES_LOCK_SECONDS = 30;
+}
+
+
+MysqlStorage::MysqlStorage(const std::string& url, size_t poolSize){
+    session = std::make_unique<mysqlx::Session>(url);
+    if(session){
+        std::cout << "SESSION FOUND" << std::endl;
+    }
+    session->getSchema("trading", true);
+
+    // Every operation checks out its own connection; the setup session above only runs DDL
+    if(poolSize == 0){
+        poolSize = std::max(2u, std::thread::hardware_concurrency());
+    }
+    pool = std::make_unique<SessionPool>(url, "trading", poolSize);
+
+    session->sql("USE trading").execute();
+
+    session->sql("CREATE TABLE IF NOT EXISTS Positions ("
+                 "UserID INT NOT NULL, "
+                 "Symbol VARCHAR(16) NOT NULL, "
+                 "Quantity INT NOT NULL DEFAULT 0, "
+                 "CostBasis DOUBLE NOT NULL DEFAULT 0, "
+                 "PRIMARY KEY (UserID, Symbol))").execute();
+
+    session->sql("CREATE TABLE IF NOT EXISTS JournalCheckpoint ("
+                 "ID INT PRIMARY KEY, "
+                 "AppliedSequence BIGINT UNSIGNED NOT NULL)").execute();
+
+    // Chosen once per schema; the first process to get here wins and everyone reads its value
+    session->sql("CREATE TABLE IF NOT EXISTS StoreIdentity ("
+                 "ID INT PRIMARY KEY, "
+                 "StoreID CHAR(32) NOT NULL)").execute();
+    session->sql("INSERT IGNORE INTO StoreIdentity (ID, StoreID) VALUES (1, ?)").bind(randomHex(16)).execute();
+    identity = (std::string) session->sql("SELECT StoreID FROM StoreIdentity WHERE ID = 1").execute().fetchOne()[0];
+
+    // Balance writes are conditional on this, so a session holding a cached balance learns when
+    // another one changed it; databases from before it existed get the column added once
+    mysqlx::Row versionColumn = session->sql("SELECT COUNT(*) FROM information_schema.COLUMNS "
+                                             "WHERE TABLE_SCHEMA = 'trading' AND TABLE_NAME = 'Users' "
+                                             "AND COLUMN_NAME = 'Version'").execute().fetchOne();
+    if(versionColumn[0].get<int>() == 0){
+        session->sql("ALTER TABLE Users ADD COLUMN Version BIGINT UNSIGNED NOT NULL DEFAULT 0").execute();
+    }
+
+    // History pages seek on this instead of sorting the user's whole history per page
+    mysqlx::Row historyIndex = session->sql("SELECT COUNT(*) FROM information_schema.STATISTICS "
+                                            "WHERE TABLE_SCHEMA = 'trading' AND TABLE_NAME = 'Transactions' "
+                                            "AND INDEX_NAME = 'UserDateID'").execute().fetchOne();
+    if(historyIndex[0].get<int>() == 0){
+        session->sql("CREATE INDEX UserDateID ON Transactions (UserID, Date, TransactionID)").execute();
+    }
+
+    createTradeProcedures();
+}
+
+
+MysqlStorage::~MysqlStorage(){
+    pool.reset();
+    if(session){
+        session->close();
+    }
+}
+
+
+void MysqlStorage::createTradeProcedures(){
+    const std::string comment = TRADE_PROCEDURES_VERSION;
+
+    // Status codes returned in the first column match the TRADE_* constants in storage.h; the
+    // balance and version after the call follow, and no row at all means the user is missing.
+    // The price is passed in from the in-process PriceTable rather than read from Stocks.
+    const std::string tradeBuy =
+        "CREATE PROCEDURE TradeBuy(IN pUserID INT, IN pSymbol VARCHAR(16), IN pQuantity INT, IN vPrice DOUBLE, "
+        "                          IN pVersion BIGINT UNSIGNED) "
+        "COMMENT '" + comment + "' "
+        "proc: BEGIN "
+        "  DECLARE EXIT HANDLER FOR SQLEXCEPTION BEGIN ROLLBACK; RESIGNAL; END; "
+        "  START TRANSACTION; "
+        "  UPDATE Users SET Balance = Balance - vPrice * pQuantity, Version = Version + 1 "
+        "    WHERE UserID = pUserID AND Version = pVersion AND Balance >= vPrice * pQuantity; "
+        "  IF ROW_COUNT() = 0 THEN "
+        "    ROLLBACK; "
+        "    SELECT IF(Version = pVersion, 3, 4), Balance, Version FROM Users WHERE UserID = pUserID; "
+        "    LEAVE proc; "
+        "  END IF; "
+        "  INSERT INTO Transactions (UserID, Symbol, Quantity, PriceAtTransaction, Type) "
+        "    VALUES (pUserID, pSymbol, pQuantity, vPrice, 'Buy'); "
+        "  INSERT INTO Positions (UserID, Symbol, Quantity, CostBasis) "
+        "    VALUES (pUserID, pSymbol, pQuantity, vPrice * pQuantity) "
+        "    ON DUPLICATE KEY UPDATE Quantity = Quantity + VALUES(Quantity), "
+        "    CostBasis = CostBasis + VALUES(CostBasis); "
+        "  COMMIT; "
+        "  SELECT 0, Balance, Version FROM Users WHERE UserID = pUserID; "
+        "END";
+
+    // Takes the Users row before the Positions row, in the same order as TradeBuy
+    const std::string tradeSell =
+        "CREATE PROCEDURE TradeSell(IN pUserID INT, IN pSymbol VARCHAR(16), IN pQuantity INT, IN vPrice DOUBLE, "
+        "                           IN pVersion BIGINT UNSIGNED) "
+        "COMMENT '" + comment + "' "
+        "proc: BEGIN "
+        "  DECLARE vHeld INT DEFAULT 0; "
+        "  DECLARE vCost DOUBLE DEFAULT 0; "
+        "  DECLARE EXIT HANDLER FOR SQLEXCEPTION BEGIN ROLLBACK; RESIGNAL; END; "
+        "  START TRANSACTION; "
+        "  UPDATE Users SET Balance = Balance + vPrice * pQuantity, Version = Version + 1 "
+        "    WHERE UserID = pUserID AND Version = pVersion; "
+        "  IF ROW_COUNT() = 0 THEN "
+        "    ROLLBACK; "
+        "    SELECT 4, Balance, Version FROM Users WHERE UserID = pUserID; "
+        "    LEAVE proc; "
+        "  END IF; "
+        "  SELECT Quantity, CostBasis INTO vHeld, vCost FROM Positions "
+        "    WHERE UserID = pUserID AND Symbol = pSymbol FOR UPDATE; "
+        "  IF vHeld < pQuantity THEN "
+        "    ROLLBACK; "
+        "    SELECT 3, Balance, Version FROM Users WHERE UserID = pUserID; "
+        "    LEAVE proc; "
+        "  END IF; "
+        "  INSERT INTO Transactions (UserID, Symbol, Quantity, PriceAtTransaction, Type) "
+        "    VALUES (pUserID, pSymbol, pQuantity, vPrice, 'Sell'); "
+        "  UPDATE Positions SET Quantity = Quantity - pQuantity, "
+        "    CostBasis = CostBasis - vCost * pQuantity / vHeld "
+        "    WHERE UserID = pUserID AND Symbol = pSymbol; "
+        "  COMMIT; "
+        "  SELECT 0, Balance, Version FROM Users WHERE UserID = pUserID; "
+        "END";
+
+    // Only a missing or older version is (re)created, so ordinary connects need no CREATE ROUTINE
+    auto current = [this]{
+        mysqlx::Row installed = session->sql("SELECT COUNT(*) FROM information_schema.ROUTINES "
+                                             "WHERE ROUTINE_SCHEMA = 'trading' AND ROUTINE_TYPE = 'PROCEDURE' "
+                                             "AND ROUTINE_NAME IN ('TradeBuy', 'TradeSell') AND ROUTINE_COMMENT = ?")
+                                          .bind(TRADE_PROCEDURES_VERSION).execute().fetchOne();
+        return installed[0].get<int>() == 2;
+    };
+    if(current()){
+        return;
+    }
+
+    mysqlx::Row locked = session->sql("SELECT GET_LOCK(?, ?)")
+                             .bind(TRADE_PROCEDURES_LOCK, TRADE_PROCEDURES_LOCK_SECONDS).execute().fetchOne();
+    if(locked[0].isNull() || locked[0].get<int>() != 1){
+        throw std::runtime_error("Timed out waiting for another process to install the trade procedures.");
+    }
+    try{
+        // Whoever held the lock before us may have installed them already
+        if(!current()){
+            session->sql("DROP PROCEDURE IF EXISTS TradeBuy").execute();
+            session->sql(tradeBuy).execute();
+            session->sql("DROP PROCEDURE IF EXISTS TradeSell").execute();
+            session->sql(tradeSell).execute();
+        }
+    } catch (const mysqlx::Error& e){
+        session->sql("SELECT RELEASE_LOCK(?)").bind(TRADE_PROCEDURES_LOCK).execute();
+        throw std::runtime_error(std::string("Could not install the trade procedures (") + TRADE_PROCEDURES_VERSION
+                                 + "); connect once as an account with CREATE ROUTINE and ALTER ROUTINE on trading: "
+                                 + e.what());
+    }
+    session->sql("SELECT RELEASE_LOCK(?)").bind(TRADE_PROCEDURES_LOCK).execute();
+}
+
+
+std::unique_ptr<StorageCall> MysqlStorage::beginCall(){
+    return std::make_unique<PinnedSession>(pool->acquire());
+}
+
+
+size_t MysqlStorage::roundTrips() const{
+    return SessionPool::threadRoundTrips();
+}
+
+
+int MysqlStorage::createUser(const std::string& username, const std::string& password){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table users = conn.table("Users");
+
+    // Check if the user already exists
+    mysqlx::RowResult check = conn.execute(users.select("Username")
+                                      .where("Username = :username")
+                                      .bind("username", username));
+    if(check.count()>0){
+        throw std::runtime_error("User already exists with the given username.");
+    }
+
+    // Insert new user with default balance of 0.0
+    conn.execute(users.insert("Username", "Password", "Balance")
+         .values(username, password, 0.0));
+
+    // Retrieve the newly created user's ID
+    mysqlx::RowResult result = conn.execute(users.select("UserID")
+                                 .where("Username = :username AND Password = :password")
+                                 .bind("username", username)
+                                 .bind("password", password));
+
+    mysqlx::Row row = conn.fetchOne(result);
+
+    if (!row.isNull()) {
+        return row[0].get<int>(); // Return the UserID
+    } else {
+        throw std::runtime_error("Failed to retrieve newly created user.");
+    }
+}
+
+
+int MysqlStorage::findUser(const std::string& username, const std::string& password, AccountVersion& account){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table users = conn.table("Users");
+
+    mysqlx::RowResult check = conn.execute(users.select("UserID", "Balance", "Version")
+                                .where("Username = :username AND Password = :password")
+                                .bind("username", username)
+                                .bind("password", password));
+
+    mysqlx::Row row = conn.fetchOne(check);
+    if(row.isNull()){
+        return -1;
+    }
+    account.balance = (double) row.get(1);
+    account.version = row[2].get<uint64_t>();
+    return (int) row.get(0);
+}
+
+
+bool MysqlStorage::account(int userID, AccountVersion& account){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table users = conn.table("Users");
+
+    mysqlx::Row row = conn.fetchOne(conn.execute(users.select("Balance", "Version")
+                                .where("UserID = :userID")
+                                .bind("userID", userID)));
+    if(row.isNull()){
+        return false;
+    }
+    account.balance = (double) row.get(0);
+    account.version = row[1].get<uint64_t>();
+    return true;
+}
+
+
+int MysqlStorage::adjustBalance(int userID, double delta, AccountVersion& account){
+    SessionPool::Handle conn = pool->acquire();
+
+    // Applies only at the version the caller read, so the result is known without reading it back
+    mysqlx::SqlResult updated = conn.execute(conn->sql("UPDATE Users SET Balance = Balance + ?, Version = Version + 1 "
+                                                       "WHERE UserID = ? AND Version = ? AND Balance + ? >= 0")
+                                             .bind(delta, userID, account.version, delta));
+    if(updated.getAffectedItemsCount() > 0){
+        account.balance += delta;
+        account.version++;
+        return TRADE_OK;
+    }
+
+    // Nothing matched: tell a missing user, a stale version and a balance that would go negative apart
+    mysqlx::Row row = conn.fetchOne(conn.execute(conn->sql("SELECT Balance, Version FROM Users WHERE UserID = ?").bind(userID)));
+    if(row.isNull()){
+        return TRADE_USER_NOT_FOUND;
+    }
+    uint64_t expected = account.version;
+    account.balance = (double) row.get(0);
+    account.version = row[1].get<uint64_t>();
+    return (account.version == expected) ? TRADE_INSUFFICIENT : TRADE_STALE;
+}
+
+
+int MysqlStorage::trade(int userID, const std::string& symbol, Side side, int quantity, double price,
+                        AccountVersion& account){
+    SessionPool::Handle conn = pool->acquire();
+
+    // TradeBuy / TradeSell write Users (at the caller's version), Transactions and Positions in
+    // one server-side transaction and return the resulting balance: one round trip
+    const char* call = (side == Side::Buy) ? "CALL TradeBuy(?, ?, ?, ?, ?)" : "CALL TradeSell(?, ?, ?, ?, ?)";
+    mysqlx::Row outcome = conn.fetchOne(conn.execute(conn->sql(call)
+                                        .bind(userID, symbol, quantity, price, account.version)));
+    if(outcome.isNull()){
+        return TRADE_USER_NOT_FOUND;
+    }
+    account.balance = (double) outcome.get(1);
+    account.version = outcome[2].get<uint64_t>();
+    return outcome[0].get<int>();
+}
+
+
+bool MysqlStorage::transact(const std::vector<int>& userIDs, const std::vector<std::string>& symbols,
+                            const AccountUpdate& update){
+    // Rows are locked in UserID order so two transactions over the same users cannot deadlock
+    std::vector<int> lockOrder(userIDs);
+    std::sort(lockOrder.begin(), lockOrder.end());
+    lockOrder.erase(std::unique(lockOrder.begin(), lockOrder.end()), lockOrder.end());
+
+    SessionPool::Handle conn = pool->acquire();
+    conn.startTransaction();
+    try{
+        mysqlx::SqlStatement userQuery = conn->sql("SELECT UserID, Balance FROM Users WHERE UserID IN ("
+                                                   + placeholderList(lockOrder.size()) + ") ORDER BY UserID FOR UPDATE");
+        for(int userID : lockOrder){
+            userQuery.bind(userID);
+        }
+        std::unordered_map<int, AccountState> accounts;
+        std::vector<mysqlx::Row> userRows = conn.fetchAll(conn.execute(userQuery));
+        for(auto& row : userRows){
+            accounts[(int) row.get(0)].balance = (double) row.get(1);
+        }
+        if(accounts.size() != lockOrder.size()){
+            throw std::runtime_error("User not found");
+        }
+
+        if(!symbols.empty()){
+            mysqlx::SqlStatement positionQuery = conn->sql("SELECT UserID, Symbol, Quantity, CostBasis FROM Positions "
+                                                           "WHERE UserID IN (" + placeholderList(lockOrder.size()) + ") "
+                                                           "AND Symbol IN (" + placeholderList(symbols.size()) + ") FOR UPDATE");
+            for(int userID : lockOrder){
+                positionQuery.bind(userID);
+            }
+            for(const std::string& symbol : symbols){
+                positionQuery.bind(symbol);
+            }
+            std::vector<mysqlx::Row> positionRows = conn.fetchAll(conn.execute(positionQuery));
+            for(auto& row : positionRows){
+                Position& position = accounts[(int) row.get(0)].positions[(std::string) row.get(1)];
+                position.quantity = (int) row.get(2);
+                position.costBasis = (double) row.get(3);
+            }
+        }
+
+        std::unordered_map<int, AccountState> locked = accounts;
+        std::vector<TransactionRecord> trades;
+        if(!update(accounts, trades)){
+            conn.rollback();
+            return false;
+        }
+
+        // Write back only what the update changed
+        std::string positionValues;
+        std::vector<std::pair<int, const std::pair<const std::string, Position>*>> changedPositions;
+        for(const auto& account : accounts){
+            const AccountState& before = locked[account.first];
+            if(account.second.balance != before.balance){
+                conn.execute(conn->sql("UPDATE Users SET Balance = ?, Version = Version + 1 WHERE UserID = ?")
+                            .bind(account.second.balance, account.first));
+            }
+            for(const auto& entry : account.second.positions){
+                auto previous = before.positions.find(entry.first);
+                bool unchanged = (previous == before.positions.end())
+                    ? entry.second.quantity == 0 && entry.second.costBasis == 0.0
+                    : previous->second.quantity == entry.second.quantity && previous->second.costBasis == entry.second.costBasis;
+                if(!unchanged){
+                    positionValues += positionValues.empty() ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+                    changedPositions.emplace_back(account.first, &entry);
+                }
+            }
+        }
+
+        if(!trades.empty()){
+            mysqlx::Table transactions = conn.table("Transactions");
+            mysqlx::TableInsert insert = transactions.insert("UserID", "Symbol", "Quantity", "PriceAtTransaction", "Type");
+            for(const TransactionRecord& trade : trades){
+                insert.values(trade.userID, trade.symbol, trade.quantity, trade.price,
+                              trade.side == Side::Buy ? "Buy" : "Sell");
+            }
+            conn.execute(insert);
+        }
+
+        if(!changedPositions.empty()){
+            mysqlx::SqlStatement positionUpsert = conn->sql("INSERT INTO Positions (UserID, Symbol, Quantity, CostBasis) VALUES "
+                                                            + positionValues +
+                                                            " ON DUPLICATE KEY UPDATE Quantity = VALUES(Quantity), CostBasis = VALUES(CostBasis)");
+            for(const auto& changed : changedPositions){
+                positionUpsert.bind(changed.first, changed.second->first,
+                                    changed.second->second.quantity, changed.second->second.costBasis);
+            }
+            conn.execute(positionUpsert);
+        }
+
+        conn.commit();
+    } catch (...){
+        conn.rollback();
+        throw;
+    }
+    return true;
+}
+
+
+std::unordered_map<std::string, Position> MysqlStorage::positions(int userID){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table positionsTable = conn.table("Positions");
+
+    mysqlx::RowResult result = conn.execute(positionsTable.select("Symbol", "Quantity", "CostBasis")
+        .where("UserID = :userID AND Quantity > 0")
+        .bind("userID", userID));
+
+    std::unordered_map<std::string, Position> loaded;
+    std::vector<mysqlx::Row> resultRows = conn.fetchAll(result);
+    for(auto& row : resultRows){
+        Position& position = loaded[(std::string) row.get(0)];
+        position.quantity = (int) row.get(1);
+        position.costBasis = (double) row.get(2);
+    }
+    return loaded;
+}
+
+
+void MysqlStorage::replacePositions(int userID, const std::unordered_map<std::string, Position>& positions){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table positionsTable = conn.table("Positions");
+
+    conn.startTransaction();
+    try{
+        conn.execute(positionsTable.remove()
+            .where("UserID = :userID")
+            .bind("userID", userID));
+
+        if(!positions.empty()){
+            mysqlx::TableInsert insert = positionsTable.insert("UserID", "Symbol", "Quantity", "CostBasis");
+            for(auto& entry : positions){
+                insert.values(userID, entry.first, entry.second.quantity, entry.second.costBasis);
+            }
+            conn.execute(insert);
+        }
+        conn.commit();
+    } catch (...){
+        conn.rollback();
+        throw;
+    }
+}
+
+
+std::vector<TransactionRecord> MysqlStorage::transactionPage(int userID, const TransactionFilter& filter,
+                                                           const TransactionKey& after, size_t limit){
+    SessionPool::Handle conn = pool->acquire();
+
+    // The keyset predicate starts each page where the last one ended on the
+    // (UserID, Date, TransactionID) index, so no page scans the rows before it the way OFFSET would
+    std::string query = "SELECT TransactionID, DATE_FORMAT(Date, '%Y-%m-%d %H:%i:%s'), Type, Quantity, Symbol, "
+                        "PriceAtTransaction FROM Transactions WHERE UserID = ?";
+    if(!filter.symbol.empty()){
+        query += " AND Symbol = ?";
+    }
+    if(!filter.fromDate.empty()){
+        query += " AND Date >= ?";
+    }
+    if(!filter.toDate.empty()){
+        query += " AND Date < ?";
+    }
+    if(!after.date.empty()){
+        query += " AND (Date > ? OR (Date = ? AND TransactionID > ?))";
+    }
+    query += " ORDER BY Date ASC, TransactionID ASC LIMIT ?";
+
+    mysqlx::SqlStatement statement = conn->sql(query);
+    statement.bind(userID);
+    if(!filter.symbol.empty()){
+        statement.bind(filter.symbol);
+    }
+    if(!filter.fromDate.empty()){
+        statement.bind(filter.fromDate);
+    }
+    if(!filter.toDate.empty()){
+        statement.bind(filter.toDate);
+    }
+    if(!after.date.empty()){
+        statement.bind(after.date).bind(after.date).bind(after.transactionID);
+    }
+    statement.bind(static_cast<uint64_t>(limit));
+
+    std::vector<TransactionRecord> page;
+    page.reserve(limit);
+    mysqlx::SqlResult result = conn.execute(statement);
+    for(mysqlx::Row row = conn.fetchOne(result); !row.isNull(); row = conn.fetchOne(result)){
+        TransactionRecord record;
+        record.transactionID = row.get(0).get<int64_t>();
+        record.userID = userID;
+        record.date = (std::string) row.get(1);
+        record.side = ((std::string) row.get(2) == "Sell") ? Side::Sell : Side::Buy;
+        record.quantity = (int) row.get(3);
+        record.symbol = (std::string) row.get(4);
+        record.price = (double) row.get(5);
+        page.push_back(std::move(record));
+    }
+    return page;
+}
+
+
+std::vector<int> MysqlStorage::tradersMissingPositions(){
+    SessionPool::Handle conn = pool->acquire();
+
+    std::vector<int> traders;
+    mysqlx::Row positionCount = conn.fetchOne(conn.execute(conn->sql("SELECT COUNT(*) FROM Positions")));
+    if(positionCount[0].get<int>() != 0){
+        return traders;
+    }
+    std::vector<mysqlx::Row> rows = conn.fetchAll(conn.execute(conn->sql("SELECT DISTINCT UserID FROM Transactions")));
+    for(auto& row : rows){
+        traders.push_back(row[0].get<int>());
+    }
+    return traders;
+}
+
+
+void MysqlStorage::upsertQuotes(const std::vector<const Quote*>& quotes){
+    if(quotes.empty()){
+        return;
+    }
+    SessionPool::Handle conn = pool->acquire();
+
+    std::string rows;
+    for(size_t i = 0; i < quotes.size(); i++){
+        rows += (i == 0) ? "(?, ?, ?)" : ", (?, ?, ?)";
+    }
+    // An empty name never overwrites one already stored
+    mysqlx::SqlStatement upsert = conn->sql("INSERT INTO Stocks (Symbol, CompanyName, StockPrice) VALUES " + rows +
+                                            " ON DUPLICATE KEY UPDATE StockPrice = VALUES(StockPrice), "
+                                            "CompanyName = IF(VALUES(CompanyName) = '', CompanyName, VALUES(CompanyName))");
+    for(const Quote* quote : quotes){
+        upsert.bind(std::string(quote->symbol), std::string(quote->companyName), quote->price);
+    }
+    conn.execute(upsert);
+}
+
+
+std::vector<std::pair<std::string, double>> MysqlStorage::stockPrices(){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table stocks = conn.table("Stocks");
+
+    mysqlx::RowResult result = conn.execute(stocks.select("Symbol", "StockPrice"));
+    std::vector<mysqlx::Row> resultRows = conn.fetchAll(result);
+
+    std::vector<std::pair<std::string, double>> priced;
+    priced.reserve(resultRows.size());
+    for(auto& row : resultRows){
+        if(row.get(1).isNull()){
+            continue;
+        }
+        priced.emplace_back((std::string) row.get(0), (double) row.get(1));
+    }
+    return priced;
+}
+
+
+bool MysqlStorage::stockPrice(const std::string& symbol, double& price){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table stocks = conn.table("Stocks");
+
+    mysqlx::Row stockRow = conn.fetchOne(conn.execute(stocks.select("StockPrice")
+                                        .where("Symbol = :stockSymbol")
+                                        .bind("stockSymbol", symbol)));
+
+    if(stockRow.isNull() || stockRow.get(0).isNull()){
+        return false;
+    }
+    price = (double) stockRow.get(0);
+    return true;
+}
+
+
+std::vector<std::string> MysqlStorage::stockSymbols(){
+    std::vector<std::string> names;
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Table stocks = conn.table("Stocks");
+
+    mysqlx::RowResult stockNames = conn.execute(stocks.select("Symbol"));
+
+    std::vector <mysqlx::Row> resultRows = conn.fetchAll(stockNames);
+
+    for (auto& row : resultRows){
+        names.emplace_back((std::string) row.get(0));
+    }
+
+    return names;
+}
+
+
+std::string MysqlStorage::storeID(){
+    return identity;
+}
+
+
+uint64_t MysqlStorage::journalCheckpoint(){
+    SessionPool::Handle conn = pool->acquire();
+    mysqlx::Row checkpoint = conn.fetchOne(conn.execute(conn->sql("SELECT AppliedSequence FROM JournalCheckpoint WHERE ID = 1")));
+    return checkpoint.isNull() ? 0 : checkpoint[0].get<uint64_t>();
+}
+
+
+void MysqlStorage::applyJournal(const std::vector<JournalRecord>& records){
+    if(records.empty()){
+        return;
+    }
+
+    // Net everything per user and per position so a batch costs a handful of statements
+    std::map<int, double> balanceDeltas;
+    std::map<std::pair<int, std::string>, Position> positionDeltas;
+    std::vector<const JournalRecord*> trades;
+    for(const JournalRecord& record : records){
+        switch(record.type){
+            case JournalEntry::Buy:
+                balanceDeltas[record.userID] -= record.price * record.quantity;
+                addToPosition(positionDeltas[{record.userID, record.symbol}], record.quantity, record.price);
+                trades.push_back(&record);
+                break;
+            case JournalEntry::Sell: {
+                balanceDeltas[record.userID] += record.price * record.quantity;
+                Position& delta = positionDeltas[{record.userID, record.symbol}];
+                delta.quantity -= record.quantity;
+                delta.costBasis -= record.costRelieved;
+                trades.push_back(&record);
+                break;
+            }
+            case JournalEntry::Deposit:
+                balanceDeltas[record.userID] += record.price;
+                break;
+            case JournalEntry::Withdraw:
+                balanceDeltas[record.userID] -= record.price;
+                break;
+        }
+    }
+
+    SessionPool::Handle conn = pool->acquire();
+    conn.startTransaction();
+    try{
+        for(const auto& delta : balanceDeltas){
+            conn.execute(conn->sql("UPDATE Users SET Balance = Balance + ?, Version = Version + 1 WHERE UserID = ?")
+                        .bind(delta.second, delta.first));
+        }
+
+        if(!trades.empty()){
+            mysqlx::Table transactions = conn.table("Transactions");
+            mysqlx::TableInsert insert = transactions.insert("UserID", "Symbol", "Quantity", "PriceAtTransaction", "Type");
+            for(const JournalRecord* trade : trades){
+                insert.values(trade->userID, trade->symbol, trade->quantity, trade->price,
+                              trade->type == JournalEntry::Buy ? "Buy" : "Sell");
+            }
+            conn.execute(insert);
+
+            std::string positionValues;
+            for(size_t i = 0; i < positionDeltas.size(); i++){
+                positionValues += (i == 0) ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+            }
+            mysqlx::SqlStatement positionUpsert = conn->sql("INSERT INTO Positions (UserID, Symbol, Quantity, CostBasis) VALUES "
+                                                            + positionValues +
+                                                            " ON DUPLICATE KEY UPDATE Quantity = Quantity + VALUES(Quantity), "
+                                                            "CostBasis = CostBasis + VALUES(CostBasis)");
+            for(const auto& delta : positionDeltas){
+                positionUpsert.bind(delta.first.first, delta.first.second, delta.second.quantity, delta.second.costBasis);
+            }
+            conn.execute(positionUpsert);
+        }
+
+        conn.execute(conn->sql("INSERT INTO JournalCheckpoint (ID, AppliedSequence) VALUES (1, ?) "
+                               "ON DUPLICATE KEY UPDATE AppliedSequence = VALUES(AppliedSequence)")
+                    .bind(records.back().sequence));
+
+        conn.commit();
+    } catch (...){
+        conn.rollback();
+        throw;
+    }
+}
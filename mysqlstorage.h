@@ -0,0 +1,74 @@
+#include <xdevapi.h>
+#include "storage.h"
+#include "sessionpool.h"
+#include <memory>
+#include <string>
+
+
+#ifndef MYSQLSTORAGE_H
+#define MYSQLSTORAGE_H
+
+
+// The `trading` schema behind a MySQL X Protocol URL. Every operation checks out a pooled
+// session; the setup session only runs DDL. Trades go through the TradeBuy / TradeSell
+// stored procedures so a checked trade costs one round trip; they and adjustBalance only
+// write at the Users.Version the caller passes.
+class MysqlStorage : public Storage {
+
+    private:
+        std::unique_ptr<mysqlx::Session> session;
+        std::unique_ptr<SessionPool> pool;
+        std::string identity;
+
+        void createTradeProcedures();
+
+    public:
+
+    // poolSize 0 sizes the session pool to the number of hardware threads
+    MysqlStorage(const std::string& url, size_t poolSize);
+
+    ~MysqlStorage() override;
+
+    std::unique_ptr<StorageCall> beginCall() override;
+
+    size_t roundTrips() const override;
+
+    int createUser(const std::string& username, const std::string& password) override;
+
+    int findUser(const std::string& username, const std::string& password, AccountVersion& account) override;
+
+    bool account(int userID, AccountVersion& account) override;
+
+    int adjustBalance(int userID, double delta, AccountVersion& account) override;
+
+    int trade(int userID, const std::string& symbol, Side side, int quantity, double price,
+              AccountVersion& account) override;
+
+    bool transact(const std::vector<int>& userIDs, const std::vector<std::string>& symbols,
+                  const AccountUpdate& update) override;
+
+    std::unordered_map<std::string, Position> positions(int userID) override;
+
+    void replacePositions(int userID, const std::unordered_map<std::string, Position>& positions) override;
+
+    std::vector<TransactionRecord> transactionPage(int userID, const TransactionFilter& filter,
+                                                   const TransactionKey& after, size_t limit) override;
+
+    std::vector<int> tradersMissingPositions() override;
+
+    void upsertQuotes(const std::vector<const Quote*>& quotes) override;
+
+    std::vector<std::pair<std::string, double>> stockPrices() override;
+
+    bool stockPrice(const std::string& symbol, double& price) override;
+
+    std::vector<std::string> stockSymbols() override;
+
+    std::string storeID() override;
+
+    uint64_t journalCheckpoint() override;
+
+    void applyJournal(const std::vector<JournalRecord>& records) override;
+};
+
+#endif // MYSQLSTORAGE_H
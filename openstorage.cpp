@@ -0,0 +1,13 @@
+#include "storage.h"
+#include "embeddedstorage.h"
+#include "mysqlstorage.h"
+
+
+// Kept apart from storage.cpp so code that only needs the embedded store links without MySQL
+std::unique_ptr<Storage> openStorage(const std::string& url, size_t poolSize){
+    const std::string embedded = "embedded://";
+    if(url.compare(0, embedded.size(), embedded) == 0){
+        return std::make_unique<EmbeddedStorage>(url.substr(embedded.size()));
+    }
+    return std::make_unique<MysqlStorage>(url, poolSize);
+}
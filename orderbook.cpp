@@ -0,0 +1,395 @@
+#include "orderbook.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+OrderBook::OrderBook(){
+    pool.reserve(1024);
+    bids.reserve(64);
+    asks.reserve(64);
+}
+
+
+uint32_t OrderBook::allocateNode(){
+    if(!freeList.empty()){
+        uint32_t node = freeList.back();
+        freeList.pop_back();
+        return node;
+    }
+    pool.emplace_back();
+    return static_cast<uint32_t>(pool.size() - 1);
+}
+
+void OrderBook::releaseNode(uint32_t node){
+    index.erase(pool[node].orderID);
+    freeList.push_back(node);
+}
+
+
+std::vector<OrderBook::PriceLevel>::iterator OrderBook::findLevel(Side side, int64_t priceTicks){
+    // Bids ascend and asks descend, so in both vectors the best price sits at the back
+    if(side == Side::Buy){
+        return std::lower_bound(bids.begin(), bids.end(), priceTicks,
+            [](const PriceLevel& level, int64_t price){ return level.priceTicks < price; });
+    }
+    return std::lower_bound(asks.begin(), asks.end(), priceTicks,
+        [](const PriceLevel& level, int64_t price){ return level.priceTicks > price; });
+}
+
+
+void OrderBook::restOrder(uint32_t node){
+    OrderNode& order = pool[node];
+    std::vector<PriceLevel>& levels = (order.side == Side::Buy) ? bids : asks;
+
+    auto level = findLevel(order.side, order.priceTicks);
+    if(level == levels.end() || level->priceTicks != order.priceTicks){
+        level = levels.insert(level, PriceLevel{order.priceTicks, 0, NIL, NIL});
+    }
+
+    order.prev = level->tail;
+    order.next = NIL;
+    if(level->tail != NIL){
+        pool[level->tail].next = node;
+    } else {
+        level->head = node;
+    }
+    level->tail = node;
+    level->totalQuantity += order.remaining;
+    index[order.orderID] = node;
+}
+
+
+void OrderBook::unlinkFromLevel(PriceLevel& level, uint32_t node){
+    OrderNode& order = pool[node];
+    if(order.prev != NIL){
+        pool[order.prev].next = order.next;
+    } else {
+        level.head = order.next;
+    }
+    if(order.next != NIL){
+        pool[order.next].prev = order.prev;
+    } else {
+        level.tail = order.prev;
+    }
+    level.totalQuantity -= order.remaining;
+}
+
+
+int OrderBook::addOrder(uint64_t orderID, int userID, Side side, int64_t priceTicks, int quantity, std::vector<Fill>& fills){
+    if(quantity <= 0){
+        throw std::runtime_error("Order quantity must be positive.");
+    }
+    if(index.count(orderID)){
+        throw std::runtime_error("Duplicate order ID.");
+    }
+
+    std::vector<PriceLevel>& opposite = (side == Side::Buy) ? asks : bids;
+    int remaining = quantity;
+
+    while(remaining > 0 && !opposite.empty()){
+        PriceLevel& level = opposite.back();
+        bool crosses = (side == Side::Buy) ? level.priceTicks <= priceTicks
+                                           : level.priceTicks >= priceTicks;
+        if(!crosses){
+            break;
+        }
+
+        while(remaining > 0 && level.head != NIL){
+            uint32_t makerNode = level.head;
+            OrderNode& maker = pool[makerNode];
+            int traded = std::min(remaining, maker.remaining);
+
+            fills.push_back(Fill{orderID, maker.orderID, userID, maker.userID, side, level.priceTicks, traded,
+                                 maker.priceTicks});
+
+            remaining -= traded;
+            maker.remaining -= traded;
+            level.totalQuantity -= traded;
+
+            if(maker.remaining == 0){
+                level.head = maker.next;
+                if(level.head != NIL){
+                    pool[level.head].prev = NIL;
+                } else {
+                    level.tail = NIL;
+                }
+                releaseNode(makerNode);
+            }
+        }
+
+        if(level.head == NIL){
+            opposite.pop_back();
+        }
+    }
+
+    if(remaining > 0){
+        uint32_t node = allocateNode();
+        pool[node] = OrderNode{orderID, userID, side, priceTicks, remaining, NIL, NIL};
+        restOrder(node);
+    }
+    return remaining;
+}
+
+
+bool OrderBook::cancelOrder(uint64_t orderID){
+    auto found = index.find(orderID);
+    if(found == index.end()){
+        return false;
+    }
+    uint32_t node = found->second;
+    OrderNode& order = pool[node];
+    std::vector<PriceLevel>& levels = (order.side == Side::Buy) ? bids : asks;
+
+    auto level = findLevel(order.side, order.priceTicks);
+    if(level == levels.end() || level->priceTicks != order.priceTicks){
+        throw std::runtime_error("Order book corrupted: resting order has no price level.");
+    }
+
+    unlinkFromLevel(*level, node);
+    if(level->head == NIL){
+        levels.erase(level);
+    }
+    releaseNode(node);
+    return true;
+}
+
+
+int OrderBook::extendOrder(uint64_t orderID, int userID, Side side, int64_t priceTicks, int quantity, std::vector<Fill>& fills){
+    auto found = index.find(orderID);
+    if(found == index.end()){
+        return addOrder(orderID, userID, side, priceTicks, quantity, fills);
+    }
+
+    OrderNode& order = pool[found->second];
+    std::vector<PriceLevel>& levels = (order.side == Side::Buy) ? bids : asks;
+    auto level = findLevel(order.side, order.priceTicks);
+    if(level == levels.end() || level->priceTicks != order.priceTicks){
+        throw std::runtime_error("Order book corrupted: resting order has no price level.");
+    }
+    order.remaining += quantity;
+    level->totalQuantity += quantity;
+    return order.remaining;
+}
+
+
+void OrderBook::restoreMaker(const Fill& fill){
+    Side makerSide = (fill.takerSide == Side::Buy) ? Side::Sell : Side::Buy;
+    std::vector<PriceLevel>& levels = (makerSide == Side::Buy) ? bids : asks;
+
+    auto level = findLevel(makerSide, fill.makerPriceTicks);
+    if(level == levels.end() || level->priceTicks != fill.makerPriceTicks){
+        level = levels.insert(level, PriceLevel{fill.makerPriceTicks, 0, NIL, NIL});
+    }
+
+    // Partly filled makers are still at the head of their level
+    auto found = index.find(fill.makerOrderID);
+    if(found != index.end()){
+        pool[found->second].remaining += fill.quantity;
+        level->totalQuantity += fill.quantity;
+        return;
+    }
+
+    uint32_t node = allocateNode();
+    pool[node] = OrderNode{fill.makerOrderID, fill.makerUserID, makerSide, fill.makerPriceTicks, fill.quantity,
+                           NIL, level->head};
+    if(level->head != NIL){
+        pool[level->head].prev = node;
+    } else {
+        level->tail = node;
+    }
+    level->head = node;
+    level->totalQuantity += fill.quantity;
+    index[fill.makerOrderID] = node;
+}
+
+
+size_t OrderBook::executeAgainstMarket(int64_t marketTicks, std::vector<Fill>& fills){
+    size_t firstFill = fills.size();
+
+    for(Side side : {Side::Buy, Side::Sell}){
+        std::vector<PriceLevel>& levels = (side == Side::Buy) ? bids : asks;
+        Side marketSide = (side == Side::Buy) ? Side::Sell : Side::Buy;
+
+        while(!levels.empty()){
+            PriceLevel& level = levels.back();
+            bool crossed = (side == Side::Buy) ? level.priceTicks >= marketTicks
+                                               : level.priceTicks <= marketTicks;
+            if(!crossed){
+                break;
+            }
+
+            uint32_t node = level.head;
+            while(node != NIL){
+                OrderNode& maker = pool[node];
+                uint32_t next = maker.next;
+                fills.push_back(Fill{MARKET_ORDER_ID, maker.orderID, MARKET_USER_ID, maker.userID,
+                                     marketSide, marketTicks, maker.remaining, maker.priceTicks});
+                releaseNode(node);
+                node = next;
+            }
+            levels.pop_back();
+        }
+    }
+
+    return fills.size() - firstFill;
+}
+
+
+int OrderBook::orderOwner(uint64_t orderID) const{
+    auto found = index.find(orderID);
+    if(found == index.end()){
+        return -1;
+    }
+    return pool[found->second].userID;
+}
+
+bool OrderBook::bestBid(int64_t& priceTicks) const{
+    if(bids.empty()){
+        return false;
+    }
+    priceTicks = bids.back().priceTicks;
+    return true;
+}
+
+bool OrderBook::bestAsk(int64_t& priceTicks) const{
+    if(asks.empty()){
+        return false;
+    }
+    priceTicks = asks.back().priceTicks;
+    return true;
+}
+
+size_t OrderBook::restingOrders() const{
+    return index.size();
+}
+
+
+
+MatchingEngine::SymbolBook& MatchingEngine::bookFor(const std::string& symbol){
+    auto& slot = books[symbol];
+    if(!slot){
+        slot = std::make_unique<SymbolBook>();
+    }
+    return *slot;
+}
+
+
+uint64_t MatchingEngine::submitLimit(const std::string& symbol, int userID, Side side, double limitPrice, int quantity, std::vector<Fill>& fills){
+    if(limitPrice <= 0){
+        throw std::runtime_error("Limit price must be positive.");
+    }
+
+    SymbolBook* symbolBook;
+    uint64_t orderID;
+    {
+        std::lock_guard<std::mutex> lock(booksMutex);
+        symbolBook = &bookFor(symbol);
+        orderID = nextOrderID++;
+    }
+
+    size_t firstFill = fills.size();
+    int resting;
+    {
+        std::lock_guard<std::mutex> lock(symbolBook->mutex);
+        resting = symbolBook->book.addOrder(orderID, userID, side, toTicks(limitPrice), quantity, fills);
+    }
+
+    std::lock_guard<std::mutex> lock(booksMutex);
+    route(*symbolBook, orderID, resting, fills, firstFill);
+    return orderID;
+}
+
+
+void MatchingEngine::extend(const std::string& symbol, uint64_t orderID, int userID, Side side, double limitPrice,
+                            int quantity, std::vector<Fill>& fills){
+    SymbolBook* symbolBook;
+    {
+        std::lock_guard<std::mutex> lock(booksMutex);
+        symbolBook = &bookFor(symbol);
+    }
+
+    size_t firstFill = fills.size();
+    int resting;
+    {
+        std::lock_guard<std::mutex> lock(symbolBook->mutex);
+        resting = symbolBook->book.extendOrder(orderID, userID, side, toTicks(limitPrice), quantity, fills);
+    }
+
+    std::lock_guard<std::mutex> lock(booksMutex);
+    route(*symbolBook, orderID, resting, fills, firstFill);
+}
+
+
+void MatchingEngine::route(SymbolBook& symbolBook, uint64_t orderID, int resting, const std::vector<Fill>& fills, size_t firstFill){
+    // Keep the orderID -> book routing table limited to orders that are still live
+    for(size_t i = firstFill; i < fills.size(); i++){
+        uint64_t makerID = fills[i].makerOrderID;
+        std::lock_guard<std::mutex> bookLock(symbolBook.mutex);
+        if(symbolBook.book.orderOwner(makerID) < 0){
+            orderBooks.erase(makerID);
+        }
+    }
+    if(resting > 0){
+        orderBooks[orderID] = &symbolBook;
+    }
+}
+
+
+bool MatchingEngine::cancel(int userID, uint64_t orderID){
+    std::lock_guard<std::mutex> lock(booksMutex);
+    auto found = orderBooks.find(orderID);
+    if(found == orderBooks.end()){
+        return false;
+    }
+
+    SymbolBook* symbolBook = found->second;
+    std::lock_guard<std::mutex> bookLock(symbolBook->mutex);
+    int owner = symbolBook->book.orderOwner(orderID);
+    if(owner < 0){
+        orderBooks.erase(found);
+        return false;
+    }
+    if(owner != userID){
+        return false;
+    }
+    symbolBook->book.cancelOrder(orderID);
+    orderBooks.erase(found);
+    return true;
+}
+
+
+size_t MatchingEngine::onMarketPrice(const std::string& symbol, double marketPrice, std::vector<Fill>& fills){
+    SymbolBook* symbolBook;
+    {
+        std::lock_guard<std::mutex> lock(booksMutex);
+        auto found = books.find(symbol);
+        if(found == books.end()){
+            return 0;
+        }
+        symbolBook = found->second.get();
+    }
+
+    size_t firstFill = fills.size();
+    {
+        std::lock_guard<std::mutex> lock(symbolBook->mutex);
+        symbolBook->book.executeAgainstMarket(toTicks(marketPrice), fills);
+    }
+
+    // Market fills always complete the maker, so every one of them leaves the routing table
+    std::lock_guard<std::mutex> lock(booksMutex);
+    for(size_t i = firstFill; i < fills.size(); i++){
+        orderBooks.erase(fills[i].makerOrderID);
+    }
+    return fills.size() - firstFill;
+}
+
+
+void MatchingEngine::restore(const std::string& symbol, const Fill& fill){
+    std::lock_guard<std::mutex> lock(booksMutex);
+    SymbolBook& symbolBook = bookFor(symbol);
+    {
+        std::lock_guard<std::mutex> bookLock(symbolBook.mutex);
+        symbolBook.book.restoreMaker(fill);
+    }
+    orderBooks[fill.makerOrderID] = &symbolBook;
+}
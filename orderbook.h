@@ -0,0 +1,157 @@
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+enum class Side { Buy, Sell };
+
+// Prices inside the book are integer ticks (cents) so level lookups are exact
+constexpr double TICK_SIZE = 0.01;
+
+inline int64_t toTicks(double price){
+    return std::llround(price / TICK_SIZE);
+}
+
+inline double fromTicks(int64_t ticks){
+    return ticks * TICK_SIZE;
+}
+
+
+// Taker IDs on fills produced by a market price crossing a resting order rather than another order
+constexpr uint64_t MARKET_ORDER_ID = 0;
+constexpr int MARKET_USER_ID = 0;
+
+
+struct Fill {
+    uint64_t takerOrderID;
+    uint64_t makerOrderID;
+    int takerUserID;
+    int makerUserID;
+    Side takerSide;
+    int64_t priceTicks;   // the resting (maker) price, or the market price for market fills
+    int quantity;
+    int64_t makerPriceTicks;   // the maker's limit, which restoring the order needs
+};
+
+
+// Price-time priority book for a single symbol.
+// Orders live in a pooled vector and are chained into their price level with
+// intrusive prev/next indices, so add/cancel never allocate once the pool is warm.
+// Levels are kept in sorted vectors with the best price at the back.
+class OrderBook {
+
+    private:
+        static constexpr uint32_t NIL = UINT32_MAX;
+
+        struct OrderNode {
+            uint64_t orderID;
+            int userID;
+            Side side;
+            int64_t priceTicks;
+            int remaining;
+            uint32_t prev;
+            uint32_t next;
+        };
+
+        struct PriceLevel {
+            int64_t priceTicks;
+            int64_t totalQuantity;
+            uint32_t head;
+            uint32_t tail;
+        };
+
+        std::vector<OrderNode> pool;
+        std::vector<uint32_t> freeList;
+        std::vector<PriceLevel> bids;   // ascending, best bid at back
+        std::vector<PriceLevel> asks;   // descending, best ask at back
+        std::unordered_map<uint64_t, uint32_t> index;
+
+        uint32_t allocateNode();
+        void releaseNode(uint32_t node);
+        std::vector<PriceLevel>::iterator findLevel(Side side, int64_t priceTicks);
+        void restOrder(uint32_t node);
+        void unlinkFromLevel(PriceLevel& level, uint32_t node);
+
+    public:
+
+    OrderBook();
+
+    // Matches as much as possible against the opposite side, then rests any remainder.
+    // Fills are appended to `fills`; returns the quantity left resting on the book.
+    int addOrder(uint64_t orderID, int userID, Side side, int64_t priceTicks, int quantity, std::vector<Fill>& fills);
+
+    bool cancelOrder(uint64_t orderID);
+
+    // Gives an order `quantity` more shares. An order still resting crosses nothing, so they are
+    // added to its remainder in place; otherwise they are matched and rested as addOrder does.
+    // Returns the quantity left resting on the book.
+    int extendOrder(uint64_t orderID, int userID, Side side, int64_t priceTicks, int quantity, std::vector<Fill>& fills);
+
+    // Gives a fill's quantity back to its maker at the front of the maker's level, where it was
+    // when it matched: added to the order if it is still resting, otherwise re-inserted.
+    // Restore failed fills newest first so makers from one level keep their relative order.
+    void restoreMaker(const Fill& fill);
+
+    // Fills every resting order the market price has crossed (bids at or above it, asks at or
+    // below it) in full at that price, best level first and in time order within a level.
+    // The market is the taker. Returns the number of fills appended.
+    size_t executeAgainstMarket(int64_t marketTicks, std::vector<Fill>& fills);
+
+    // Returns the owner of a resting order or -1 if it is not on the book
+    int orderOwner(uint64_t orderID) const;
+
+    bool bestBid(int64_t& priceTicks) const;
+
+    bool bestAsk(int64_t& priceTicks) const;
+
+    size_t restingOrders() const;
+};
+
+
+// Owns one OrderBook per symbol and hands out engine-wide order IDs.
+class MatchingEngine {
+
+    private:
+        struct SymbolBook {
+            std::mutex mutex;
+            OrderBook book;
+        };
+
+        std::mutex booksMutex;
+        std::unordered_map<std::string, std::unique_ptr<SymbolBook>> books;
+        std::unordered_map<uint64_t, SymbolBook*> orderBooks;
+        uint64_t nextOrderID = 1;
+
+        SymbolBook& bookFor(const std::string& symbol);
+
+        // Caller holds booksMutex. Drops makers the new fills completed from the routing table
+        // and routes the taker's order if any of it rests.
+        void route(SymbolBook& symbolBook, uint64_t orderID, int resting, const std::vector<Fill>& fills, size_t firstFill);
+
+    public:
+
+    uint64_t submitLimit(const std::string& symbol, int userID, Side side, double limitPrice, int quantity, std::vector<Fill>& fills);
+
+    // Gives a submitted order more shares to match, under the same ID; for a taker whose fill
+    // against a maker was undone. See OrderBook::extendOrder
+    void extend(const std::string& symbol, uint64_t orderID, int userID, Side side, double limitPrice, int quantity,
+                std::vector<Fill>& fills);
+
+    // Returns false if the order is unknown, already done, or not owned by userID
+    bool cancel(int userID, uint64_t orderID);
+
+    // Triggers resting orders in `symbol` that `marketPrice` crosses; see OrderBook::executeAgainstMarket
+    size_t onMarketPrice(const std::string& symbol, double marketPrice, std::vector<Fill>& fills);
+
+    // Puts back a fill that could not be settled; see OrderBook::restoreMaker
+    void restore(const std::string& symbol, const Fill& fill);
+};
+
+#endif // ORDERBOOK_H
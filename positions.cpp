@@ -0,0 +1,170 @@
+#include "positions.h"
+#include <stdexcept>
+
+
+void addToPosition(Position& position, int quantity, double price){
+    position.quantity += quantity;
+    position.costBasis += price * quantity;
+}
+
+double relievePosition(Position& position, int quantity){
+    double relieved = position.costBasis * quantity / position.quantity;
+    position.quantity -= quantity;
+    position.costBasis -= relieved;
+    return relieved;
+}
+
+
+bool PositionBook::isLoaded(int userID) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return users.count(userID) > 0;
+}
+
+uint64_t PositionBook::generation(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    return activity[userID].generation;
+}
+
+bool PositionBook::load(int userID, std::unordered_map<std::string, Position> positions, uint64_t generation){
+    std::lock_guard<std::mutex> lock(mutex);
+    // A fill still in flight may or may not be in what was read, and one that finished
+    // meanwhile was ignored, so either way the positions can't be trusted
+    const Activity& fills = activity[userID];
+    if(fills.pending > 0 || fills.generation != generation){
+        return false;
+    }
+    users[userID] = std::move(positions);
+    return true;
+}
+
+void PositionBook::unload(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    users.erase(userID);
+}
+
+
+void PositionBook::beginFill(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    Activity& fills = activity[userID];
+    fills.pending++;
+    fills.generation = ++nextGeneration;
+}
+
+void PositionBook::endFill(int userID){
+    std::lock_guard<std::mutex> lock(mutex);
+    Activity& fills = activity[userID];
+    fills.pending--;
+    fills.generation = ++nextGeneration;
+}
+
+
+PositionBook::PendingFill::PendingFill(PositionBook& book, std::initializer_list<int> userIDs)
+    : book(book), userIDs(userIDs)
+{
+    for(int userID : this->userIDs){
+        book.beginFill(userID);
+    }
+}
+
+PositionBook::PendingFill::~PendingFill(){
+    for(int userID : userIDs){
+        book.endFill(userID);
+    }
+}
+
+
+int PositionBook::quantity(int userID, const std::string& symbol) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return 0;
+    }
+    auto position = user->second.find(symbol);
+    return position == user->second.end() ? 0 : position->second.quantity;
+}
+
+
+Position PositionBook::position(int userID, const std::string& symbol) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return Position();
+    }
+    auto position = user->second.find(symbol);
+    return position == user->second.end() ? Position() : position->second;
+}
+
+
+void PositionBook::applyBuy(int userID, const std::string& symbol, int quantity, double price){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return;
+    }
+    addToPosition(user->second[symbol], quantity, price);
+}
+
+
+double PositionBook::applySell(int userID, const std::string& symbol, int quantity){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return 0.0;
+    }
+    auto& positions = user->second;
+    auto found = positions.find(symbol);
+    if(found == positions.end() || found->second.quantity < quantity){
+        throw std::runtime_error("Insufficient stock to sell.");
+    }
+
+    double relieved = relievePosition(found->second, quantity);
+    if(found->second.quantity == 0){
+        positions.erase(found);
+    }
+    return relieved;
+}
+
+
+void PositionBook::set(int userID, const std::string& symbol, const Position& position){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return;
+    }
+    auto& positions = user->second;
+    if(position.quantity == 0){
+        positions.erase(symbol);
+    } else {
+        positions[symbol] = position;
+    }
+}
+
+
+std::vector<std::pair<std::string, Position>> PositionBook::holdings(int userID) const{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<std::string, Position>> result;
+    auto user = users.find(userID);
+    if(user == users.end()){
+        return result;
+    }
+    result.reserve(user->second.size());
+    for(const auto& entry : user->second){
+        result.emplace_back(entry.first, entry.second);
+    }
+    return result;
+}
+
+
+std::vector<std::string> PositionBook::symbols() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<std::string, bool> seen;
+    std::vector<std::string> result;
+    for(const auto& user : users){
+        for(const auto& entry : user.second){
+            if(seen.emplace(entry.first, true).second){
+                result.push_back(entry.first);
+            }
+        }
+    }
+    return result;
+}
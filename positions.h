@@ -0,0 +1,101 @@
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct Position {
+    int quantity = 0;
+    double costBasis = 0.0;   // total cost of the shares still held (average cost)
+};
+
+
+// Average-cost rules shared by PositionBook and the backtester's in-memory accounts
+void addToPosition(Position& position, int quantity, double price);
+
+// Relieves cost basis at the average cost; returns the cost basis removed.
+// The caller has already checked that the position holds at least `quantity`.
+double relievePosition(Position& position, int quantity);
+
+
+// In-memory mirror of the Positions table, loaded per user on first access.
+// Database keeps it in step with every Transactions insert so sell checks and
+// portfolio reads never have to re-aggregate the transaction history.
+// Fills for users that are not loaded are ignored; the next load reads them from storage.
+class PositionBook {
+
+    private:
+        // Fills a load may have missed: one in flight, or one that began or ended after the
+        // load read `generation`
+        struct Activity {
+            uint64_t generation = 0;
+            int pending = 0;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<int, std::unordered_map<std::string, Position>> users;
+        std::unordered_map<int, Activity> activity;
+        uint64_t nextGeneration = 0;
+
+        void beginFill(int userID);
+
+        void endFill(int userID);
+
+    public:
+
+        // Marks users as having a fill on its way to storage for as long as it lives, as
+        // LotBook::PendingFill does, so a load racing the fill is refused instead of installed
+        // without it
+        class PendingFill {
+
+            private:
+                PositionBook& book;
+                std::vector<int> userIDs;
+
+            public:
+
+            PendingFill(PositionBook& book, std::initializer_list<int> userIDs);
+
+            ~PendingFill();
+
+            PendingFill(const PendingFill&) = delete;
+            PendingFill& operator=(const PendingFill&) = delete;
+        };
+
+    bool isLoaded(int userID) const;
+
+    // Read before the positions a load installs are read from storage
+    uint64_t generation(int userID);
+
+    // Installs positions read after `generation`. False, leaving the user as they were, if a
+    // PendingFill for the user was live at any point since; the caller reads again then.
+    bool load(int userID, std::unordered_map<std::string, Position> positions, uint64_t generation);
+
+    void unload(int userID);
+
+    int quantity(int userID, const std::string& symbol) const;
+
+    // Empty position if the user or symbol is not held
+    Position position(int userID, const std::string& symbol) const;
+
+    void applyBuy(int userID, const std::string& symbol, int quantity, double price);
+
+    // Relieves cost basis at the average cost; returns the cost basis removed
+    double applySell(int userID, const std::string& symbol, int quantity);
+
+    // Overwrites one symbol with a value read under lock; quantity 0 removes it
+    void set(int userID, const std::string& symbol, const Position& position);
+
+    std::vector<std::pair<std::string, Position>> holdings(int userID) const;
+
+    // Every symbol with a non-zero position among the users currently loaded
+    std::vector<std::string> symbols() const;
+};
+
+#endif // POSITIONS_H
@@ -0,0 +1,97 @@
+#include "pricetable.h"
+#include <chrono>
+#include <stdexcept>
+
+
+PriceTable::PriceTable()
+    : slots(new Slot[CAPACITY])
+{
+    names.reserve(CAPACITY);
+}
+
+
+uint32_t PriceTable::symbolID(const std::string& symbol) const{
+    std::shared_lock<std::shared_mutex> lock(symbolMutex);
+    auto found = ids.find(symbol);
+    return found == ids.end() ? NO_SYMBOL : found->second;
+}
+
+const std::string& PriceTable::symbolName(uint32_t id) const{
+    std::shared_lock<std::shared_mutex> lock(symbolMutex);
+    return names.at(id);
+}
+
+size_t PriceTable::symbolCount() const{
+    std::shared_lock<std::shared_mutex> lock(symbolMutex);
+    return names.size();
+}
+
+
+void PriceTable::writeSlot(uint32_t id, double price, uint64_t version, int64_t now){
+    Slot& slot = slots[id];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.price.store(price, std::memory_order_relaxed);
+    slot.version.store(version, std::memory_order_relaxed);
+    slot.updatedAtNanos.store(now, std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+uint64_t PriceTable::apply(const std::vector<std::pair<std::string, double>>& updates){
+    std::lock_guard<std::mutex> lock(writeMutex);
+    uint64_t version = tableVersion.load(std::memory_order_relaxed) + 1;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for(const auto& update : updates){
+        uint32_t id = symbolID(update.first);
+        if(id == NO_SYMBOL){
+            std::unique_lock<std::shared_mutex> symbolLock(symbolMutex);
+            if(names.size() >= CAPACITY){
+                throw std::runtime_error("Price table is full.");
+            }
+            id = static_cast<uint32_t>(names.size());
+            names.push_back(update.first);
+            ids.emplace(update.first, id);
+        }
+        writeSlot(id, update.second, version, now);
+    }
+
+    tableVersion.store(version, std::memory_order_release);
+    return version;
+}
+
+
+bool PriceTable::read(uint32_t id, PriceQuote& quote) const{
+    if(id >= CAPACITY){
+        return false;
+    }
+    const Slot& slot = slots[id];
+    uint64_t before;
+    uint64_t after;
+    do{
+        before = slot.sequence.load(std::memory_order_acquire);
+        quote.price = slot.price.load(std::memory_order_relaxed);
+        quote.version = slot.version.load(std::memory_order_relaxed);
+        quote.updatedAtNanos = slot.updatedAtNanos.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = slot.sequence.load(std::memory_order_relaxed);
+    } while(before != after || (before & 1));
+
+    return quote.version != 0;
+}
+
+bool PriceTable::read(const std::string& symbol, PriceQuote& quote) const{
+    uint32_t id = symbolID(symbol);
+    return id != NO_SYMBOL && read(id, quote);
+}
+
+
+uint64_t PriceTable::version() const{
+    return tableVersion.load(std::memory_order_acquire);
+}
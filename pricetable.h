@@ -0,0 +1,73 @@
+#ifndef PRICETABLE_H
+#define PRICETABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct PriceQuote {
+    double price = 0.0;
+    uint64_t version = 0;       // table version of the refresh that last set this price
+    int64_t updatedAtNanos = 0; // steady_clock time of that refresh
+};
+
+
+// In-process copy of Stocks.StockPrice.
+// Symbols are interned to dense IDs that index a flat array of cache-line sized slots.
+// Each slot is a seqlock: readers retry instead of locking, so pricing a trade or a
+// whole portfolio never blocks on, or is blocked by, a concurrent refresh.
+class PriceTable {
+
+    public:
+        static constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+        static constexpr size_t CAPACITY = 8192;
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> sequence{0};   // odd while a write is in progress
+            std::atomic<double> price{0.0};
+            std::atomic<uint64_t> version{0};
+            std::atomic<int64_t> updatedAtNanos{0};
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<uint64_t> tableVersion{0};
+
+        mutable std::shared_mutex symbolMutex;
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> names;
+
+        std::mutex writeMutex;   // one refresh at a time; readers never take it
+
+        void writeSlot(uint32_t id, double price, uint64_t version, int64_t now);
+
+    public:
+
+    PriceTable();
+
+    // Returns NO_SYMBOL for symbols that have never been priced
+    uint32_t symbolID(const std::string& symbol) const;
+
+    const std::string& symbolName(uint32_t id) const;
+
+    size_t symbolCount() const;
+
+    // Publishes a batch of prices under one new table version; returns that version
+    uint64_t apply(const std::vector<std::pair<std::string, double>>& updates);
+
+    bool read(uint32_t id, PriceQuote& quote) const;
+
+    bool read(const std::string& symbol, PriceQuote& quote) const;
+
+    // Bumped once per apply(); compare with PriceQuote::version to judge freshness
+    uint64_t version() const;
+};
+
+#endif // PRICETABLE_H
@@ -0,0 +1,94 @@
+#include "protocol.h"
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+    template<typename T>
+    void put(std::string& out, const T& value){
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T peek(const std::string& data, size_t offset){
+        T value;
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+}
+
+
+void appendFrame(std::string& out, MessageType type, uint32_t requestID, const std::string& payload){
+    put(out, static_cast<uint32_t>(sizeof(uint8_t) + sizeof(uint32_t) + payload.size()));
+    put(out, static_cast<uint8_t>(type));
+    put(out, requestID);
+    out += payload;
+}
+
+
+bool takeFrame(const std::string& buffer, size_t& offset, Frame& frame){
+    if(buffer.size() - offset < sizeof(uint32_t)){
+        return false;
+    }
+    uint32_t length = peek<uint32_t>(buffer, offset);
+    if(length < FRAME_HEADER_BYTES - sizeof(uint32_t) || length > MAX_FRAME_BYTES){
+        throw std::runtime_error("Frame length out of range.");
+    }
+    if(buffer.size() - offset - sizeof(uint32_t) < length){
+        return false;
+    }
+
+    size_t cursor = offset + sizeof(uint32_t);
+    frame.type = static_cast<MessageType>(peek<uint8_t>(buffer, cursor));
+    frame.requestID = peek<uint32_t>(buffer, cursor + sizeof(uint8_t));
+    size_t payloadStart = offset + FRAME_HEADER_BYTES;
+    frame.payload.assign(buffer, payloadStart, length - (FRAME_HEADER_BYTES - sizeof(uint32_t)));
+    offset += sizeof(uint32_t) + length;
+    return true;
+}
+
+
+
+PayloadWriter& PayloadWriter::u8(uint8_t value){ put(data, value); return *this; }
+
+PayloadWriter& PayloadWriter::i32(int32_t value){ put(data, value); return *this; }
+
+PayloadWriter& PayloadWriter::u16(uint16_t value){ put(data, value); return *this; }
+
+PayloadWriter& PayloadWriter::u64(uint64_t value){ put(data, value); return *this; }
+
+PayloadWriter& PayloadWriter::f64(double value){ put(data, value); return *this; }
+
+PayloadWriter& PayloadWriter::str(const std::string& value){
+    if(value.size() > UINT16_MAX){
+        throw std::runtime_error("String too long for the wire format.");
+    }
+    put(data, static_cast<uint16_t>(value.size()));
+    data += value;
+    return *this;
+}
+
+
+
+void PayloadReader::need(size_t bytes) const{
+    if(data.size() - position < bytes){
+        throw std::runtime_error("Malformed request.");
+    }
+}
+
+uint8_t PayloadReader::u8(){ need(sizeof(uint8_t)); position += sizeof(uint8_t); return peek<uint8_t>(data, position - sizeof(uint8_t)); }
+
+int32_t PayloadReader::i32(){ need(sizeof(int32_t)); position += sizeof(int32_t); return peek<int32_t>(data, position - sizeof(int32_t)); }
+
+uint16_t PayloadReader::u16(){ need(sizeof(uint16_t)); position += sizeof(uint16_t); return peek<uint16_t>(data, position - sizeof(uint16_t)); }
+
+uint64_t PayloadReader::u64(){ need(sizeof(uint64_t)); position += sizeof(uint64_t); return peek<uint64_t>(data, position - sizeof(uint64_t)); }
+
+double PayloadReader::f64(){ need(sizeof(double)); position += sizeof(double); return peek<double>(data, position - sizeof(double)); }
+
+std::string PayloadReader::str(){
+    uint16_t length = u16();
+    need(length);
+    position += length;
+    return data.substr(position - length, length);
+}
@@ -0,0 +1,98 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+
+
+// Order-entry wire format shared by OrderServer and LoadClient.
+// Every frame is [uint32 length][uint8 type][uint32 requestID][payload], where length counts
+// the type, requestID and payload bytes. Integers and doubles are little-endian; strings are
+// a uint16 length followed by the bytes. A response carries the requestID of its request and
+// is either Ok (with a type-specific payload) or Error (one string). Requests on a connection
+// are answered in the order they were sent.
+enum class MessageType : uint8_t {
+    Register = 1,      // username, password                -> int32 userID, session token; binds the connection
+    Login = 2,         // username, password                -> int32 userID, session token; binds the connection
+    Buy = 3,           // symbol, int32 quantity            -> (empty), at the current price
+    Sell = 4,          // symbol, int32 quantity            -> (empty)
+    LimitOrder = 5,    // uint8 side (0 buy), symbol, int32 quantity, double limitPrice -> uint64 orderID
+    Cancel = 6,        // uint64 orderID                    -> (empty)
+    Balance = 7,       //                                   -> double
+    Portfolio = 8,     //                                   -> uint16 count, {symbol, int32 quantity, double price}
+    Deposit = 9,       // double amount                     -> (empty)
+    Resume = 10,       // session token                     -> int32 userID; binds a new connection without the password
+
+    Ok = 64,
+    Error = 65,
+};
+
+constexpr size_t FRAME_HEADER_BYTES = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+constexpr size_t MAX_FRAME_BYTES = 64 * 1024;
+// The length field counts the type and request ID as well as the payload
+constexpr size_t MAX_PAYLOAD_BYTES = MAX_FRAME_BYTES - (FRAME_HEADER_BYTES - sizeof(uint32_t));
+
+struct Frame {
+    MessageType type = MessageType::Ok;
+    uint32_t requestID = 0;
+    std::string payload;
+};
+
+
+void appendFrame(std::string& out, MessageType type, uint32_t requestID, const std::string& payload);
+
+// Takes the frame starting at `offset` and advances past it. False if the buffer does not hold
+// all of it yet; throws if the length is out of range.
+bool takeFrame(const std::string& buffer, size_t& offset, Frame& frame);
+
+
+class PayloadWriter {
+
+    private:
+        std::string data;
+
+    public:
+
+    PayloadWriter& u8(uint8_t value);
+
+    PayloadWriter& i32(int32_t value);
+
+    PayloadWriter& u16(uint16_t value);
+
+    PayloadWriter& u64(uint64_t value);
+
+    PayloadWriter& f64(double value);
+
+    PayloadWriter& str(const std::string& value);
+
+    const std::string& bytes() const { return data; }
+};
+
+
+// Reads fields in order; any read past the end throws, so a short payload is one error
+class PayloadReader {
+
+    private:
+        const std::string& data;
+        size_t position = 0;
+
+        void need(size_t bytes) const;
+
+    public:
+
+    explicit PayloadReader(const std::string& data) : data(data) {}
+
+    uint8_t u8();
+
+    int32_t i32();
+
+    uint16_t u16();
+
+    uint64_t u64();
+
+    double f64();
+
+    std::string str();
+};
+
+#endif // PROTOCOL_H
@@ -0,0 +1,383 @@
+#include "quotefeed.h"
+#include <array>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <netdb.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace {
+    // A quote server that hangs up mid-request fails the send rather than raising SIGPIPE
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+}
+
+
+FileQuoteSource::FileQuoteSource(const std::string& path)
+    : path(path)
+{
+}
+
+std::string FileQuoteSource::read(){
+    std::ifstream file(path, std::ios::binary);
+    if(!file){
+        throw std::runtime_error("Could not open quote file: " + path);
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+
+PipeQuoteSource::PipeQuoteSource(const std::string& command)
+    : command(command)
+{
+}
+
+std::string PipeQuoteSource::read(){
+    std::array<char, 4096> buffer;
+    std::string result;
+
+    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
+    if (!pipe) {
+        throw std::runtime_error("popen() failed!");
+    }
+
+    size_t got;
+    while ((got = fread(buffer.data(), 1, buffer.size(), pipe.get())) > 0) {
+        result.append(buffer.data(), got);
+    }
+    return result;
+}
+
+
+HttpQuoteSource::HttpQuoteSource(const std::string& host, const std::string& port, const std::string& path)
+    : host(host), port(port), path(path)
+{
+}
+
+std::string HttpQuoteSource::read(){
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0){
+        throw std::runtime_error("Could not resolve quote server " + host);
+    }
+    std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addressGuard(addresses, freeaddrinfo);
+
+    int fd = -1;
+    for(addrinfo* address = addresses; address; address = address->ai_next){
+        fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(fd < 0){
+            continue;
+        }
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        if(::connect(fd, address->ai_addr, address->ai_addrlen) == 0){
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    if(fd < 0){
+        throw std::runtime_error("Could not connect to quote server " + host + ":" + port);
+    }
+
+    std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+    const char* data = request.data();
+    size_t remaining = request.size();
+    while(remaining > 0){
+        ssize_t sent = ::send(fd, data, remaining, SEND_FLAGS);
+        if(sent <= 0){
+            ::close(fd);
+            throw std::runtime_error("Failed to send quote request.");
+        }
+        data += sent;
+        remaining -= static_cast<size_t>(sent);
+    }
+
+    std::string response;
+    std::array<char, 4096> buffer;
+    ssize_t got;
+    while((got = ::recv(fd, buffer.data(), buffer.size(), 0)) > 0){
+        response.append(buffer.data(), static_cast<size_t>(got));
+    }
+    ::close(fd);
+
+    size_t statusEnd = response.find("\r\n");
+    std::string statusLine = response.substr(0, statusEnd);
+    if(statusEnd == std::string::npos || statusLine.find(" 200") == std::string::npos){
+        throw std::runtime_error("Quote server returned: " + statusLine);
+    }
+    size_t bodyStart = response.find("\r\n\r\n");
+    return bodyStart == std::string::npos ? std::string() : response.substr(bodyStart + 4);
+}
+
+
+
+namespace {
+    std::string_view trim(std::string_view text){
+        while(!text.empty() && (text.front() == ' ' || text.front() == '\t' || text.front() == '\r' || text.front() == '\n')){
+            text.remove_prefix(1);
+        }
+        while(!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r' || text.back() == '\n')){
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // Decimal parser for prices and volumes: [-]digits[.digits][e[-]digits], no locale, no allocation
+    bool parseNumber(std::string_view text, double& value){
+        static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                             1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        text = trim(text);
+        size_t i = 0;
+        bool negative = false;
+        if(i < text.size() && (text[i] == '-' || text[i] == '+')){
+            negative = text[i] == '-';
+            i++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        for(; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++){
+            if(mantissa < 1000000000000000000ULL){
+                mantissa = mantissa * 10 + (text[i] - '0');
+            } else {
+                exponent++;
+            }
+        }
+        if(i < text.size() && text[i] == '.'){
+            for(i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++){
+                if(mantissa < 1000000000000000000ULL){
+                    mantissa = mantissa * 10 + (text[i] - '0');
+                    exponent--;
+                }
+            }
+        }
+        if(digits == 0){
+            return false;
+        }
+        if(i < text.size() && (text[i] == 'e' || text[i] == 'E')){
+            i++;
+            bool negativeExponent = false;
+            if(i < text.size() && (text[i] == '-' || text[i] == '+')){
+                negativeExponent = text[i] == '-';
+                i++;
+            }
+            int explicitExponent = 0;
+            int exponentDigits = 0;
+            for(; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, exponentDigits++){
+                explicitExponent = explicitExponent * 10 + (text[i] - '0');
+            }
+            if(exponentDigits == 0){
+                return false;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        }
+        if(i != text.size() || exponent > 22 || exponent < -22){
+            return false;
+        }
+
+        value = static_cast<double>(mantissa);
+        value = (exponent < 0) ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+        if(negative){
+            value = -value;
+        }
+        return true;
+    }
+
+
+    size_t parseCsv(std::string_view buffer, std::vector<Quote>& out){
+        size_t parsed = 0;
+        while(!buffer.empty()){
+            size_t lineEnd = buffer.find('\n');
+            std::string_view line = buffer.substr(0, lineEnd);
+            buffer.remove_prefix(lineEnd == std::string_view::npos ? buffer.size() : lineEnd + 1);
+
+            // symbol,price[,volume[,name]] -- the name is the rest of the line so it may contain commas
+            std::string_view fields[4];
+            size_t fieldCount = 0;
+            while(fieldCount < 3){
+                size_t comma = line.find(',');
+                if(comma == std::string_view::npos){
+                    break;
+                }
+                fields[fieldCount++] = line.substr(0, comma);
+                line.remove_prefix(comma + 1);
+            }
+            fields[fieldCount++] = line;
+
+            Quote quote;
+            quote.symbol = trim(fields[0]);
+            if(fieldCount < 2 || quote.symbol.empty() || !parseNumber(fields[1], quote.price)){
+                continue; // header row or malformed line
+            }
+            double volume = 0;
+            if(fieldCount > 2 && parseNumber(fields[2], volume)){
+                quote.volume = static_cast<int64_t>(volume);
+            }
+            if(fieldCount > 3){
+                quote.companyName = trim(fields[3]);
+            }
+            out.push_back(quote);
+            parsed++;
+        }
+        return parsed;
+    }
+
+
+    struct JsonCursor {
+        std::string_view text;
+        size_t pos = 0;
+
+        void skipSpace(){
+            while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')){
+                pos++;
+            }
+        }
+
+        bool consume(char expected){
+            skipSpace();
+            if(pos < text.size() && text[pos] == expected){
+                pos++;
+                return true;
+            }
+            return false;
+        }
+
+        // Returns the raw contents between the quotes; escapes are left as-is
+        bool readString(std::string_view& value){
+            if(!consume('"')){
+                return false;
+            }
+            size_t start = pos;
+            while(pos < text.size() && text[pos] != '"'){
+                pos += (text[pos] == '\\') ? 2 : 1;
+            }
+            if(pos >= text.size()){
+                return false;
+            }
+            value = text.substr(start, pos - start);
+            pos++;
+            return true;
+        }
+
+        // Returns the raw text of a scalar, or skips a nested object/array entirely
+        bool readValue(std::string_view& value, bool& isString){
+            skipSpace();
+            if(pos >= text.size()){
+                return false;
+            }
+            isString = text[pos] == '"';
+            if(isString){
+                return readString(value);
+            }
+            size_t start = pos;
+            if(text[pos] == '{' || text[pos] == '['){
+                int depth = 0;
+                do{
+                    char c = text[pos];
+                    if(c == '"'){
+                        std::string_view ignored;
+                        if(!readString(ignored)){
+                            return false;
+                        }
+                        continue;
+                    }
+                    if(c == '{' || c == '['){
+                        depth++;
+                    } else if(c == '}' || c == ']'){
+                        depth--;
+                    }
+                    pos++;
+                } while(depth > 0 && pos < text.size());
+            } else {
+                while(pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']'){
+                    pos++;
+                }
+            }
+            value = text.substr(start, pos - start);
+            return true;
+        }
+    };
+
+
+    size_t parseJson(std::string_view buffer, std::vector<Quote>& out){
+        JsonCursor cursor{buffer};
+        size_t parsed = 0;
+
+        // Accepts an array of objects or newline-delimited objects
+        while(true){
+            cursor.skipSpace();
+            while(cursor.pos < buffer.size() && (buffer[cursor.pos] == '[' || buffer[cursor.pos] == ',' || buffer[cursor.pos] == ']')){
+                cursor.pos++;
+                cursor.skipSpace();
+            }
+            if(!cursor.consume('{')){
+                break;
+            }
+
+            Quote quote;
+            bool hasPrice = false;
+            bool ok = true;
+            if(!cursor.consume('}')){
+                do{
+                    std::string_view key;
+                    std::string_view value;
+                    bool isString = false;
+                    if(!cursor.readString(key) || !cursor.consume(':') || !cursor.readValue(value, isString)){
+                        ok = false;
+                        break;
+                    }
+                    if(key == "symbol" && isString){
+                        quote.symbol = value;
+                    } else if(key == "name" && isString){
+                        quote.companyName = value;
+                    } else if(key == "price"){
+                        hasPrice = parseNumber(value, quote.price);
+                    } else if(key == "volume"){
+                        double volume = 0;
+                        if(parseNumber(value, volume)){
+                            quote.volume = static_cast<int64_t>(volume);
+                        }
+                    }
+                } while(cursor.consume(','));
+                if(!ok || !cursor.consume('}')){
+                    break; // malformed; keep what was parsed so far
+                }
+            }
+
+            if(hasPrice && !quote.symbol.empty()){
+                out.push_back(quote);
+                parsed++;
+            }
+        }
+        return parsed;
+    }
+}
+
+
+size_t parseQuotes(std::string_view buffer, std::vector<Quote>& out){
+    std::string_view trimmed = trim(buffer);
+    if(trimmed.empty()){
+        return 0;
+    }
+    if(trimmed.front() == '[' || trimmed.front() == '{'){
+        return parseJson(trimmed, out);
+    }
+    return parseCsv(trimmed, out);
+}
@@ -0,0 +1,73 @@
+#ifndef QUOTEFEED_H
+#define QUOTEFEED_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// One parsed quote. The views point into the buffer passed to parseQuotes,
+// so quotes are only valid while that buffer is alive and unchanged.
+struct Quote {
+    std::string_view symbol;
+    std::string_view companyName;   // empty when the source does not supply one
+    double price = 0.0;
+    int64_t volume = 0;
+};
+
+
+// Where raw quote text comes from. read() returns the whole payload of one refresh.
+class QuoteSource {
+    public:
+    virtual ~QuoteSource() = default;
+
+    virtual std::string read() = 0;
+};
+
+
+// Reads a CSV or JSON file on every refresh (e.g. a file another process rewrites)
+class FileQuoteSource : public QuoteSource {
+    private:
+        std::string path;
+
+    public:
+    explicit FileQuoteSource(const std::string& path);
+
+    std::string read() override;
+};
+
+
+// Runs a command and captures its stdout (e.g. `python3 update_stocks.py --csv`)
+class PipeQuoteSource : public QuoteSource {
+    private:
+        std::string command;
+
+    public:
+    explicit PipeQuoteSource(const std::string& command);
+
+    std::string read() override;
+};
+
+
+// Plain HTTP/1.0 GET against a local quote server or test stand-in
+class HttpQuoteSource : public QuoteSource {
+    private:
+        std::string host;
+        std::string port;
+        std::string path;
+
+    public:
+    HttpQuoteSource(const std::string& host, const std::string& port, const std::string& path);
+
+    std::string read() override;
+};
+
+
+// Parses CSV (`symbol,price[,volume[,name]]`, one quote per line, header and malformed
+// lines skipped) or a JSON array of {"symbol","price","volume","name"} objects.
+// The format is picked from the first non-blank character. Nothing is allocated beyond
+// growing `out`, which callers can reuse between refreshes. Returns the number parsed.
+size_t parseQuotes(std::string_view buffer, std::vector<Quote>& out);
+
+#endif // QUOTEFEED_H
@@ -0,0 +1,154 @@
+#include "replay.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+
+std::vector<ScheduledOrder> loadScheduledOrders(const std::string& path){
+    std::ifstream file(path);
+    if(!file){
+        throw std::runtime_error("Could not open order schedule: " + path);
+    }
+
+    std::vector<ScheduledOrder> scheduled;
+    std::string line;
+    while(std::getline(file, line)){
+        std::istringstream fields(line);
+        std::string timestamp, userID, symbol, side, quantity, limitPrice;
+        if(!std::getline(fields, timestamp, ',') || !std::getline(fields, userID, ',') ||
+           !std::getline(fields, symbol, ',') || !std::getline(fields, side, ',') ||
+           !std::getline(fields, quantity, ',') || !std::getline(fields, limitPrice)){
+            continue;
+        }
+        if(side != "Buy" && side != "Sell"){
+            continue; // header row
+        }
+        try{
+            scheduled.push_back(ScheduledOrder{std::stoll(timestamp), std::stoi(userID), symbol,
+                                               side == "Buy" ? Side::Buy : Side::Sell,
+                                               std::stoi(quantity), std::stod(limitPrice)});
+        } catch (const std::exception&){
+            continue;
+        }
+    }
+    return scheduled;
+}
+
+
+
+MarketReplay::MarketReplay(const std::string& directory, std::vector<std::string> symbols, int64_t from, int64_t to){
+    if(symbols.empty()){
+        symbols = TickStore::symbolsIn(directory);
+    }
+
+    // Cursor order is the tie-break inside a batch, so it must not depend on the directory listing
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+
+    for(const std::string& symbol : symbols){
+        Cursor cursor;
+        cursor.symbol = symbol;
+        cursor.reader = std::make_unique<TickReader>(TickStore::pathFor(directory, symbol));
+        cursor.index = cursor.reader->seek(from);
+        cursor.end = cursor.reader->seek(to);
+        cursor.span = cursor.reader->run(cursor.index, cursor.end);
+        cursor.offset = 0;
+        cursors.push_back(std::move(cursor));
+    }
+}
+
+
+void MarketReplay::schedule(std::vector<ScheduledOrder> scheduled){
+    orders = std::move(scheduled);
+    std::stable_sort(orders.begin(), orders.end(),
+        [](const ScheduledOrder& a, const ScheduledOrder& b){ return a.timestamp < b.timestamp; });
+}
+
+
+bool MarketReplay::advance(Cursor& cursor){
+    cursor.offset++;
+    if(cursor.offset < cursor.span.count){
+        return true;
+    }
+    cursor.index += cursor.span.count;
+    cursor.span = cursor.reader->run(cursor.index, cursor.end);
+    cursor.offset = 0;
+    return cursor.span.count > 0;
+}
+
+
+ReplayStats MarketReplay::run(double speed, const PriceSink& publish, const OrderSink& submit){
+    using Clock = std::chrono::steady_clock;
+
+    ReplayStats stats;
+    std::vector<std::pair<std::string, double>> batch;
+    batch.reserve(cursors.size());
+    size_t nextOrder = 0;
+
+    std::vector<Cursor*> active;
+    for(Cursor& cursor : cursors){
+        if(cursor.span.count > 0){
+            active.push_back(&cursor);
+        }
+    }
+
+    Clock::time_point wallStart = Clock::now();
+    int64_t firstTimestamp = 0;
+    bool started = false;
+
+    while(!active.empty()){
+        int64_t timestamp = INT64_MAX;
+        for(Cursor* cursor : active){
+            timestamp = std::min(timestamp, cursor->span.timestamps[cursor->offset]);
+        }
+        if(!started){
+            firstTimestamp = timestamp;
+            wallStart = Clock::now();
+            started = true;
+        }
+
+        if(speed > 0){
+            Clock::time_point due = wallStart + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::nano>((timestamp - firstTimestamp) / speed));
+            Clock::time_point now = Clock::now();
+            if(now < due){
+                std::this_thread::sleep_until(due);
+            } else {
+                stats.maxLagMillis = std::max(stats.maxLagMillis,
+                    std::chrono::duration<double, std::milli>(now - due).count());
+            }
+        }
+
+        while(nextOrder < orders.size() && orders[nextOrder].timestamp <= timestamp){
+            submit(orders[nextOrder++]);
+            stats.orders++;
+        }
+
+        batch.clear();
+        for(Cursor* cursor : active){
+            while(cursor->span.count > 0 && cursor->span.timestamps[cursor->offset] == timestamp){
+                batch.emplace_back(cursor->symbol, cursor->span.prices[cursor->offset]);
+                advance(*cursor);
+            }
+        }
+        active.erase(std::remove_if(active.begin(), active.end(),
+            [](const Cursor* cursor){ return cursor->span.count == 0; }), active.end());
+
+        publish(batch);
+        stats.batches++;
+        stats.updates += batch.size();
+    }
+
+    // Orders scheduled after the last tick still rest on the book, as they would live
+    while(nextOrder < orders.size()){
+        submit(orders[nextOrder++]);
+        stats.orders++;
+    }
+
+    stats.seconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    stats.updatesPerSecond = (stats.seconds > 0) ? stats.updates / stats.seconds : 0.0;
+    return stats;
+}
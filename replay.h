@@ -0,0 +1,81 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "orderbook.h"
+#include "tickstore.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// A limit order injected into a replay at a recorded time
+struct ScheduledOrder {
+    int64_t timestamp;
+    int userID;
+    std::string symbol;
+    Side side;
+    int quantity;
+    double limitPrice;
+};
+
+struct ReplayStats {
+    size_t batches = 0;          // distinct recorded timestamps
+    size_t updates = 0;          // prices published
+    size_t orders = 0;           // scheduled orders submitted
+    double seconds = 0.0;
+    double updatesPerSecond = 0.0;
+    double maxLagMillis = 0.0;   // furthest the replay fell behind its paced schedule
+};
+
+
+// Reads "timestamp,userID,symbol,side,quantity,limitPrice" lines; side is Buy or Sell.
+// Lines that do not parse (including a header) are skipped.
+std::vector<ScheduledOrder> loadScheduledOrders(const std::string& path);
+
+
+// Feeds ticks recorded by TickStore back through the live price path.
+// Everything runs on the caller's thread and time comes only from the recorded
+// timestamps: ticks sharing a timestamp are published as one batch (one refresh),
+// batches go out in timestamp order with ties broken by symbol name, and scheduled
+// orders are submitted just before the first batch at or after their timestamp.
+// The speed only changes how long the replay sleeps between batches, so a given
+// file and order schedule always produce the same sequence of calls.
+class MarketReplay {
+
+    public:
+        using PriceSink = std::function<void(const std::vector<std::pair<std::string, double>>&)>;
+        using OrderSink = std::function<void(const ScheduledOrder&)>;
+
+    private:
+        struct Cursor {
+            std::string symbol;
+            std::unique_ptr<TickReader> reader;
+            uint64_t index;
+            uint64_t end;
+            TickSpan span;
+            size_t offset;
+        };
+
+        std::vector<Cursor> cursors;
+        std::vector<ScheduledOrder> orders;
+
+        static bool advance(Cursor& cursor);
+
+    public:
+
+    // An empty symbol list replays every .ticks file in the directory
+    MarketReplay(const std::string& directory, std::vector<std::string> symbols,
+                 int64_t from = INT64_MIN, int64_t to = INT64_MAX);
+
+    void schedule(std::vector<ScheduledOrder> scheduled);
+
+    size_t symbolCount() const { return cursors.size(); }
+
+    // speed 1 replays in recorded time, N runs N times faster, 0 runs as fast as the sinks allow
+    ReplayStats run(double speed, const PriceSink& publish, const OrderSink& submit);
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,175 @@
+#include "riskengine.h"
+#include "metrics.h"
+#include <chrono>
+#ifdef __linux__
+#include <time.h>
+#endif
+
+
+void RiskEngine::Limits::store(const RiskLimits& limits){
+    checkBuyingPower.store(limits.checkBuyingPower, std::memory_order_relaxed);
+    maxOrderNotional.store(limits.maxOrderNotional, std::memory_order_relaxed);
+    maxPosition.store(limits.maxPosition, std::memory_order_relaxed);
+    maxOrdersPerSecond.store(limits.maxOrdersPerSecond, std::memory_order_relaxed);
+}
+
+RiskLimits RiskEngine::Limits::load() const{
+    RiskLimits limits;
+    limits.checkBuyingPower = checkBuyingPower.load(std::memory_order_relaxed);
+    limits.maxOrderNotional = maxOrderNotional.load(std::memory_order_relaxed);
+    limits.maxPosition = maxPosition.load(std::memory_order_relaxed);
+    limits.maxOrdersPerSecond = maxOrdersPerSecond.load(std::memory_order_relaxed);
+    return limits;
+}
+
+
+RiskEngine::RiskEngine()
+    : chunks(new std::atomic<Account*>[MAX_CHUNKS])
+{
+    for(size_t i = 0; i < MAX_CHUNKS; i++){
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+RiskEngine::~RiskEngine(){
+    for(size_t i = 0; i < MAX_CHUNKS; i++){
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+RiskEngine::Account& RiskEngine::account(int userID){
+    if(userID < 0 || static_cast<size_t>(userID) >= CHUNK_ACCOUNTS * MAX_CHUNKS){
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        std::unique_ptr<Account>& slot = overflow[userID];
+        if(!slot){
+            slot = std::make_unique<Account>();
+        }
+        return *slot;
+    }
+    std::atomic<Account*>& chunk = chunks[userID / CHUNK_ACCOUNTS];
+    Account* accounts = chunk.load(std::memory_order_acquire);
+    if(!accounts){
+        Account* fresh = new Account[CHUNK_ACCOUNTS];
+        if(chunk.compare_exchange_strong(accounts, fresh, std::memory_order_acq_rel)){
+            accounts = fresh;
+        } else {
+            delete[] fresh;   // another thread installed one first; `accounts` now holds it
+        }
+    }
+    return accounts[userID % CHUNK_ACCOUNTS];
+}
+
+
+void RiskEngine::setDefaultLimits(const RiskLimits& limits){
+    defaults.store(limits);
+}
+
+RiskLimits RiskEngine::defaultLimits() const{
+    return defaults.load();
+}
+
+void RiskEngine::setLimits(int userID, const RiskLimits& limits){
+    Account& slot = account(userID);
+    slot.own.store(limits);
+    slot.custom.store(true, std::memory_order_release);
+}
+
+void RiskEngine::clearLimits(int userID){
+    account(userID).custom.store(false, std::memory_order_release);
+}
+
+RiskLimits RiskEngine::limitsFor(int userID){
+    Account& slot = account(userID);
+    return slot.custom.load(std::memory_order_acquire) ? slot.own.load() : defaults.load();
+}
+
+
+namespace {
+    // The rate window only needs whole seconds; the coarse clock is a few nanoseconds to read
+    // where a full-resolution one costs more than the rest of the check
+    int64_t currentSecond(){
+#ifdef __linux__
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        return static_cast<int64_t>(now.tv_sec);
+#else
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+}
+
+
+RiskRule RiskEngine::reject(RiskRule rule){
+    switch(rule){
+        case RiskRule::OrderRate: Metrics::add(Metrics::RiskOrderRate); break;
+        case RiskRule::MaxNotional: Metrics::add(Metrics::RiskMaxNotional); break;
+        case RiskRule::MaxPosition: Metrics::add(Metrics::RiskMaxPosition); break;
+        case RiskRule::BuyingPower: Metrics::add(Metrics::RiskBuyingPower); break;
+        case RiskRule::None: break;
+    }
+    return rule;
+}
+
+
+RiskRule RiskEngine::check(const RiskOrder& order){
+    Account& slot = account(order.userID);
+    const Limits& limits = slot.custom.load(std::memory_order_acquire) ? slot.own : defaults;
+
+    double notional = order.price * order.quantity;
+    double maxOrderNotional = limits.maxOrderNotional.load(std::memory_order_relaxed);
+    if(maxOrderNotional > 0 && notional > maxOrderNotional){
+        return reject(RiskRule::MaxNotional);
+    }
+
+    // Sells only shrink a position and raise cash; storage already refuses selling more than is held
+    if(order.side == Side::Buy){
+        int maxPosition = limits.maxPosition.load(std::memory_order_relaxed);
+        if(maxPosition > 0 && static_cast<int64_t>(order.position) + order.quantity > maxPosition){
+            return reject(RiskRule::MaxPosition);
+        }
+        if(limits.checkBuyingPower.load(std::memory_order_relaxed) && notional > order.buyingPower){
+            return reject(RiskRule::BuyingPower);
+        }
+    }
+
+    uint32_t maxOrdersPerSecond = limits.maxOrdersPerSecond.load(std::memory_order_relaxed);
+    if(maxOrdersPerSecond > 0){
+        int64_t second = currentSecond();
+        int64_t window = slot.window.load(std::memory_order_relaxed);
+        // Whoever moves the window forward restarts the count; an order racing the reset may
+        // land in either window
+        if(window != second && slot.window.compare_exchange_strong(window, second, std::memory_order_relaxed)){
+            slot.windowOrders.store(0, std::memory_order_relaxed);
+        }
+        if(slot.windowOrders.fetch_add(1, std::memory_order_relaxed) >= maxOrdersPerSecond){
+            return reject(RiskRule::OrderRate);
+        }
+    }
+    return RiskRule::None;
+}
+
+
+const char* RiskEngine::describe(RiskRule rule){
+    switch(rule){
+        case RiskRule::OrderRate: return "Order rate limit exceeded.";
+        case RiskRule::MaxNotional: return "Order exceeds the maximum order value.";
+        case RiskRule::MaxPosition: return "Order would exceed the maximum position.";
+        case RiskRule::BuyingPower: return "Insufficient funds to buy stock.";
+        case RiskRule::None: break;
+    }
+    return "Order passed risk checks.";
+}
+
+
+uint64_t RiskEngine::rejected(RiskRule rule){
+    switch(rule){
+        case RiskRule::OrderRate: return Metrics::counter(Metrics::RiskOrderRate);
+        case RiskRule::MaxNotional: return Metrics::counter(Metrics::RiskMaxNotional);
+        case RiskRule::MaxPosition: return Metrics::counter(Metrics::RiskMaxPosition);
+        case RiskRule::BuyingPower: return Metrics::counter(Metrics::RiskBuyingPower);
+        case RiskRule::None: break;
+    }
+    return 0;
+}
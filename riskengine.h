@@ -0,0 +1,113 @@
+#ifndef RISKENGINE_H
+#define RISKENGINE_H
+
+#include "orderbook.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+
+// Zero turns a limit off
+struct RiskLimits {
+    bool checkBuyingPower = true;
+    double maxOrderNotional = 0.0;
+    int maxPosition = 0;               // shares of one symbol held after a buy
+    uint32_t maxOrdersPerSecond = 0;
+};
+
+enum class RiskRule {
+    None,          // passed every check
+    OrderRate,
+    MaxNotional,
+    MaxPosition,
+    BuyingPower,
+};
+
+// An order together with the account state it is checked against, as the caller's in-memory
+// mirrors have it; storage still re-checks funds and holdings when the trade is written
+struct RiskOrder {
+    int userID = 0;
+    Side side = Side::Buy;
+    int quantity = 0;
+    double price = 0.0;
+    double buyingPower = 0.0;
+    int position = 0;   // shares of the order's symbol held now
+};
+
+
+// Pre-trade limits checked in memory before an order reaches storage. Each account has its own
+// cache-line slot, found by UserID through lazily allocated chunks without a lock, so checks
+// for different users never share a line and never wait on each other; UserIDs past the chunks
+// share one locked map instead. Limits are plain relaxed atomics: a check racing a limit change
+// may see some old and some new values.
+// Rejections are counted per rule in Metrics.
+class RiskEngine {
+
+    public:
+        static constexpr size_t CHUNK_ACCOUNTS = 4096;
+        static constexpr size_t MAX_CHUNKS = 1024;   // UserIDs below 4M; the rest go to `overflow`
+
+    private:
+        struct Limits {
+            std::atomic<bool> checkBuyingPower{true};
+            std::atomic<double> maxOrderNotional{0.0};
+            std::atomic<int> maxPosition{0};
+            std::atomic<uint32_t> maxOrdersPerSecond{0};
+
+            void store(const RiskLimits& limits);
+
+            RiskLimits load() const;
+        };
+
+        struct alignas(64) Account {
+            std::atomic<int64_t> window{-1};   // steady-clock second the count belongs to
+            std::atomic<uint32_t> windowOrders{0};
+            std::atomic<bool> custom{false};   // `own` applies instead of the defaults
+            Limits own;
+        };
+
+        std::unique_ptr<std::atomic<Account*>[]> chunks;
+        std::mutex overflowMutex;
+        std::unordered_map<int, std::unique_ptr<Account>> overflow;   // UserIDs the chunks do not cover
+        Limits defaults;
+
+        // Allocates the account's chunk on first use; racing allocators keep whichever won.
+        // Accounts outside the chunks are found under overflowMutex; they never move once made.
+        Account& account(int userID);
+
+        static RiskRule reject(RiskRule rule);
+
+    public:
+
+    RiskEngine();
+
+    ~RiskEngine();
+
+    RiskEngine(const RiskEngine&) = delete;
+    RiskEngine& operator=(const RiskEngine&) = delete;
+
+    // Applies to every account without limits of its own
+    void setDefaultLimits(const RiskLimits& limits);
+
+    RiskLimits defaultLimits() const;
+
+    void setLimits(int userID, const RiskLimits& limits);
+
+    // Returns the account to the defaults
+    void clearLimits(int userID);
+
+    RiskLimits limitsFor(int userID);
+
+    // Returns the first rule the order breaks. The rate is checked last, so only orders that
+    // pass every other rule use it up.
+    RiskRule check(const RiskOrder& order);
+
+    static const char* describe(RiskRule rule);
+
+    // Orders rejected by the rule since start, over every thread
+    static uint64_t rejected(RiskRule rule);
+};
+
+#endif // RISKENGINE_H
@@ -99,9 +99,64 @@ def get_sentiment(symbol, useTwitter = False):
 
 #print(get_sentiment('PLTR', 0))  # Example usage
 
+def serve(workers=4):
+    """
+    Long-lived worker mode used by the C++ side (SentimentWorker).
+
+    Frames on stdin/stdout are a 4-byte big-endian length followed by UTF-8 text.
+    Request:  "<requestID> <symbol> <useTwitter 0|1>"
+    Response: "<requestID> ok <text>" or "<requestID> err <message>"
+    Requests are answered out of order by a pool of `workers` threads so several can be in flight.
+    """
+    import struct
+    import sys
+    import threading
+    from concurrent.futures import ThreadPoolExecutor
+
+    stdin = sys.stdin.buffer
+    stdout = sys.stdout.buffer
+    sys.stdout = sys.stderr  # stray prints must not corrupt the framed stream
+    write_lock = threading.Lock()
+
+    def send(text):
+        payload = text.encode('utf-8')
+        with write_lock:
+            stdout.write(struct.pack('>I', len(payload)) + payload)
+            stdout.flush()
+
+    def handle(request_id, symbol, use_twitter):
+        try:
+            result = get_sentiment(symbol, use_twitter)
+            send(f"{request_id} ok The sentiment for {symbol} is: {result}")
+        except Exception as e:
+            send(f"{request_id} err {e}")
+
+    def read_exact(n):
+        data = b''
+        while len(data) < n:
+            chunk = stdin.read(n - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+    with ThreadPoolExecutor(max_workers=workers) as pool:
+        while True:
+            header = read_exact(4)
+            if header is None:
+                break  # parent closed the pipe
+            payload = read_exact(struct.unpack('>I', header)[0])
+            if payload is None:
+                break
+            request_id, symbol, use_twitter = payload.decode('utf-8').split(' ')
+            pool.submit(handle, request_id, symbol, use_twitter == '1')
+
+
 if __name__ == "__main__":
     import sys
-    if len(sys.argv) > 1:
+    if len(sys.argv) > 1 and sys.argv[1] == '--serve':
+        serve(int(sys.argv[2]) if len(sys.argv) > 2 else 4)
+    elif len(sys.argv) > 1:
         symbol = sys.argv[1]
         use_twitter = len(sys.argv) > 2 and sys.argv[2] == '1'
         print(f"The sentiment for {symbol} is: {get_sentiment(symbol, use_twitter)}")
@@ -0,0 +1,74 @@
+#include "sentimentcache.h"
+
+
+SentimentCache::SentimentCache(Fetcher fetcher, Clock::duration ttl, size_t concurrency)
+    : fetcher(std::move(fetcher)), ttl(ttl), snapshot(std::make_shared<const Snapshot>()), pool(concurrency)
+{
+}
+
+SentimentCache::~SentimentCache(){
+    // Fetches hold `this`; the queued ones never start and the running ones finish here
+    pool.stop();
+}
+
+
+SentimentCache::Lookup SentimentCache::get(const std::string& symbol){
+    Lookup lookup;
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+
+    auto found = current->find(symbol);
+    if(found != current->end()){
+        lookup.found = true;
+        lookup.value = found->second->value;
+        lookup.age = Clock::now() - found->second->fetchedAt;
+        lookup.stale = lookup.age > ttl;
+    }
+
+    if(!lookup.found || lookup.stale){
+        fetch(symbol);
+    }
+    return lookup;
+}
+
+
+std::shared_future<std::string> SentimentCache::fetch(const std::string& symbol){
+    std::lock_guard<std::mutex> lock(flightMutex);
+    auto running = inFlight.find(symbol);
+    if(running != inFlight.end()){
+        return running->second;
+    }
+
+    auto promise = std::make_shared<std::promise<std::string>>();
+    std::shared_future<std::string> result = promise->get_future().share();
+    inFlight.emplace(symbol, result);
+
+    pool.submit([this, symbol, promise]{
+        try{
+            std::string value = fetcher(symbol);
+            store(symbol, value);
+            promise->set_value(value);
+        } catch (...){
+            promise->set_exception(std::current_exception());
+        }
+
+        std::lock_guard<std::mutex> lock(flightMutex);
+        inFlight.erase(symbol);
+    });
+
+    return result;
+}
+
+
+void SentimentCache::put(const std::string& symbol, const std::string& value){
+    store(symbol, value);
+}
+
+
+void SentimentCache::store(const std::string& symbol, const std::string& value){
+    auto entry = std::make_shared<const Entry>(Entry{value, Clock::now()});
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto next = std::make_shared<Snapshot>(*std::atomic_load(&snapshot));
+    (*next)[symbol] = std::move(entry);
+    std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+}
@@ -0,0 +1,71 @@
+#ifndef SENTIMENTCACHE_H
+#define SENTIMENTCACHE_H
+
+#include "threadpool.h"
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+// Read-mostly sentiment cache.
+// Readers load an immutable snapshot of the map through an atomic shared_ptr and never
+// take a lock; writers copy the map, update it and publish the new snapshot (RCU style).
+// Misses and expired entries trigger at most one background fetch per symbol, run on the
+// cache's own pool, and an expired value keeps being served until its replacement lands
+// (stale-while-revalidate).
+class SentimentCache {
+
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Fetcher = std::function<std::string(const std::string&)>;
+
+        struct Lookup {
+            bool found = false;
+            bool stale = false;
+            std::string value;
+            Clock::duration age{};
+        };
+
+    private:
+        struct Entry {
+            std::string value;
+            Clock::time_point fetchedAt;
+        };
+        using Snapshot = std::unordered_map<std::string, std::shared_ptr<const Entry>>;
+
+        Fetcher fetcher;
+        Clock::duration ttl;
+
+        std::shared_ptr<const Snapshot> snapshot;   // accessed only via std::atomic_load/store
+        std::mutex writeMutex;
+
+        std::mutex flightMutex;
+        std::unordered_map<std::string, std::shared_future<std::string>> inFlight;
+
+        ThreadPool pool;   // last, so its fetches stop before the members they use go away
+
+        void store(const std::string& symbol, const std::string& value);
+
+    public:
+
+    // At most `concurrency` fetches run at once; the rest wait their turn
+    SentimentCache(Fetcher fetcher, Clock::duration ttl, size_t concurrency);
+
+    // Drops the fetches still queued (their futures report broken_promise) and waits for the
+    // running ones
+    ~SentimentCache();
+
+    // Never blocks on a fetch. A miss or a stale hit starts a background refresh.
+    Lookup get(const std::string& symbol);
+
+    // Starts a fetch unless one is already running for this symbol, and returns its result
+    std::shared_future<std::string> fetch(const std::string& symbol);
+
+    void put(const std::string& symbol, const std::string& value);
+};
+
+#endif // SENTIMENTCACHE_H
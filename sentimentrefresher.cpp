@@ -0,0 +1,155 @@
+#include "sentimentrefresher.h"
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+
+SentimentRefresher::SentimentRefresher(SentimentCache& cache, size_t concurrency, Clock::duration interval,
+                                       SymbolSource trackedSymbols, SymbolSource heldSymbols)
+    : cache(cache), pool(concurrency), interval(interval),
+      trackedSymbols(std::move(trackedSymbols)), heldSymbols(std::move(heldSymbols))
+{
+}
+
+SentimentRefresher::~SentimentRefresher(){
+    stop();
+}
+
+
+void SentimentRefresher::start(){
+    thread = std::thread(&SentimentRefresher::run, this);
+}
+
+
+void SentimentRefresher::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    pool.stop();
+    if(thread.joinable()){
+        thread.join();
+    }
+}
+
+
+void SentimentRefresher::markRequested(const std::string& symbol){
+    std::lock_guard<std::mutex> lock(mutex);
+    lastRequested[symbol] = Clock::now();
+}
+
+
+std::vector<std::string> SentimentRefresher::sweepOrder(size_t& prioritized){
+    std::vector<std::string> order;
+    std::unordered_set<std::string> queued;
+    auto enqueue = [&](const std::string& symbol){
+        if(queued.insert(symbol).second){
+            order.push_back(symbol);
+        }
+    };
+
+    for(const std::string& symbol : heldSymbols()){
+        enqueue(symbol);
+    }
+
+    // Most recently requested first; requests older than the window get no priority
+    std::vector<std::pair<Clock::time_point, std::string>> recent;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point cutoff = Clock::now() - recentWindow;
+        for(auto iter = lastRequested.begin(); iter != lastRequested.end();){
+            if(iter->second < cutoff){
+                iter = lastRequested.erase(iter);
+            } else {
+                recent.emplace_back(iter->second, iter->first);
+                iter++;
+            }
+        }
+    }
+    std::sort(recent.begin(), recent.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+    for(const auto& entry : recent){
+        enqueue(entry.second);
+    }
+
+    prioritized = order.size();
+    for(const std::string& symbol : trackedSymbols()){
+        enqueue(symbol);
+    }
+    return order;
+}
+
+
+SweepStats SentimentRefresher::sweep(){
+    SweepStats stats;
+    std::vector<std::string> order = sweepOrder(stats.prioritized);
+    stats.symbols = order.size();
+
+    std::vector<double> latencies(order.size(), 0.0);
+    std::vector<char> failed(order.size(), 0);
+    std::vector<std::future<void>> pending;
+    pending.reserve(order.size());
+
+    Clock::time_point start = Clock::now();
+
+    // The pool size bounds how many fetches are in flight at once
+    for(size_t i = 0; i < order.size(); i++){
+        pending.push_back(pool.submit([this, &order, &latencies, &failed, i]{
+            Clock::time_point begin = Clock::now();
+            try{
+                cache.fetch(order[i]).get();
+            } catch (const std::exception& e){
+                failed[i] = 1;
+                std::cout << "[Updater] Error updating " << order[i] << ": " << e.what() << "\n";
+            }
+            latencies[i] = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        }));
+    }
+    for(size_t i = 0; i < pending.size(); i++){
+        try{
+            pending[i].get();
+        } catch (const std::future_error&){
+            failed[i] = 1;   // dropped by stop before it ran
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    stats.failures = static_cast<size_t>(std::count(failed.begin(), failed.end(), 1));
+    if(!latencies.empty()){
+        std::sort(latencies.begin(), latencies.end());
+        stats.medianMillis = latencies[latencies.size() / 2];
+        stats.maxMillis = latencies.back();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    last = stats;
+    return stats;
+}
+
+
+void SentimentRefresher::run(){
+    while(true){
+        Clock::time_point start = Clock::now();
+        SweepStats stats = sweep();
+        Clock::duration elapsed = Clock::now() - start;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if(stopping){
+            return;
+        }
+        if(elapsed > interval){
+            std::cout << "[Updater] Sweep of " << stats.symbols << " symbols took " << stats.seconds
+                      << "s, longer than the refresh interval\n";
+        } else if(wake.wait_for(lock, interval - elapsed, [this]{ return stopping; })){
+            return;
+        }
+    }
+}
+
+
+SweepStats SentimentRefresher::lastSweep() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return last;
+}
@@ -0,0 +1,79 @@
+#ifndef SENTIMENTREFRESHER_H
+#define SENTIMENTREFRESHER_H
+
+#include "sentimentcache.h"
+#include "threadpool.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+struct SweepStats {
+    size_t symbols = 0;
+    size_t prioritized = 0;     // held or recently requested, refreshed first
+    size_t failures = 0;
+    double seconds = 0.0;
+    double medianMillis = 0.0;
+    double maxMillis = 0.0;
+};
+
+
+// Periodically refreshes every tracked symbol through the SentimentCache on a bounded
+// ThreadPool. Symbols users hold, then symbols asked about recently, are queued first
+// so they are fresh even when a sweep runs long.
+class SentimentRefresher {
+
+    public:
+        using Clock = std::chrono::steady_clock;
+        using SymbolSource = std::function<std::vector<std::string>()>;
+
+    private:
+        SentimentCache& cache;
+        ThreadPool pool;
+        Clock::duration interval;
+        Clock::duration recentWindow = std::chrono::minutes(30);
+
+        SymbolSource trackedSymbols;
+        SymbolSource heldSymbols;
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Clock::time_point> lastRequested;
+        SweepStats last;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread thread;
+
+        std::vector<std::string> sweepOrder(size_t& prioritized);
+
+        // Sweeps until stop, sleeping out whatever is left of the interval after each pass
+        void run();
+
+    public:
+
+    SentimentRefresher(SentimentCache& cache, size_t concurrency, Clock::duration interval,
+                       SymbolSource trackedSymbols, SymbolSource heldSymbols);
+
+    // Stops first, so nothing the refresher runs outlives it
+    ~SentimentRefresher();
+
+    // Sweeps on a background thread until stop
+    void start();
+
+    // Drops the symbols a sweep still has queued, waits for the fetches already running and
+    // joins the background thread. Later sweeps refresh nothing.
+    void stop();
+
+    // Called when a user asks about a symbol so the next sweep refreshes it early
+    void markRequested(const std::string& symbol);
+
+    SweepStats sweep();
+
+    SweepStats lastSweep() const;
+};
+
+#endif // SENTIMENTREFRESHER_H
@@ -0,0 +1,348 @@
+#include "sentimentworker.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+
+namespace {
+    // Consecutive starts that die before answering anything, after which the worker is given up on
+    constexpr int MAX_FAILED_STARTS = 5;
+
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+#ifndef __linux__
+    void closeOnExec(int fd){
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+
+    // Requests go over a socket so that writing to a dead worker fails with EPIPE instead of
+    // raising SIGPIPE. Our ends are close-on-exec so other children (popen) don't inherit them.
+    bool openRequestChannel(int fds[2]){
+#ifdef __linux__
+        if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0){
+            return false;
+        }
+#else
+        if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0){
+            return false;
+        }
+        closeOnExec(fds[0]);
+        closeOnExec(fds[1]);
+#endif
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        return true;
+    }
+
+    bool openResponsePipe(int fds[2]){
+#ifdef __linux__
+        return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+        if(::pipe(fds) != 0){
+            return false;
+        }
+        closeOnExec(fds[0]);
+        closeOnExec(fds[1]);
+        return true;
+#endif
+    }
+
+    bool sendAll(int fd, const char* data, size_t length){
+        while(length > 0){
+            ssize_t written = ::send(fd, data, length, SEND_FLAGS);
+            if(written < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, size_t length){
+        while(length > 0){
+            ssize_t got = ::read(fd, data, length);
+            if(got < 0 && errno == EINTR){
+                continue;
+            }
+            if(got <= 0){
+                return false;
+            }
+            data += got;
+            length -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    // Frames are a 4-byte big-endian length followed by the payload
+    bool readFrame(int fd, std::string& payload){
+        unsigned char header[4];
+        if(!readAll(fd, reinterpret_cast<char*>(header), sizeof(header))){
+            return false;
+        }
+        uint32_t length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+                        | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+        payload.resize(length);
+        return length == 0 || readAll(fd, &payload[0], length);
+    }
+
+    std::string makeFrame(const std::string& payload){
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        std::string frame;
+        frame.reserve(4 + payload.size());
+        frame.push_back(static_cast<char>((length >> 24) & 0xFF));
+        frame.push_back(static_cast<char>((length >> 16) & 0xFF));
+        frame.push_back(static_cast<char>((length >> 8) & 0xFF));
+        frame.push_back(static_cast<char>(length & 0xFF));
+        frame += payload;
+        return frame;
+    }
+}
+
+
+SentimentWorker::SentimentWorker(const std::string& scriptPath, size_t concurrency)
+    : scriptPath(scriptPath), concurrency(concurrency)
+{
+    reader = std::thread(&SentimentWorker::readLoop, this);
+}
+
+SentimentWorker::~SentimentWorker(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if(toWorker >= 0){
+            ::close(toWorker);
+            toWorker = -1;
+        }
+        if(child > 0){
+            ::kill(child, SIGTERM);
+        }
+    }
+    ready.notify_all();
+    if(reader.joinable()){
+        reader.join();
+    }
+}
+
+
+void SentimentWorker::spawn(){
+    int requestChannel[2];
+    int responsePipe[2];
+    if(!openRequestChannel(requestChannel)){
+        throw std::runtime_error(std::string("socketpair() failed for sentiment worker: ") + std::strerror(errno));
+    }
+    if(!openResponsePipe(responsePipe)){
+        std::string error = std::strerror(errno);
+        ::close(requestChannel[0]);
+        ::close(requestChannel[1]);
+        throw std::runtime_error("pipe() failed for sentiment worker: " + error);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, requestChannel[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, responsePipe[1], STDOUT_FILENO);
+
+    // The server blocks SIGINT and SIGTERM for its sigwait; the worker must still die of them
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    std::string workers = std::to_string(concurrency);
+    char* const arguments[] = {const_cast<char*>("python3"), const_cast<char*>(scriptPath.c_str()),
+                               const_cast<char*>("--serve"), const_cast<char*>(workers.c_str()), nullptr};
+    pid_t pid = -1;
+    int error = ::posix_spawnp(&pid, "python3", &actions, &attributes, arguments, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    ::close(requestChannel[1]);
+    ::close(responsePipe[1]);
+    if(error != 0){
+        ::close(requestChannel[0]);
+        ::close(responsePipe[0]);
+        throw std::runtime_error(std::string("Could not start python3 for the sentiment worker: ") + std::strerror(error));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    child = pid;
+    toWorker = requestChannel[0];
+    fromWorker = responsePipe[0];
+    if(stopping){
+        // Shut down while we were spawning: let the reader drain to EOF and reap it
+        ::close(toWorker);
+        toWorker = -1;
+        ::kill(pid, SIGTERM);
+        return;
+    }
+    running = true;
+    ready.notify_all();
+}
+
+
+void SentimentWorker::failPending(const std::string& reason){
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& entry : pending){
+        entry.second.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
+    }
+    pending.clear();
+}
+
+
+void SentimentWorker::giveUp(const std::string& reason){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failure = reason;
+    }
+    ready.notify_all();
+    failPending(reason);
+}
+
+
+void SentimentWorker::readLoop(){
+    auto backoff = std::chrono::seconds(1);
+    int failedStarts = 0;
+
+    while(true){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(stopping){
+                break;
+            }
+        }
+
+        // Restarting can't bring back a script that isn't there
+        if(::access(scriptPath.c_str(), R_OK) != 0){
+            giveUp("Sentiment script " + scriptPath + " could not be read: " + std::strerror(errno));
+            break;
+        }
+
+        int fd = -1;
+        std::string exitReason = "Sentiment worker exited.";
+        try{
+            spawn();
+            std::lock_guard<std::mutex> lock(mutex);
+            fd = fromWorker;
+        } catch (const std::exception& e){
+            exitReason = e.what();
+        }
+
+        bool answered = false;
+        std::string payload;
+        while(fd >= 0 && readFrame(fd, payload)){
+            // "<requestID> ok|err <text>"
+            size_t firstSpace = payload.find(' ');
+            size_t secondSpace = payload.find(' ', firstSpace + 1);
+            if(firstSpace == std::string::npos || secondSpace == std::string::npos){
+                continue;
+            }
+            uint64_t requestID;
+            try{
+                requestID = std::stoull(payload.substr(0, firstSpace));
+            } catch (const std::exception&){
+                continue;
+            }
+            std::string status = payload.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+            std::string text = payload.substr(secondSpace + 1);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = pending.find(requestID);
+            if(found == pending.end()){
+                continue;
+            }
+            if(status == "ok"){
+                found->second.set_value(text);
+            } else {
+                found->second.set_exception(std::make_exception_ptr(std::runtime_error(text)));
+            }
+            pending.erase(found);
+            answered = true;
+            backoff = std::chrono::seconds(1);
+        }
+
+        // The worker exited (or never started): reap it and fail whatever it still owed us
+        pid_t exited = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+            if(toWorker >= 0){
+                ::close(toWorker);
+                toWorker = -1;
+            }
+            if(fromWorker >= 0){
+                ::close(fromWorker);
+                fromWorker = -1;
+            }
+            exited = child;
+            child = -1;
+        }
+        int status = 0;
+        if(exited > 0 && ::waitpid(exited, &status, 0) == exited && WIFEXITED(status)){
+            exitReason = "Sentiment worker exited with status " + std::to_string(WEXITSTATUS(status)) + ".";
+        }
+
+        failedStarts = answered ? 0 : failedStarts + 1;
+        if(failedStarts >= MAX_FAILED_STARTS){
+            giveUp(exitReason + " Gave up after " + std::to_string(failedStarts) + " failed starts.");
+            break;
+        }
+        failPending(exitReason);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(ready.wait_for(lock, backoff, [this]{ return stopping; })){
+                break;
+            }
+        }
+        backoff = std::min(backoff * 2, std::chrono::seconds(30));
+    }
+}
+
+
+std::future<std::string> SentimentWorker::request(const std::string& stockSymbol, bool useTwitter){
+    if(stockSymbol.empty() || stockSymbol.find_first_of(" \t\r\n") != std::string::npos){
+        throw std::runtime_error("Invalid stock symbol.");
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait_for(lock, std::chrono::seconds(30), [this]{ return running || stopping || !failure.empty(); });
+    if(!running){
+        throw std::runtime_error(failure.empty() ? "Sentiment worker is not running." : failure);
+    }
+
+    uint64_t requestID = nextRequestID++;
+    std::future<std::string> result = pending[requestID].get_future();
+
+    std::string frame = makeFrame(std::to_string(requestID) + " " + stockSymbol + " " + (useTwitter ? "1" : "0"));
+    if(!sendAll(toWorker, frame.data(), frame.size())){
+        pending.erase(requestID);
+        throw std::runtime_error("Failed to send request to sentiment worker.");
+    }
+    return result;
+}
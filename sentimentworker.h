@@ -0,0 +1,59 @@
+#ifndef SENTIMENTWORKER_H
+#define SENTIMENTWORKER_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+
+// Keeps one `python3 sentiment.py --serve` process alive so FinBERT is loaded once.
+// Requests are length-prefixed frames written to the worker's stdin and tagged with an
+// ID, so any number can be in flight; a reader thread matches responses back to their
+// futures. If the worker dies, pending requests fail and a new worker is started, unless the
+// script is missing or the worker keeps dying before it answers anything.
+class SentimentWorker {
+
+    private:
+        std::string scriptPath;
+        size_t concurrency;
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        pid_t child = -1;
+        int toWorker = -1;
+        int fromWorker = -1;
+        bool running = false;
+        bool stopping = false;
+        std::string failure;   // set once the worker has been given up on
+
+        uint64_t nextRequestID = 1;
+        std::unordered_map<uint64_t, std::promise<std::string>> pending;
+
+        std::thread reader;
+
+        void spawn();
+        void readLoop();
+        void failPending(const std::string& reason);
+        void giveUp(const std::string& reason);
+
+    public:
+
+    // concurrency is the size of the worker's own thread pool. The worker starts right away.
+    SentimentWorker(const std::string& scriptPath, size_t concurrency = 4);
+
+    ~SentimentWorker();
+
+    SentimentWorker(const SentimentWorker&) = delete;
+
+    SentimentWorker& operator=(const SentimentWorker&) = delete;
+
+    std::future<std::string> request(const std::string& stockSymbol, bool useTwitter);
+};
+
+#endif // SENTIMENTWORKER_H
@@ -0,0 +1,546 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+
+
+namespace {
+    const size_t REQUEST_LATENCY = Metrics::histogram("OrderServer::request");
+
+    constexpr size_t READ_CHUNK = 16 * 1024;
+    constexpr int EVENT_BATCH = 256;
+    constexpr size_t DRAIN_BATCH = 16;   // requests one connection runs before yielding its executor
+    constexpr size_t MAX_PENDING_FRAMES = 1024;   // requests queued per connection before reads pause
+    constexpr size_t MAX_UNSENT_BYTES = 1024 * 1024;   // responses queued per connection before reads pause
+    constexpr size_t MAX_UNPARSED_BYTES = 1024 * 1024;   // read per wakeup; the level-triggered poll brings the rest
+
+    // Also close-on-exec, so the sentiment worker and quote scripts don't inherit client sockets
+    void setNonBlocking(int fd){
+        int flags = fcntl(fd, F_GETFL, 0);
+        if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0){
+            throw std::runtime_error(std::string("fcntl: ") + std::strerror(errno));
+        }
+    }
+
+    // Orders are small and latency-bound; don't let Nagle hold them back
+    void tuneSocket(int fd){
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    std::string errorFrame(uint32_t requestID, const std::string& message){
+        PayloadWriter payload;
+        payload.str(message.substr(0, std::min<size_t>(UINT16_MAX, MAX_PAYLOAD_BYTES - sizeof(uint16_t))));
+        std::string frame;
+        appendFrame(frame, MessageType::Error, requestID, payload.bytes());
+        return frame;
+    }
+}
+
+
+OrderServer::OrderServer(Database& db, uint16_t port, size_t executorCount)
+    : db(db)
+{
+    if(executorCount == 0){
+        executorCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if(listenFd < 0){
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+       || listen(listenFd, SOMAXCONN) < 0){
+        std::string error = std::strerror(errno);
+        ::close(listenFd);
+        throw std::runtime_error("Could not listen on port " + std::to_string(port) + ": " + error);
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+    setNonBlocking(listenFd);
+
+    int wakePipe[2];
+    if(pipe(wakePipe) < 0){
+        ::close(listenFd);
+        throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+    }
+    wakeRead = wakePipe[0];
+    wakeWrite = wakePipe[1];
+    setNonBlocking(wakeRead);
+    setNonBlocking(wakeWrite);
+
+#ifdef __linux__
+    pollFd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    pollFd = kqueue();
+    if(pollFd >= 0){
+        fcntl(pollFd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if(pollFd < 0){
+        throw std::runtime_error(std::string("Could not create the event queue: ") + std::strerror(errno));
+    }
+    watch(listenFd, true, false, true);
+    watch(wakeRead, true, false, true);
+
+    executors = std::make_unique<ThreadPool>(executorCount);
+}
+
+
+OrderServer::~OrderServer(){
+    stop();
+    for(auto& entry : connections){
+        std::lock_guard<std::mutex> lock(entry.second->mutex);
+        entry.second->closed = true;
+        entry.second->pending.clear();
+    }
+    executors.reset();   // finishes requests already running; their responses are dropped
+    for(auto& entry : connections){
+        ::close(entry.first);
+    }
+    connections.clear();
+    ::close(listenFd);
+    ::close(wakeRead);
+    ::close(wakeWrite);
+    ::close(pollFd);
+}
+
+
+void OrderServer::start(){
+    loopThread = std::thread(&OrderServer::loop, this);
+}
+
+
+void OrderServer::stop(){
+    stopping = true;
+    wake();
+    if(loopThread.joinable()){
+        loopThread.join();
+    }
+}
+
+
+void OrderServer::watch(int fd, bool readable, bool writable, bool add){
+#ifdef __linux__
+    epoll_event event{};
+    event.events = 0;
+    if(readable){
+        event.events |= EPOLLIN;
+    }
+    if(writable){
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    if(epoll_ctl(pollFd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0){
+        throw std::runtime_error(std::string("epoll_ctl: ") + std::strerror(errno));
+    }
+#else
+    (void)add;
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | (readable ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | (writable ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    if(kevent(pollFd, changes, 2, nullptr, 0, nullptr) < 0){
+        throw std::runtime_error(std::string("kevent: ") + std::strerror(errno));
+    }
+#endif
+}
+
+
+void OrderServer::loop(){
+#ifdef __linux__
+    epoll_event events[EVENT_BATCH];
+#else
+    struct kevent events[EVENT_BATCH];
+#endif
+
+    while(!stopping){
+#ifdef __linux__
+        int ready = epoll_wait(pollFd, events, EVENT_BATCH, -1);
+#else
+        int ready = kevent(pollFd, nullptr, 0, events, EVENT_BATCH, nullptr);
+#endif
+        if(ready < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            std::cerr << "OrderServer: event wait failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+
+        for(int i = 0; i < ready; i++){
+#ifdef __linux__
+            int fd = events[i].data.fd;
+            bool readable = events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR);
+            bool writable = events[i].events & EPOLLOUT;
+#else
+            int fd = static_cast<int>(events[i].ident);
+            bool readable = events[i].filter == EVFILT_READ;
+            bool writable = events[i].filter == EVFILT_WRITE;
+#endif
+            if(fd == listenFd){
+                accept();
+                continue;
+            }
+            if(fd == wakeRead){
+                char buffer[256];
+                while(read(wakeRead, buffer, sizeof(buffer)) > 0){}
+                flushDirty();
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if(found == connections.end()){
+                continue;
+            }
+            std::shared_ptr<Connection> connection = found->second;
+            if(readable){
+                readFrom(connection);
+            }
+            if(writable){
+                writeTo(connection);
+            }
+        }
+    }
+}
+
+
+void OrderServer::accept(){
+    while(true){
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if(fd < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                std::cerr << "OrderServer: accept failed: " << std::strerror(errno) << "\n";
+            }
+            return;
+        }
+        setNonBlocking(fd);
+        tuneSocket(fd);
+
+        auto connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        connections[fd] = connection;
+        watch(fd, true, false, true);
+        liveConnections++;
+    }
+}
+
+
+void OrderServer::readFrom(const std::shared_ptr<Connection>& connection){
+    char buffer[READ_CHUNK];
+    while(true){
+        if(connection->in.size() - connection->inOffset >= MAX_UNPARSED_BYTES){
+            break;
+        }
+        ssize_t count = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if(count > 0){
+            connection->in.append(buffer, count);
+            continue;
+        }
+        if(count < 0 && errno == EINTR){
+            continue;
+        }
+        if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        close(connection);   // orderly shutdown or reset
+        return;
+    }
+
+    std::vector<Frame> frames;
+    try{
+        Frame frame;
+        while(takeFrame(connection->in, connection->inOffset, frame)){
+            frames.push_back(std::move(frame));
+        }
+    } catch (const std::exception&){
+        close(connection);   // a bad length means the stream can't be resynchronised
+        return;
+    }
+    if(connection->inOffset == connection->in.size()){
+        connection->in.clear();
+        connection->inOffset = 0;
+    } else if(connection->inOffset >= READ_CHUNK){
+        connection->in.erase(0, connection->inOffset);
+        connection->inOffset = 0;
+    }
+    if(frames.empty()){
+        return;
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        for(Frame& frame : frames){
+            connection->pending.push_back(std::move(frame));
+        }
+        if(!connection->running){
+            connection->running = true;
+            schedule = true;
+        }
+        throttle(*connection);
+    }
+    if(schedule){
+        executors->submit([this, connection]{ drain(connection); });
+    }
+}
+
+
+void OrderServer::writeTo(const std::shared_ptr<Connection>& connection){
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if(connection->closed){
+            return;
+        }
+        while(connection->outOffset < connection->out.size()){
+            ssize_t count = send(connection->fd, connection->out.data() + connection->outOffset,
+                                 connection->out.size() - connection->outOffset, SEND_FLAGS);
+            if(count >= 0){
+                connection->outOffset += count;
+            } else if(errno == EINTR){
+                continue;
+            } else if(errno == EAGAIN || errno == EWOULDBLOCK){
+                break;
+            } else {
+                failed = true;
+                break;
+            }
+        }
+        if(!failed){
+            if(connection->outOffset == connection->out.size()){
+                connection->out.clear();
+                connection->outOffset = 0;
+            }
+            // Only ask for writability while the socket buffer is full, or every loop would spin on it
+            bool backlog = !connection->out.empty();
+            if(backlog != connection->writeArmed){
+                connection->writeArmed = backlog;
+                watch(connection->fd, !connection->readPaused, backlog, false);
+            }
+            throttle(*connection);
+        }
+    }
+    if(failed){
+        close(connection);
+    }
+}
+
+
+void OrderServer::throttle(Connection& connection){
+    size_t unsent = connection.out.size() - connection.outOffset;
+    bool pause = connection.readPaused
+        ? connection.pending.size() > MAX_PENDING_FRAMES / 2 || unsent > MAX_UNSENT_BYTES / 2
+        : connection.pending.size() >= MAX_PENDING_FRAMES || unsent >= MAX_UNSENT_BYTES;
+    // Every response lands in `out`, which brings the I/O thread back to writeTo, so a paused
+    // connection is always looked at again as its queues drain
+    if(pause != connection.readPaused){
+        connection.readPaused = pause;
+        watch(connection.fd, !pause, connection.writeArmed, false);
+    }
+}
+
+
+void OrderServer::close(const std::shared_ptr<Connection>& connection){
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if(connection->closed){
+            return;
+        }
+        connection->closed = true;
+        connection->pending.clear();
+        connection->out.clear();
+        connection->outOffset = 0;
+    }
+    // Closing the descriptor also removes it from the event queue
+    connections.erase(connection->fd);
+    ::close(connection->fd);
+    liveConnections--;
+}
+
+
+void OrderServer::flushDirty(){
+    std::vector<std::shared_ptr<Connection>> ready;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        ready.swap(dirty);
+    }
+    for(const auto& connection : ready){
+        writeTo(connection);
+    }
+}
+
+
+void OrderServer::wake(){
+    char signal = 1;
+    // A full pipe already guarantees a wakeup, so EAGAIN is fine to ignore
+    ssize_t written = write(wakeWrite, &signal, 1);
+    (void)written;
+}
+
+
+void OrderServer::drain(std::shared_ptr<Connection> connection){
+    for(size_t handled = 0; ; handled++){
+        Frame request;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if(connection->pending.empty() || connection->closed){
+                connection->running = false;
+                return;
+            }
+            // A pipelining client refills its queue as fast as it is answered; go to the back
+            // of the executor queue so it cannot hold a thread while other connections wait
+            if(handled == DRAIN_BATCH){
+                executors->submit([this, connection]{ drain(connection); });
+                return;
+            }
+            request = std::move(connection->pending.front());
+            connection->pending.pop_front();
+        }
+
+        std::string response;
+        {
+            LatencyTimer timer(REQUEST_LATENCY);
+            response = handle(*connection, request);
+        }
+        requestCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Only the append that finds the buffer empty has to wake the I/O thread; anything
+        // appended after it is picked up by the same write or by the armed write event
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if(connection->closed){
+                continue;
+            }
+            wasEmpty = connection->out.empty();
+            connection->out += response;
+        }
+        if(wasEmpty){
+            bool first;
+            {
+                std::lock_guard<std::mutex> lock(dirtyMutex);
+                first = dirty.empty();
+                dirty.push_back(connection);
+            }
+            if(first){
+                wake();
+            }
+        }
+    }
+}
+
+
+std::string OrderServer::handle(Connection& connection, const Frame& request){
+    PayloadWriter reply;
+    try{
+        PayloadReader fields(request.payload);
+
+        if(request.type == MessageType::Register || request.type == MessageType::Login){
+            std::string username = fields.str();
+            std::string password = fields.str();
+            if(request.type == MessageType::Register){
+                db.createUser(username, password);
+            }
+            std::string token = db.startSession(username, password);
+            connection.userID = db.sessionUser(token);
+            reply.i32(connection.userID).str(token);
+        } else if(request.type == MessageType::Resume){
+            connection.userID = db.sessionUser(fields.str());
+            reply.i32(connection.userID);
+        } else {
+            if(connection.userID < 0){
+                throw std::runtime_error("Not logged in.");
+            }
+            int userID = connection.userID;
+
+            switch(request.type){
+                case MessageType::Buy: {
+                    std::string symbol = fields.str();
+                    db.buyStock(userID, symbol, fields.i32());
+                    break;
+                }
+                case MessageType::Sell: {
+                    std::string symbol = fields.str();
+                    db.sellStock(userID, symbol, fields.i32());
+                    break;
+                }
+                case MessageType::LimitOrder: {
+                    Side side = (fields.u8() == 0) ? Side::Buy : Side::Sell;
+                    std::string symbol = fields.str();
+                    int quantity = fields.i32();
+                    double limitPrice = fields.f64();
+                    reply.u64(db.placeLimitOrder(userID, symbol, side, quantity, limitPrice));
+                    break;
+                }
+                case MessageType::Cancel:
+                    db.cancelOrder(userID, fields.u64());
+                    break;
+                case MessageType::Balance:
+                    reply.f64(db.getBalance(userID));
+                    break;
+                case MessageType::Portfolio: {
+                    std::vector<Holding> held = db.holdings(userID);
+                    // Send as many holdings as one frame carries; the count says how many that was
+                    size_t count = 0;
+                    size_t bytes = sizeof(uint16_t);
+                    for(; count < held.size() && count < UINT16_MAX; count++){
+                        size_t line = sizeof(uint16_t) + held[count].symbol.size() + sizeof(int32_t) + sizeof(double);
+                        if(bytes + line > MAX_PAYLOAD_BYTES){
+                            break;
+                        }
+                        bytes += line;
+                    }
+                    reply.u16(static_cast<uint16_t>(count));
+                    for(size_t i = 0; i < count; i++){
+                        reply.str(held[i].symbol).i32(held[i].quantity).f64(held[i].price);
+                    }
+                    break;
+                }
+                case MessageType::Deposit:
+                    db.depositMoney(userID, fields.f64());
+                    break;
+                default:
+                    throw std::runtime_error("Unknown request type.");
+            }
+        }
+    } catch (const std::exception& e){
+        return errorFrame(request.requestID, e.what());
+    }
+
+    std::string frame;
+    appendFrame(frame, MessageType::Ok, request.requestID, reply.bytes());
+    return frame;
+}
@@ -0,0 +1,107 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "database.h"
+#include "protocol.h"
+#include "threadpool.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// Order-entry front end speaking the protocol.h wire format over TCP.
+// One I/O thread multiplexes every socket (epoll on Linux, kqueue on macOS) and never touches
+// the database; complete frames are handed to a small executor pool. Each connection runs at
+// most one request at a time, so a client's pipelined orders execute and are answered in order
+// while different connections run in parallel; a connection yields its executor after a short
+// batch so a client that keeps its pipeline full cannot starve the others. Responses are queued on the connection and the
+// I/O thread is woken through a pipe to write them. A client that sends faster than it is served,
+// or does not read its responses, has its socket taken out of the read set until it catches up.
+class OrderServer {
+
+    private:
+        struct Connection {
+            int fd;
+            std::mutex mutex;
+            std::string in;                 // I/O thread only
+            size_t inOffset = 0;
+            std::string out;                // appended by executors, drained by the I/O thread
+            size_t outOffset = 0;
+            bool writeArmed = false;        // I/O thread only
+            bool readPaused = false;        // I/O thread only; set while either queue is over its cap
+            std::deque<Frame> pending;
+            bool running = false;           // an executor is draining `pending`
+            bool closed = false;
+            int userID = -1;                // set by Login/Register, read by the executor that owns the connection
+        };
+
+        Database& db;
+        int listenFd = -1;
+        int pollFd = -1;
+        int wakeRead = -1;
+        int wakeWrite = -1;
+        uint16_t boundPort = 0;
+        std::unique_ptr<ThreadPool> executors;
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;   // I/O thread only
+        std::mutex dirtyMutex;
+        std::vector<std::shared_ptr<Connection>> dirty;   // connections with responses to write
+        std::atomic<bool> stopping{false};
+        std::atomic<uint64_t> requestCount{0};
+        std::atomic<size_t> liveConnections{0};
+        std::thread loopThread;
+
+        void loop();
+
+        void watch(int fd, bool readable, bool writable, bool add);
+
+        // Stops reading a connection whose requests or responses have piled up past their caps
+        // and starts again once both are down to half; caller holds the connection's mutex
+        void throttle(Connection& connection);
+
+        void accept();
+
+        void readFrom(const std::shared_ptr<Connection>& connection);
+
+        void writeTo(const std::shared_ptr<Connection>& connection);
+
+        void close(const std::shared_ptr<Connection>& connection);
+
+        void flushDirty();
+
+        void drain(std::shared_ptr<Connection> connection);
+
+        // Runs one request and returns the encoded response frame
+        std::string handle(Connection& connection, const Frame& request);
+
+        void wake();
+
+    public:
+
+    // port 0 picks a free port (see port()); executors 0 uses every hardware thread
+    OrderServer(Database& db, uint16_t port, size_t executors);
+
+    // Stops accepting, closes every connection and finishes the requests already running
+    ~OrderServer();
+
+    OrderServer(const OrderServer&) = delete;
+
+    OrderServer& operator=(const OrderServer&) = delete;
+
+    void start();
+
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+
+    size_t connectionCount() const { return liveConnections.load(std::memory_order_relaxed); }
+
+    uint64_t requestsServed() const { return requestCount.load(std::memory_order_relaxed); }
+};
+
+#endif // SERVER_H
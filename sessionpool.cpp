@@ -0,0 +1,212 @@
+#include "sessionpool.h"
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+    struct HeldSession {
+        const SessionPool* pool;
+        mysqlx::Session* session;
+        bool broken;
+    };
+
+    // Sessions currently checked out by this thread, one entry per pool
+    thread_local std::vector<HeldSession> heldSessions;
+
+    HeldSession* heldBy(const SessionPool* pool){
+        for(auto& entry : heldSessions){
+            if(entry.pool == pool){
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns whether the session was marked broken while it was held
+    bool releaseHeld(const SessionPool* pool){
+        bool broken = false;
+        heldSessions.erase(std::remove_if(heldSessions.begin(), heldSessions.end(),
+            [pool, &broken](const HeldSession& entry){
+                if(entry.pool != pool){
+                    return false;
+                }
+                broken = entry.broken;
+                return true;
+            }),
+            heldSessions.end());
+        return broken;
+    }
+}
+
+
+SessionPool::SessionPool(const std::string& url, const std::string& schemaName, size_t maxSize)
+    : url(url), schemaName(schemaName), maxSize(std::max<size_t>(maxSize, 1))
+{
+    idle.reserve(this->maxSize);
+}
+
+SessionPool::~SessionPool(){
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& session : idle){
+        session->close();
+    }
+    idle.clear();
+}
+
+
+std::unique_ptr<mysqlx::Session> SessionPool::checkout(){
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this]{ return !idle.empty() || created < maxSize; });
+
+    if(!idle.empty()){
+        std::unique_ptr<mysqlx::Session> session = std::move(idle.back());
+        idle.pop_back();
+        return session;
+    }
+
+    // Open the new connection outside the lock; the slot is reserved by bumping created
+    created++;
+    lock.unlock();
+    try{
+        auto session = std::make_unique<mysqlx::Session>(url);
+        session->sql("USE " + schemaName).execute();
+        return session;
+    } catch (...){
+        lock.lock();
+        created--;
+        available.notify_one();
+        throw;
+    }
+}
+
+void SessionPool::checkin(std::unique_ptr<mysqlx::Session> session){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(session));
+    }
+    available.notify_one();
+}
+
+// The connection may be dead or mid-transaction; close it and let checkout open a replacement
+void SessionPool::discard(std::unique_ptr<mysqlx::Session> session){
+    try{
+        session->close();
+    } catch (const std::exception&){
+    }
+    session.reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        created--;
+    }
+    available.notify_one();
+}
+
+
+size_t& SessionPool::threadRoundTrips(){
+    thread_local size_t roundTrips = 0;
+    return roundTrips;
+}
+
+
+size_t SessionPool::statementHistogram(){
+    static const size_t histogram = Metrics::histogram("mysqlx statement");
+    return histogram;
+}
+
+
+void SessionPool::countRow(const mysqlx::Row& row){
+    uint64_t bytes = 0;
+    for(size_t column = 0; column < row.colCount(); column++){
+        const mysqlx::Value& value = row.get(column);
+        if(value.getType() == mysqlx::Value::STRING){
+            bytes += value.get<std::string>().size();
+        } else if(value.getType() != mysqlx::Value::VNULL){
+            bytes += 8;
+        }
+    }
+    Metrics::add(Metrics::RowsFetched);
+    Metrics::add(Metrics::BytesReturned, bytes);
+}
+
+
+SessionPool::Handle SessionPool::acquire(){
+    if(HeldSession* held = heldBy(this)){
+        return Handle(this, nullptr, held->session);
+    }
+    std::unique_ptr<mysqlx::Session> session = checkout();
+    mysqlx::Session* raw = session.get();
+    threadRoundTrips() = 0;
+    heldSessions.push_back({this, raw, false});
+    return Handle(this, std::move(session), raw);
+}
+
+
+
+SessionPool::Handle::Handle(SessionPool* pool, std::unique_ptr<mysqlx::Session> owned, mysqlx::Session* session)
+    : pool(pool), owned(std::move(owned)), session(session)
+{
+}
+
+SessionPool::Handle::Handle(Handle&& other) noexcept
+    : pool(other.pool), owned(std::move(other.owned)), session(other.session)
+{
+    other.pool = nullptr;
+    other.session = nullptr;
+}
+
+SessionPool::Handle::~Handle(){
+    if(owned){
+        if(releaseHeld(pool)){
+            pool->discard(std::move(owned));
+        } else {
+            pool->checkin(std::move(owned));
+        }
+    }
+}
+
+// Nested handles share the thread's entry, so the outermost one sees the mark when it returns the session
+void SessionPool::Handle::markBroken() const{
+    if(HeldSession* held = heldBy(pool)){
+        held->broken = true;
+    }
+}
+
+mysqlx::Table SessionPool::Handle::table(const std::string& name) const{
+    return session->getSchema(pool->schema()).getTable(name);
+}
+
+void SessionPool::Handle::startTransaction() const{
+    threadRoundTrips()++;
+    Metrics::add(Metrics::Statements);
+    LatencyTimer timer(statementHistogram());
+    try{
+        session->startTransaction();
+    } catch (const mysqlx::Error&){
+        markBroken();
+        throw;
+    }
+}
+
+void SessionPool::Handle::commit() const{
+    threadRoundTrips()++;
+    Metrics::add(Metrics::Statements);
+    LatencyTimer timer(statementHistogram());
+    try{
+        session->commit();
+    } catch (const mysqlx::Error&){
+        markBroken();
+        throw;
+    }
+}
+
+void SessionPool::Handle::rollback() const{
+    threadRoundTrips()++;
+    Metrics::add(Metrics::Statements);
+    LatencyTimer timer(statementHistogram());
+    try{
+        session->rollback();
+    } catch (const mysqlx::Error&){
+        markBroken();
+        throw;
+    }
+}
@@ -0,0 +1,139 @@
+#include <xdevapi.h>
+#include "metrics.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+#ifndef SESSIONPOOL_H
+#define SESSIONPOOL_H
+
+
+// Bounded pool of X DevAPI sessions.
+// acquire() blocks once maxSize sessions are checked out. A thread that already
+// holds a session from this pool gets that same session back, so nested calls
+// (buyStock -> withdrawMoney) share one connection and can never deadlock the pool.
+// A session that threw a mysqlx::Error is closed instead of going back to idle, and its
+// slot is freed for a fresh connection.
+class SessionPool {
+
+    private:
+        std::string url;
+        std::string schemaName;
+        size_t maxSize;
+        size_t created = 0;
+
+        std::mutex mutex;
+        std::condition_variable available;
+        std::vector<std::unique_ptr<mysqlx::Session>> idle;
+
+        std::unique_ptr<mysqlx::Session> checkout();
+        void checkin(std::unique_ptr<mysqlx::Session> session);
+        void discard(std::unique_ptr<mysqlx::Session> session);
+
+    public:
+
+    class Handle {
+        private:
+            SessionPool* pool = nullptr;
+            std::unique_ptr<mysqlx::Session> owned;
+            mysqlx::Session* session = nullptr;
+
+            void markBroken() const;
+
+        public:
+
+        Handle(SessionPool* pool, std::unique_ptr<mysqlx::Session> owned, mysqlx::Session* session);
+
+        Handle(Handle&& other) noexcept;
+
+        Handle& operator=(Handle&&) = delete;
+
+        Handle(const Handle&) = delete;
+
+        ~Handle();
+
+        mysqlx::Session& operator*() const { return *session; }
+
+        mysqlx::Session* operator->() const { return session; }
+
+        mysqlx::Table table(const std::string& name) const;
+
+        // Every statement goes through execute() so it is counted as a round trip and timed
+        template <typename Statement>
+        auto execute(Statement&& statement) const -> decltype(statement.execute()) {
+            threadRoundTrips()++;
+            Metrics::add(Metrics::Statements);
+            LatencyTimer timer(statementHistogram());
+            try{
+                return statement.execute();
+            } catch (const mysqlx::Error&){
+                markBroken();
+                throw;
+            }
+        }
+
+        // Rows are fetched through the handle so rows and bytes returned are counted
+        template <typename Result>
+        std::vector<mysqlx::Row> fetchAll(Result&& result) const {
+            std::vector<mysqlx::Row> rows;
+            try{
+                std::vector<mysqlx::Row> fetched = result.fetchAll();
+                rows.swap(fetched);
+            } catch (const mysqlx::Error&){
+                markBroken();
+                throw;
+            }
+            for(const mysqlx::Row& row : rows){
+                countRow(row);
+            }
+            return rows;
+        }
+
+        template <typename Result>
+        mysqlx::Row fetchOne(Result&& result) const {
+            mysqlx::Row row;
+            try{
+                row = result.fetchOne();
+            } catch (const mysqlx::Error&){
+                markBroken();
+                throw;
+            }
+            if(!row.isNull()){
+                countRow(row);
+            }
+            return row;
+        }
+
+        void startTransaction() const;
+
+        void commit() const;
+
+        void rollback() const;
+
+        // True for the outermost handle on this thread, i.e. the one that returns the session
+        bool ownsSession() const { return owned != nullptr; }
+    };
+
+    SessionPool(const std::string& url, const std::string& schemaName, size_t maxSize);
+
+    ~SessionPool();
+
+    Handle acquire();
+
+    const std::string& schema() const { return schemaName; }
+
+    // Latency of every statement executed through any handle
+    static size_t statementHistogram();
+
+    // Counts one fetched row and its decoded size (strings by length, other values as 8 bytes)
+    static void countRow(const mysqlx::Row& row);
+
+    // Round trips issued by the calling thread since its outermost handle was acquired,
+    // i.e. the cost of the current (or most recently finished) Database call
+    static size_t& threadRoundTrips();
+};
+
+#endif // SESSIONPOOL_H
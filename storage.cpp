@@ -0,0 +1,63 @@
+#include "storage.h"
+#include <cerrno>
+#include <stdexcept>
+#include <vector>
+#ifdef __linux__
+#include <sys/random.h>
+#else
+#include <stdlib.h>
+#endif
+
+
+std::string randomHex(size_t bytes){
+    std::vector<unsigned char> random(bytes);
+#ifdef __linux__
+    size_t filled = 0;
+    while(filled < bytes){
+        ssize_t got = ::getrandom(random.data() + filled, bytes - filled, 0);
+        if(got < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            throw std::runtime_error("Could not read the system random source.");
+        }
+        filled += static_cast<size_t>(got);
+    }
+#else
+    ::arc4random_buf(random.data(), bytes);
+#endif
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes * 2);
+    for(unsigned char byte : random){
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0F];
+    }
+    return hex;
+}
+
+
+TransactionCursor::TransactionCursor(Storage& storage, int userID, TransactionFilter filter, size_t pageSize)
+    : storage(storage), userID(userID), filter(std::move(filter)), pageSize(pageSize ? pageSize : 1)
+{
+}
+
+
+bool TransactionCursor::next(TransactionRecord& record){
+    if(position == page.size()){
+        if(exhausted){
+            return false;
+        }
+        page = storage.transactionPage(userID, filter, last, pageSize);
+        position = 0;
+        // A short page means the read reached the end; skip the empty round trip
+        exhausted = page.size() < pageSize;
+        if(page.empty()){
+            return false;
+        }
+        last.date = page.back().date;
+        last.transactionID = page.back().transactionID;
+    }
+    record = std::move(page[position++]);
+    return true;
+}
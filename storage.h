@@ -0,0 +1,185 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "journal.h"
+#include "orderbook.h"
+#include "positions.h"
+#include "quotefeed.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Status codes returned by Storage::trade and adjustBalance (and by the TradeBuy / TradeSell
+// stored procedures behind the MySQL backend)
+constexpr int TRADE_OK = 0;
+constexpr int TRADE_USER_NOT_FOUND = 1;
+constexpr int TRADE_INSUFFICIENT = 3;
+constexpr int TRADE_STALE = 4;   // the account changed since the version the caller passed
+
+
+// A user's balance and the Users.Version it was read at; every write of the balance bumps the version
+struct AccountVersion {
+    double balance = 0.0;
+    uint64_t version = 0;
+};
+
+
+// One Transactions row
+struct TransactionRecord {
+    int userID = 0;
+    std::string symbol;
+    Side side = Side::Buy;
+    int quantity = 0;
+    double price = 0.0;
+    std::string date;   // stamped by the backend when the row is written
+    int64_t transactionID = 0;   // breaks ties between rows with the same date; set on reads
+};
+
+// Narrows a history read; empty fields match everything. Dates are "YYYY-MM-DD HH:MM:SS" and
+// compare as text, so a bare "YYYY-MM-DD" means midnight at the start of that day.
+struct TransactionFilter {
+    std::string symbol;
+    std::string fromDate;   // inclusive
+    std::string toDate;     // exclusive
+};
+
+// Where a history read stopped: the (Date, TransactionID) of the last row returned
+struct TransactionKey {
+    std::string date;   // empty: before the first row
+    int64_t transactionID = 0;
+};
+
+// One user's balance and positions as locked by Storage::transact.
+// positions holds the requested symbols the user has a row for; missing ones read as empty.
+struct AccountState {
+    double balance = 0.0;
+    std::unordered_map<std::string, Position> positions;
+};
+
+// Edits the locked accounts in place and appends the Transactions rows that go with the edits.
+// Returning false (or throwing) leaves storage untouched.
+using AccountUpdate = std::function<bool(std::unordered_map<int, AccountState>& accounts,
+                                         std::vector<TransactionRecord>& trades)>;
+
+
+// Held by Database for the length of one public call; see Storage::beginCall
+class StorageCall {
+    public:
+    virtual ~StorageCall() = default;
+};
+
+
+// Everything Database persists: users and balances, positions, the transaction history,
+// the Stocks listing and the journal checkpoint. Database keeps the in-memory caches,
+// the matching engine and the journal on top, so a backend only stores and checks rows.
+class Storage {
+    public:
+    virtual ~Storage() = default;
+
+    // Pins whatever the backend needs for a multi-statement call (a pooled MySQL session)
+    // to the calling thread until the returned object is destroyed. May return nullptr.
+    virtual std::unique_ptr<StorageCall> beginCall() = 0;
+
+    // Round trips issued by this thread's current or most recent call; 0 in process
+    virtual size_t roundTrips() const = 0;
+
+    // Throws if the username is taken; returns the new UserID
+    virtual int createUser(const std::string& username, const std::string& password) = 0;
+
+    // -1 when no user matches; otherwise the UserID, with `account` filled in from the same read
+    virtual int findUser(const std::string& username, const std::string& password, AccountVersion& account) = 0;
+
+    // False if the user does not exist
+    virtual bool account(int userID, AccountVersion& account) = 0;
+
+    // The versioned writes below apply only if the user is still at account.version, and
+    // return a TRADE_* status. Unless the user is missing, `account` comes back holding the
+    // stored state after the call, so a TRADE_STALE caller can re-check and retry at once.
+
+    // Adds delta unless the balance would go negative
+    virtual int adjustBalance(int userID, double delta, AccountVersion& account) = 0;
+
+    // Checks funds or shares at `price` and writes the balance, the Transactions row and the
+    // position together
+    virtual int trade(int userID, const std::string& symbol, Side side, int quantity, double price,
+                      AccountVersion& account) = 0;
+
+    // Locks every listed user and their rows for `symbols`, lets `update` change them, then
+    // writes what changed atomically, bumping the version of every balance it writes. Throws if a user does not exist; returns what update returned.
+    virtual bool transact(const std::vector<int>& userIDs, const std::vector<std::string>& symbols,
+                          const AccountUpdate& update) = 0;
+
+    // Positions with a non-zero quantity
+    virtual std::unordered_map<std::string, Position> positions(int userID) = 0;
+
+    // Overwrites every position row of the user
+    virtual void replacePositions(int userID, const std::unordered_map<std::string, Position>& positions) = 0;
+
+    // Up to `limit` rows matching `filter` that sort after `after` by (Date, TransactionID),
+    // oldest first. Each call is one bounded read, whatever the length of the history.
+    virtual std::vector<TransactionRecord> transactionPage(int userID, const TransactionFilter& filter,
+                                                           const TransactionKey& after, size_t limit) = 0;
+
+    // Users with history but no Positions rows yet (a database from before Positions existed)
+    virtual std::vector<int> tradersMissingPositions() = 0;
+
+    // Inserts or reprices each quote; an empty company name keeps the stored one
+    virtual void upsertQuotes(const std::vector<const Quote*>& quotes) = 0;
+
+    // Every listed symbol that has a price
+    virtual std::vector<std::pair<std::string, double>> stockPrices() = 0;
+
+    virtual bool stockPrice(const std::string& symbol, double& price) = 0;
+
+    virtual std::vector<std::string> stockSymbols() = 0;
+
+    // Random identity created with the store and kept with it, so a journal can tell which
+    // store its records were written against
+    virtual std::string storeID() = 0;
+
+    // Last journal sequence applied
+    virtual uint64_t journalCheckpoint() = 0;
+
+    // Applies a batch of journal records and moves the checkpoint to the last one, atomically
+    virtual void applyJournal(const std::vector<JournalRecord>& records) = 0;
+};
+
+
+// Walks one user's history oldest first, holding a single page in memory. Each page is read
+// by position (keyset) rather than by offset, so late pages cost the same as the first and
+// rows written while the cursor is open either show up once or not at all.
+class TransactionCursor {
+
+    private:
+        Storage& storage;
+        int userID;
+        TransactionFilter filter;
+        size_t pageSize;
+        TransactionKey last;
+        std::vector<TransactionRecord> page;
+        size_t position = 0;
+        bool exhausted = false;
+
+    public:
+
+    TransactionCursor(Storage& storage, int userID, TransactionFilter filter, size_t pageSize);
+
+    // False once the history is exhausted
+    bool next(TransactionRecord& record);
+};
+
+
+// `bytes` bytes from the operating system's random source, as lowercase hex
+std::string randomHex(size_t bytes);
+
+
+// "embedded://<directory>" opens the in-process store kept in that directory;
+// anything else is a MySQL X Protocol URL served through a pool of poolSize sessions
+std::unique_ptr<Storage> openStorage(const std::string& url, size_t poolSize);
+
+#endif // STORAGE_H
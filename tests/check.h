@@ -0,0 +1,91 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+// Just enough harness for the ctest targets: each test is a function, a failed CHECK reports
+// its line and ends that test, and main returns non-zero if any test failed.
+
+struct CheckFailed : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+#define CHECK(condition) \
+    do{ \
+        if(!(condition)){ \
+            throw CheckFailed(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition); \
+        } \
+    } while(0)
+
+#define CHECK_NEAR(actual, expected) CHECK(std::fabs((actual) - (expected)) < 1e-9)
+
+#define CHECK_THROWS(statement) \
+    do{ \
+        bool thrown = false; \
+        try{ statement; } catch (const std::exception&){ thrown = true; } \
+        CHECK(thrown && "expected an exception from " #statement); \
+    } while(0)
+
+
+inline int runTests(const std::vector<std::pair<const char*, std::function<void()>>>& tests){
+    int failed = 0;
+    for(const auto& test : tests){
+        try{
+            test.second();
+            std::cout << "ok      " << test.first << "\n";
+        } catch (const std::exception& e){
+            std::cout << "FAILED  " << test.first << ": " << e.what() << "\n";
+            failed++;
+        }
+    }
+    std::cout << (tests.size() - failed) << " of " << tests.size() << " passed\n";
+    return failed == 0 ? 0 : 1;
+}
+
+
+// A fresh empty directory under TMPDIR for one test's files
+inline std::string scratchDirectory(const std::string& name){
+    const char* temp = std::getenv("TMPDIR");
+    std::string pattern = std::string((temp && *temp) ? temp : "/tmp") + "/" + name + "-XXXXXX";
+    if(!::mkdtemp(&pattern[0])){
+        throw std::runtime_error("Could not create a scratch directory.");
+    }
+    return pattern;
+}
+
+
+// Runs `body` in a child process that then exits without unwinding, so nothing it opened gets
+// a clean shutdown and its file locks go with it, as in a crash. Fails if a CHECK in the
+// child did.
+inline void crashAfter(const std::function<void()>& body){
+    std::cout.flush();
+    pid_t child = ::fork();
+    if(child < 0){
+        throw std::runtime_error("Could not fork a child process.");
+    }
+    if(child == 0){
+        int status = 0;
+        try{
+            body();
+        } catch (const std::exception& e){
+            std::cout << "        in the child: " << e.what() << std::endl;
+            status = 1;
+        }
+        ::_exit(status);
+    }
+    int status = 0;
+    CHECK(::waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,160 @@
+#include "check.h"
+#include "../embeddedstorage.h"
+#include <fstream>
+#include <iterator>
+
+// Replay of the embedded store's log: across compactions that start new generations, after a
+// crash that skipped the shutdown snapshot, with a torn tail, and with a log left over from a
+// generation the snapshot already covers. Also the directory lock that keeps a second process out.
+
+
+namespace {
+    std::string readFile(const std::string& path){
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::string& contents){
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << contents;
+    }
+
+    // Takes a holding of `held` shares to `upTo`, one share at a time; share n costs n, so the
+    // total spent on `shares` shares is 1 + 2 + ... + shares
+    void buyShares(Storage& storage, int userID, int held, int upTo){
+        for(int share = held + 1; share <= upTo; share++){
+            AccountVersion account;
+            CHECK(storage.account(userID, account));
+            CHECK(storage.trade(userID, "SYM", Side::Buy, 1, share, account) == TRADE_OK);
+        }
+    }
+
+    size_t historyRows(Storage& storage, int userID){
+        TransactionCursor cursor(storage, userID, TransactionFilter(), 7);
+        TransactionRecord record;
+        size_t rows = 0;
+        while(cursor.next(record)){
+            rows++;
+        }
+        return rows;
+    }
+
+    // Balance, position and history as the caller expects them after `shares` buys from 10000
+    void checkState(Storage& storage, int userID, int shares){
+        double spent = shares * (shares + 1) / 2.0;
+        AccountVersion account;
+        CHECK(storage.account(userID, account));
+        CHECK_NEAR(account.balance, 10000.0 - spent);
+        std::unordered_map<std::string, Position> held = storage.positions(userID);
+        CHECK(held["SYM"].quantity == shares);
+        CHECK_NEAR(held["SYM"].costBasis, spent);
+        CHECK(historyRows(storage, userID) == static_cast<size_t>(shares));
+    }
+
+    int fundedUser(Storage& storage){
+        int userID = storage.createUser("trader", "pw");
+        AccountVersion account;
+        CHECK(storage.account(userID, account));
+        CHECK(storage.adjustBalance(userID, 10000.0, account) == TRADE_OK);
+        return userID;
+    }
+
+
+    void replaysAcrossCompactions(){
+        std::string directory = scratchDirectory("embedded");
+        int userID;
+        {
+            EmbeddedStorage storage(directory);
+            userID = fundedUser(storage);
+        }
+        crashAfter([&]{
+            // A tiny threshold compacts every few blocks, so the log goes through many generations
+            EmbeddedStorage* crashed = new EmbeddedStorage(directory, 512);
+            buyShares(*crashed, userID, 0, 100);
+            checkState(*crashed, userID, 100);
+        });
+        {
+            EmbeddedStorage reopened(directory);
+            checkState(reopened, userID, 100);
+            buyShares(reopened, userID, 100, 120);
+        }
+        EmbeddedStorage again(directory);
+        checkState(again, userID, 120);
+    }
+
+    void coveredLogIsDiscarded(){
+        std::string directory = scratchDirectory("embedded");
+        int userID;
+        std::string oldLog;
+        {
+            EmbeddedStorage storage(directory);
+            userID = fundedUser(storage);
+            buyShares(storage, userID, 0, 5);
+            oldLog = readFile(directory + "/log");
+        }
+        // As if the process stopped after writing the snapshot but before starting the new log
+        writeFile(directory + "/log", oldLog);
+
+        EmbeddedStorage reopened(directory);
+        checkState(reopened, userID, 5);
+    }
+
+    void tornTailIsDropped(){
+        std::string directory = scratchDirectory("embedded");
+        int userID;
+        {
+            EmbeddedStorage storage(directory);
+            userID = fundedUser(storage);
+        }
+        crashAfter([&]{
+            buyShares(*new EmbeddedStorage(directory), userID, 0, 3);
+        });
+        std::string intact = readFile(directory + "/log");
+        writeFile(directory + "/log", intact + "B\t" + std::to_string(userID) + "\t999999\n");
+
+        crashAfter([&]{
+            checkState(*new EmbeddedStorage(directory), userID, 3);
+        });
+        CHECK(readFile(directory + "/log") == intact);
+    }
+
+    void openStoresAreLocked(){
+        std::string directory = scratchDirectory("embedded");
+        {
+            EmbeddedStorage storage(directory);
+            CHECK_THROWS(EmbeddedStorage(directory).storeID());   // flock is per open file, even in one process
+            crashAfter([&]{
+                CHECK_THROWS(EmbeddedStorage(directory).storeID());
+            });
+        }
+        // Released on close, and by a process that dies holding it
+        crashAfter([&]{
+            new EmbeddedStorage(directory);
+        });
+        EmbeddedStorage reopened(directory);
+    }
+
+    void identitySurvivesReopen(){
+        std::string directory = scratchDirectory("embedded");
+        std::string first;
+        {
+            EmbeddedStorage storage(directory);
+            first = storage.storeID();
+        }
+        EmbeddedStorage reopened(directory);
+        CHECK(first.size() == 32);
+        CHECK(reopened.storeID() == first);
+        CHECK(EmbeddedStorage(scratchDirectory("embedded")).storeID() != first);
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"replays across compactions", replaysAcrossCompactions},
+        {"covered log is discarded", coveredLogIsDiscarded},
+        {"torn tail is dropped", tornTailIsDropped},
+        {"identity survives reopen", identitySurvivesReopen},
+        {"open stores are locked", openStoresAreLocked},
+    });
+}
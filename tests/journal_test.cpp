@@ -0,0 +1,182 @@
+#include "check.h"
+#include "../embeddedstorage.h"
+#include "../journal.h"
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Recovery of the trade journal after a crash cut or damaged its tail, its tie to one store,
+// and the checkpoint that keeps a restart from applying a record twice.
+
+
+namespace {
+    JournalRecord deposit(int userID, double amount){
+        JournalRecord record;
+        record.type = JournalEntry::Deposit;
+        record.userID = userID;
+        record.price = amount;
+        return record;
+    }
+
+    // Writes `count` deposits through a journal whose applier keeps nothing, as if the
+    // process stopped before storage caught up; the file is left holding every record
+    void writeDeposits(const std::string& path, const std::string& storeID, int count){
+        TradeJournal journal(path, storeID);
+        journal.recover(0);
+        journal.start([](const std::vector<JournalRecord>&){}, 0);
+        uint64_t last = 0;
+        for(int i = 0; i < count; i++){
+            last = journal.enqueue(deposit(1, 100.0 * (i + 1)));
+        }
+        journal.waitDurable(last);
+    }
+
+    off_t fileSize(const std::string& path){
+        struct stat info;
+        CHECK(::stat(path.c_str(), &info) == 0);
+        return info.st_size;
+    }
+
+    std::string readFile(const std::string& path){
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::string& contents){
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << contents;
+    }
+
+
+    void recoversEveryIntactRecord(){
+        std::string path = scratchDirectory("journal") + "/trades.journal";
+        writeDeposits(path, "store-a", 3);
+
+        TradeJournal journal(path, "store-a");
+        std::vector<JournalRecord> tail = journal.recover(0);
+        CHECK(tail.size() == 3);
+        for(size_t i = 0; i < tail.size(); i++){
+            CHECK(tail[i].sequence == i + 1);
+            CHECK(tail[i].type == JournalEntry::Deposit);
+            CHECK_NEAR(tail[i].price, 100.0 * (i + 1));
+        }
+    }
+
+    void truncatedTailIsCutOff(){
+        std::string path = scratchDirectory("journal") + "/trades.journal";
+        writeDeposits(path, "store-a", 3);
+        off_t full = fileSize(path);
+        CHECK(::truncate(path.c_str(), full - 3) == 0);
+
+        {
+            TradeJournal journal(path, "store-a");
+            std::vector<JournalRecord> tail = journal.recover(0);
+            CHECK(tail.size() == 2);
+            CHECK(tail.back().sequence == 2);
+            CHECK(fileSize(path) < full - 3);   // the partial record is gone, not just skipped
+
+            // New records continue after the last intact one and land after it
+            journal.start([](const std::vector<JournalRecord>&){}, 0);
+            CHECK(journal.enqueue(deposit(1, 7.0)) == 3);
+            journal.waitDurable(3);
+        }
+
+        TradeJournal reopened(path, "store-a");
+        std::vector<JournalRecord> tail = reopened.recover(0);
+        CHECK(tail.size() == 3);
+        CHECK_NEAR(tail.back().price, 7.0);
+    }
+
+    void corruptedTailFailsItsChecksum(){
+        std::string path = scratchDirectory("journal") + "/trades.journal";
+        writeDeposits(path, "store-a", 3);
+        std::string contents = readFile(path);
+        contents.back() ^= 0x5A;
+        writeFile(path, contents);
+
+        TradeJournal journal(path, "store-a");
+        std::vector<JournalRecord> tail = journal.recover(0);
+        CHECK(tail.size() == 2);
+        CHECK(tail.back().sequence == 2);
+    }
+
+    void tornHeaderIsRewritten(){
+        std::string path = scratchDirectory("journal") + "/trades.journal";
+        writeFile(path, "TJN");
+
+        TradeJournal journal(path, "store-a");
+        CHECK(journal.recover(0).empty());
+    }
+
+    void otherStoresAndHoldersAreRefused(){
+        std::string path = scratchDirectory("journal") + "/trades.journal";
+        writeDeposits(path, "store-a", 1);
+        CHECK_THROWS(TradeJournal(path, "store-b"));
+
+        TradeJournal holder(path, "store-a");
+        CHECK_THROWS(TradeJournal(path, "store-a"));   // flock is per open file, even in one process
+    }
+
+    void checkpointAppliesEachRecordOnce(){
+        std::string directory = scratchDirectory("journal");
+        std::string path = directory + "/trades.journal";
+
+        int userID;
+        std::string storeID;
+        {
+            EmbeddedStorage storage(directory);
+            userID = storage.createUser("saver", "pw");
+            storeID = storage.storeID();
+        }
+
+        // Storage applies the first two deposits, then the process dies before the third
+        crashAfter([&]{
+            EmbeddedStorage* crashed = new EmbeddedStorage(directory);
+            TradeJournal* journal = new TradeJournal(path, storeID);
+            journal->recover(crashed->journalCheckpoint());
+            journal->start([](const std::vector<JournalRecord>&){}, 0);
+            std::vector<JournalRecord> written;
+            for(double amount : {100.0, 200.0, 400.0}){
+                JournalRecord record = deposit(userID, amount);
+                record.sequence = journal->enqueue(record);
+                written.push_back(record);
+            }
+            journal->waitDurable(written.back().sequence);
+            crashed->applyJournal({written[0], written[1]});
+        });
+
+        // Restart the way Database::enableJournal does: only what storage has not seen comes back
+        for(int restart = 0; restart < 2; restart++){
+            EmbeddedStorage storage(directory);
+            TradeJournal journal(path, storage.storeID());
+            std::vector<JournalRecord> tail = journal.recover(storage.journalCheckpoint());
+            if(restart == 0){
+                CHECK(storage.journalCheckpoint() == 2);
+                CHECK(tail.size() == 1);
+                CHECK(tail[0].sequence == 3);
+                storage.applyJournal(tail);
+            } else {
+                CHECK(tail.empty());
+            }
+            journal.start([](const std::vector<JournalRecord>&){}, storage.journalCheckpoint());
+
+            AccountVersion account;
+            CHECK(storage.account(userID, account));
+            CHECK_NEAR(account.balance, 700.0);
+        }
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"recovers every intact record", recoversEveryIntactRecord},
+        {"truncated tail is cut off", truncatedTailIsCutOff},
+        {"corrupted tail fails its checksum", corruptedTailFailsItsChecksum},
+        {"torn header is rewritten", tornHeaderIsRewritten},
+        {"other stores and holders are refused", otherStoresAndHoldersAreRefused},
+        {"checkpoint applies each record once", checkpointAppliesEachRecordOnce},
+    });
+}
@@ -0,0 +1,142 @@
+#include "check.h"
+#include "../lotbook.h"
+
+// Cost relief under each lot method, the same ledger built from history and from live fills,
+// and rebuilds that must give way to fills racing them.
+
+
+namespace {
+    TransactionRecord trade(Side side, int quantity, double price){
+        TransactionRecord record;
+        record.symbol = "SYM";
+        record.side = side;
+        record.quantity = quantity;
+        record.price = price;
+        return record;
+    }
+
+    // Buy 10 @ 10, buy 10 @ 20, sell 15 @ 30
+    const std::vector<TransactionRecord> HISTORY = {
+        trade(Side::Buy, 10, 10.0), trade(Side::Buy, 10, 20.0), trade(Side::Sell, 15, 30.0),
+    };
+
+    bool rebuildFrom(LotBook& book, int userID, const std::vector<TransactionRecord>& history){
+        size_t position = 0;
+        return book.rebuild(userID, [&](TransactionRecord& record){
+            if(position == history.size()){
+                return false;
+            }
+            record = history[position++];
+            return true;
+        });
+    }
+
+    void checkRelief(LotMethod method, double realized, double remainingCost){
+        LotBook fromHistory(method);
+        CHECK(rebuildFrom(fromHistory, 1, HISTORY));
+
+        LotBook fromFills(method);
+        CHECK(rebuildFrom(fromFills, 1, {}));
+        fromFills.applyBuy(1, "SYM", 10, 10.0);
+        fromFills.applyBuy(1, "SYM", 10, 20.0);
+        fromFills.applySell(1, "SYM", 15, 30.0);
+
+        for(LotBook* book : {&fromHistory, &fromFills}){
+            CHECK_NEAR(book->realized(1), realized);
+            std::vector<LotPosition> held = book->positions(1);
+            CHECK(held.size() == 1);
+            CHECK(held[0].quantity == 5);
+            CHECK_NEAR(held[0].costBasis, remainingCost);
+            CHECK_NEAR(held[0].realized, realized);
+        }
+    }
+
+
+    void fifoRelievesOldestFirst(){
+        checkRelief(LotMethod::FIFO, 450.0 - 200.0, 100.0);
+    }
+
+    void lifoRelievesNewestFirst(){
+        checkRelief(LotMethod::LIFO, 450.0 - 250.0, 50.0);
+    }
+
+    void averageCostRelievesThePool(){
+        checkRelief(LotMethod::AverageCost, 450.0 - 225.0, 75.0);
+    }
+
+    void oversellingClosesOnlyWhatIsOpen(){
+        for(LotMethod method : {LotMethod::FIFO, LotMethod::LIFO, LotMethod::AverageCost}){
+            LotBook book(method);
+            CHECK(rebuildFrom(book, 1, {trade(Side::Buy, 4, 10.0), trade(Side::Sell, 6, 12.0)}));
+            CHECK_NEAR(book.realized(1), 4 * 2.0);
+            std::vector<LotPosition> held = book.positions(1);
+            CHECK(held.size() == 1);
+            CHECK(held[0].quantity == 0);
+            CHECK(held[0].openLots == 0);
+            CHECK_NEAR(held[0].costBasis, 0.0);
+        }
+    }
+
+    void unloadedUsersIgnoreFills(){
+        LotBook book;
+        book.applyBuy(1, "SYM", 10, 10.0);
+        CHECK(!book.isLoaded(1));
+        CHECK(rebuildFrom(book, 1, {}));
+        CHECK(book.positions(1).empty());
+    }
+
+    void rebuildsGiveWayToFills(){
+        LotBook book;
+
+        // A fill in flight for the whole rebuild
+        {
+            LotBook::PendingFill pending(book, {1});
+            CHECK(!rebuildFrom(book, 1, HISTORY));
+            CHECK(!book.isLoaded(1));
+        }
+
+        // A fill that began and finished while the history was being read
+        size_t position = 0;
+        bool installed = book.rebuild(1, [&](TransactionRecord& record){
+            if(position == 1){
+                LotBook::PendingFill pending(book, {1});
+            }
+            if(position == HISTORY.size()){
+                return false;
+            }
+            record = HISTORY[position++];
+            return true;
+        });
+        CHECK(!installed);
+        CHECK(!book.isLoaded(1));
+
+        // Other users' fills do not get in the way
+        {
+            LotBook::PendingFill pending(book, {2});
+            CHECK(rebuildFrom(book, 1, HISTORY));
+        }
+        CHECK(book.isLoaded(1));
+    }
+
+    void changingTheMethodUnloads(){
+        LotBook book(LotMethod::FIFO);
+        CHECK(rebuildFrom(book, 1, HISTORY));
+        book.setMethod(LotMethod::LIFO);
+        CHECK(!book.isLoaded(1));
+        CHECK(rebuildFrom(book, 1, HISTORY));
+        CHECK_NEAR(book.realized(1), 200.0);
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"FIFO relieves oldest first", fifoRelievesOldestFirst},
+        {"LIFO relieves newest first", lifoRelievesNewestFirst},
+        {"average cost relieves the pool", averageCostRelievesThePool},
+        {"overselling closes only what is open", oversellingClosesOnlyWhatIsOpen},
+        {"unloaded users ignore fills", unloadedUsersIgnoreFills},
+        {"rebuilds give way to fills", rebuildsGiveWayToFills},
+        {"changing the method unloads", changingTheMethodUnloads},
+    });
+}
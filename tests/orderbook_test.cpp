@@ -0,0 +1,207 @@
+#include "check.h"
+#include "../orderbook.h"
+
+// Price-time priority, partial fills and the ways a fill that could not be settled is undone:
+// makers going back at their old priority and takers given back the shares a maker failed on.
+
+
+namespace {
+    int quantityAt(const std::vector<Fill>& fills, size_t first, uint64_t makerOrderID){
+        int quantity = 0;
+        for(size_t i = first; i < fills.size(); i++){
+            if(fills[i].makerOrderID == makerOrderID){
+                quantity += fills[i].quantity;
+            }
+        }
+        return quantity;
+    }
+
+
+    void bestPriceThenTimeFirst(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        CHECK(book.addOrder(1, 10, Side::Sell, 10100, 5, fills) == 5);
+        CHECK(book.addOrder(2, 11, Side::Sell, 10000, 5, fills) == 5);
+        CHECK(book.addOrder(3, 12, Side::Sell, 10000, 5, fills) == 5);
+        CHECK(fills.empty());
+
+        int64_t ask = 0;
+        CHECK(book.bestAsk(ask));
+        CHECK(ask == 10000);
+
+        CHECK(book.addOrder(4, 20, Side::Buy, 10100, 12, fills) == 0);
+        CHECK(fills.size() == 3);
+        CHECK(fills[0].makerOrderID == 2);
+        CHECK(fills[1].makerOrderID == 3);
+        CHECK(fills[2].makerOrderID == 1);
+        CHECK(fills[2].quantity == 2);
+        CHECK(fills[2].priceTicks == 10100);
+        for(const Fill& fill : fills){
+            CHECK(fill.takerOrderID == 4);
+            CHECK(fill.takerUserID == 20);
+            CHECK(fill.takerSide == Side::Buy);
+        }
+        CHECK(book.restingOrders() == 1);
+        CHECK(book.orderOwner(1) == 10);
+    }
+
+    void unmatchedRemainderRests(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        book.addOrder(1, 10, Side::Buy, 9900, 4, fills);
+        CHECK(book.addOrder(2, 11, Side::Sell, 9900, 10, fills) == 6);
+        CHECK(fills.size() == 1);
+        CHECK(fills[0].priceTicks == 9900);
+
+        int64_t bid = 0, ask = 0;
+        CHECK(!book.bestBid(bid));
+        CHECK(book.bestAsk(ask));
+        CHECK(ask == 9900);
+
+        // Not crossing: both sides rest
+        CHECK(book.addOrder(3, 12, Side::Buy, 9800, 3, fills) == 3);
+        CHECK(fills.size() == 1);
+        CHECK(book.bestBid(bid));
+        CHECK(bid == 9800);
+    }
+
+    void cancelRemovesOnlyRestingOrders(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        book.addOrder(1, 10, Side::Sell, 10000, 5, fills);
+        book.addOrder(2, 11, Side::Sell, 10000, 5, fills);
+        CHECK(book.cancelOrder(1));
+        CHECK(!book.cancelOrder(1));
+        CHECK(book.orderOwner(1) == -1);
+
+        book.addOrder(3, 20, Side::Buy, 10000, 5, fills);
+        CHECK(fills.size() == 1);
+        CHECK(fills[0].makerOrderID == 2);
+        CHECK(!book.cancelOrder(2));   // filled
+        CHECK(book.restingOrders() == 0);
+        CHECK_THROWS(book.addOrder(4, 20, Side::Buy, 10000, 0, fills));
+    }
+
+    void restoredMakersKeepTheirPlace(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        book.addOrder(1, 10, Side::Sell, 10000, 5, fills);
+        book.addOrder(2, 11, Side::Sell, 10000, 5, fills);
+        book.addOrder(3, 12, Side::Sell, 10000, 5, fills);
+        book.addOrder(4, 20, Side::Buy, 10000, 8, fills);
+        CHECK(fills.size() == 2);
+
+        // Both fills failed: newest first, so order 1 ends up back in front of order 2
+        book.restoreMaker(fills[1]);
+        book.restoreMaker(fills[0]);
+        CHECK(book.restingOrders() == 3);
+
+        std::vector<Fill> again;
+        book.addOrder(5, 21, Side::Buy, 10000, 15, again);
+        CHECK(again.size() == 3);
+        CHECK(again[0].makerOrderID == 1);
+        CHECK(again[0].quantity == 5);
+        CHECK(again[1].makerOrderID == 2);
+        CHECK(again[1].quantity == 5);
+        CHECK(again[2].makerOrderID == 3);
+        CHECK(book.restingOrders() == 0);
+    }
+
+    void extendedTakersMatchAgain(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        book.addOrder(1, 10, Side::Sell, 10000, 5, fills);
+        book.addOrder(2, 11, Side::Sell, 10050, 5, fills);
+        CHECK(book.addOrder(3, 20, Side::Buy, 10100, 5, fills) == 0);
+        CHECK(fills.size() == 1);
+        CHECK(book.orderOwner(3) == -1);
+
+        // Order 1's fill failed: the taker, no longer on the book, takes the shares to order 2
+        size_t first = fills.size();
+        CHECK(book.extendOrder(3, 20, Side::Buy, 10100, 5, fills) == 0);
+        CHECK(quantityAt(fills, first, 2) == 5);
+        CHECK(fills.back().takerOrderID == 3);
+
+        // Nothing left to cross: the shares rest under the same ID
+        first = fills.size();
+        CHECK(book.extendOrder(3, 20, Side::Buy, 10100, 4, fills) == 4);
+        CHECK(fills.size() == first);
+        CHECK(book.orderOwner(3) == 20);
+
+        // Still resting: grows in place
+        CHECK(book.extendOrder(3, 20, Side::Buy, 10100, 3, fills) == 7);
+        CHECK(book.restingOrders() == 1);
+        book.addOrder(4, 12, Side::Sell, 10100, 10, fills);
+        CHECK(quantityAt(fills, first, 3) == 7);
+        CHECK(book.restingOrders() == 1);
+        CHECK(book.orderOwner(4) == 12);
+    }
+
+    void marketFillsCrossedOrders(){
+        OrderBook book;
+        std::vector<Fill> fills;
+        book.addOrder(1, 10, Side::Buy, 10200, 3, fills);
+        book.addOrder(2, 11, Side::Buy, 10100, 4, fills);
+        book.addOrder(3, 12, Side::Buy, 10200, 5, fills);
+        book.addOrder(4, 13, Side::Buy, 9900, 6, fills);
+        book.addOrder(5, 14, Side::Sell, 10500, 7, fills);
+
+        CHECK(book.executeAgainstMarket(10100, fills) == 3);
+        CHECK(fills[0].makerOrderID == 1);
+        CHECK(fills[1].makerOrderID == 3);
+        CHECK(fills[2].makerOrderID == 2);
+        for(const Fill& fill : fills){
+            CHECK(fill.takerOrderID == MARKET_ORDER_ID);
+            CHECK(fill.takerUserID == MARKET_USER_ID);
+            CHECK(fill.takerSide == Side::Sell);
+            CHECK(fill.priceTicks == 10100);
+        }
+        CHECK(fills[0].makerPriceTicks == 10200);
+        CHECK(book.restingOrders() == 2);
+
+        fills.clear();
+        CHECK(book.executeAgainstMarket(10000, fills) == 0);
+        CHECK(book.executeAgainstMarket(10600, fills) == 1);
+        CHECK(fills[0].makerOrderID == 5);
+        CHECK(fills[0].takerSide == Side::Buy);
+        CHECK(fills[0].quantity == 7);
+    }
+
+    void engineRoutesCancelsByOwner(){
+        MatchingEngine engine;
+        std::vector<Fill> fills;
+        uint64_t resting = engine.submitLimit("ACME", 10, Side::Sell, 100.0, 5, fills);
+        uint64_t other = engine.submitLimit("INIT", 10, Side::Sell, 100.0, 5, fills);
+        CHECK(resting != other);
+        CHECK(!engine.cancel(11, resting));
+
+        uint64_t taker = engine.submitLimit("ACME", 11, Side::Buy, 100.0, 8, fills);
+        CHECK(fills.size() == 1);
+        CHECK(!engine.cancel(10, resting));   // filled
+        CHECK(engine.cancel(11, taker));
+
+        // A taker extended after its maker failed is routed again and can be cancelled
+        fills.clear();
+        uint64_t buyer = engine.submitLimit("INIT", 12, Side::Buy, 100.0, 5, fills);
+        CHECK(fills.size() == 1);
+        CHECK(!engine.cancel(12, buyer));
+        engine.extend("INIT", buyer, 12, Side::Buy, 100.0, 5, fills);
+        CHECK(engine.cancel(12, buyer));
+
+        CHECK_THROWS(engine.submitLimit("ACME", 10, Side::Buy, 0.0, 5, fills));
+        CHECK(engine.onMarketPrice("NONE", 1.0, fills) == 0);
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"best price then time first", bestPriceThenTimeFirst},
+        {"unmatched remainder rests", unmatchedRemainderRests},
+        {"cancel removes only resting orders", cancelRemovesOnlyRestingOrders},
+        {"restored makers keep their place", restoredMakersKeepTheirPlace},
+        {"extended takers match again", extendedTakersMatchAgain},
+        {"market fills crossed orders", marketFillsCrossedOrders},
+        {"engine routes cancels by owner", engineRoutesCancelsByOwner},
+    });
+}
@@ -0,0 +1,83 @@
+#include "check.h"
+#include "../positions.h"
+
+// Average-cost bookkeeping, fills for users that are not loaded, and loads that must give way
+// to fills racing them.
+
+
+namespace {
+    std::unordered_map<std::string, Position> holding(int quantity, double costBasis){
+        Position position;
+        position.quantity = quantity;
+        position.costBasis = costBasis;
+        return {{"SYM", position}};
+    }
+
+
+    void averageCostIsRelieved(){
+        PositionBook book;
+        CHECK(book.load(1, {}, book.generation(1)));
+        book.applyBuy(1, "SYM", 10, 10.0);
+        book.applyBuy(1, "SYM", 10, 20.0);
+        CHECK_NEAR(book.applySell(1, "SYM", 5), 75.0);
+        CHECK(book.quantity(1, "SYM") == 15);
+        CHECK_NEAR(book.position(1, "SYM").costBasis, 225.0);
+        CHECK_THROWS(book.applySell(1, "SYM", 16));
+
+        book.applySell(1, "SYM", 15);
+        CHECK(book.holdings(1).empty());
+        CHECK(book.symbols().empty());
+    }
+
+    void unloadedUsersIgnoreFills(){
+        PositionBook book;
+        book.applyBuy(1, "SYM", 10, 10.0);
+        CHECK_NEAR(book.applySell(1, "SYM", 5), 0.0);
+        book.set(1, "SYM", holding(3, 30.0)["SYM"]);
+        CHECK(!book.isLoaded(1));
+        CHECK(book.symbols().empty());
+
+        CHECK(book.load(1, holding(2, 20.0), book.generation(1)));
+        book.set(1, "SYM", holding(3, 30.0)["SYM"]);
+        CHECK(book.quantity(1, "SYM") == 3);
+        book.unload(1);
+        book.applyBuy(1, "SYM", 10, 10.0);
+        CHECK(!book.isLoaded(1));
+    }
+
+    void loadsGiveWayToFills(){
+        PositionBook book;
+
+        // A fill in flight for the whole load
+        {
+            PositionBook::PendingFill pending(book, {1});
+            CHECK(!book.load(1, holding(10, 100.0), book.generation(1)));
+            CHECK(!book.isLoaded(1));
+        }
+
+        // A fill that began and finished between reading the generation and installing
+        uint64_t generation = book.generation(1);
+        {
+            PositionBook::PendingFill pending(book, {1});
+        }
+        CHECK(!book.load(1, holding(10, 100.0), generation));
+        CHECK(!book.isLoaded(1));
+
+        // Other users' fills do not get in the way
+        generation = book.generation(1);
+        {
+            PositionBook::PendingFill pending(book, {2, 3});
+            CHECK(book.load(1, holding(10, 100.0), generation));
+        }
+        CHECK(book.quantity(1, "SYM") == 10);
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"average cost is relieved", averageCostIsRelieved},
+        {"unloaded users ignore fills", unloadedUsersIgnoreFills},
+        {"loads give way to fills", loadsGiveWayToFills},
+    });
+}
@@ -0,0 +1,125 @@
+#include "check.h"
+#include "../protocol.h"
+#include <cstring>
+
+// Framing and payload decoding on the input a socket actually delivers: frames split across
+// reads, several frames in one read, and lengths or fields a broken or hostile peer made up.
+
+
+namespace {
+    std::string lengthPrefix(uint32_t length){
+        std::string out(sizeof(length), '\0');
+        std::memcpy(&out[0], &length, sizeof(length));
+        return out;
+    }
+
+
+    void partialFramesWait(){
+        std::string wire;
+        appendFrame(wire, MessageType::Balance, 9, PayloadWriter().f64(1.5).bytes());
+
+        Frame frame;
+        size_t offset = 0;
+        CHECK(!takeFrame(std::string(), offset, frame));
+        for(size_t cut = 1; cut < wire.size(); cut++){
+            CHECK(!takeFrame(wire.substr(0, cut), offset, frame));
+            CHECK(offset == 0);
+        }
+
+        CHECK(takeFrame(wire, offset, frame));
+        CHECK(offset == wire.size());
+        CHECK(frame.type == MessageType::Balance);
+        CHECK(frame.requestID == 9);
+        CHECK(frame.payload.size() == sizeof(double));
+    }
+
+    void framesAreTakenInOrder(){
+        std::string wire;
+        appendFrame(wire, MessageType::Cancel, 1, PayloadWriter().u64(42).bytes());
+        appendFrame(wire, MessageType::Balance, 2, std::string());
+        appendFrame(wire, MessageType::Portfolio, 3, std::string());
+        wire.resize(wire.size() - 1);   // the third one is still arriving
+
+        Frame frame;
+        size_t offset = 0;
+        CHECK(takeFrame(wire, offset, frame));
+        CHECK(frame.requestID == 1);
+        CHECK(PayloadReader(frame.payload).u64() == 42);
+        CHECK(takeFrame(wire, offset, frame));
+        CHECK(frame.requestID == 2);
+        CHECK(frame.payload.empty());
+        CHECK(!takeFrame(wire, offset, frame));
+        CHECK(offset == wire.size() - (FRAME_HEADER_BYTES - 1));
+    }
+
+    void lengthsOutOfRangeThrow(){
+        Frame frame;
+        size_t offset = 0;
+        // Rejected from the prefix alone, before any of the claimed bytes arrive
+        CHECK_THROWS(takeFrame(lengthPrefix(MAX_FRAME_BYTES + 1), offset, frame));
+        CHECK_THROWS(takeFrame(lengthPrefix(UINT32_MAX), offset, frame));
+        CHECK_THROWS(takeFrame(lengthPrefix(0), offset, frame));
+        CHECK_THROWS(takeFrame(lengthPrefix(FRAME_HEADER_BYTES - sizeof(uint32_t) - 1), offset, frame));
+        CHECK(offset == 0);
+    }
+
+    void largestPayloadFits(){
+        std::string wire;
+        appendFrame(wire, MessageType::Ok, 5, std::string(MAX_PAYLOAD_BYTES, 'x'));
+
+        Frame frame;
+        size_t offset = 0;
+        CHECK(takeFrame(wire, offset, frame));
+        CHECK(frame.payload.size() == MAX_PAYLOAD_BYTES);
+
+        std::string oversized;
+        appendFrame(oversized, MessageType::Ok, 6, std::string(MAX_PAYLOAD_BYTES + 1, 'x'));
+        offset = 0;
+        CHECK_THROWS(takeFrame(oversized, offset, frame));
+    }
+
+    void payloadsRoundTrip(){
+        std::string payload = PayloadWriter().u8(1).str("ACME").i32(-25).f64(101.25).u16(7).u64(1ull << 40).str("").bytes();
+        PayloadReader reader(payload);
+        CHECK(reader.u8() == 1);
+        CHECK(reader.str() == "ACME");
+        CHECK(reader.i32() == -25);
+        CHECK_NEAR(reader.f64(), 101.25);
+        CHECK(reader.u16() == 7);
+        CHECK(reader.u64() == 1ull << 40);
+        CHECK(reader.str().empty());
+        CHECK_THROWS(reader.u8());
+    }
+
+    void shortPayloadsThrow(){
+        std::string payload = PayloadWriter().str("ACME").bytes();
+        for(size_t cut = 0; cut < payload.size(); cut++){
+            std::string truncated = payload.substr(0, cut);
+            PayloadReader reader(truncated);
+            CHECK_THROWS(reader.str());
+        }
+
+        std::string three(3, '\0');
+        CHECK_THROWS(PayloadReader(three).i32());
+        CHECK_THROWS(PayloadReader(three).f64());
+        CHECK_THROWS(PayloadReader(three).u64());
+
+        // A string length that runs past the payload
+        std::string lying = PayloadWriter().u16(UINT16_MAX).bytes() + "abc";
+        CHECK_THROWS(PayloadReader(lying).str());
+
+        CHECK_THROWS(PayloadWriter().str(std::string(UINT16_MAX + 1, 'x')));
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"partial frames wait", partialFramesWait},
+        {"frames are taken in order", framesAreTakenInOrder},
+        {"lengths out of range throw", lengthsOutOfRangeThrow},
+        {"largest payload fits", largestPayloadFits},
+        {"payloads round trip", payloadsRoundTrip},
+        {"short payloads throw", shortPayloadsThrow},
+    });
+}
@@ -0,0 +1,113 @@
+#include "check.h"
+#include "../quotefeed.h"
+
+// Both payload formats as the quote scripts emit them, and the malformed rows, numbers and
+// truncated objects a feed delivers when it misbehaves.
+
+
+namespace {
+    void csvRowsParse(){
+        std::string payload = "symbol,price,volume,name\n"
+                              "ACME, 101.25 ,1500,Acme Corp, Inc.\r\n"
+                              "INIT,2\n"
+                              "\n"
+                              "BIG,1.5e3,2e6\n";
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes(payload, quotes) == 3);
+        CHECK(quotes.size() == 3);
+
+        CHECK(quotes[0].symbol == "ACME");
+        CHECK_NEAR(quotes[0].price, 101.25);
+        CHECK(quotes[0].volume == 1500);
+        CHECK(quotes[0].companyName == "Acme Corp, Inc.");
+
+        CHECK(quotes[1].symbol == "INIT");
+        CHECK_NEAR(quotes[1].price, 2.0);
+        CHECK(quotes[1].volume == 0);
+        CHECK(quotes[1].companyName.empty());
+
+        CHECK_NEAR(quotes[2].price, 1500.0);
+        CHECK(quotes[2].volume == 2000000);
+    }
+
+    void malformedCsvRowsAreSkipped(){
+        std::string payload = "ACME\n"
+                              ",10\n"
+                              "ACME,\n"
+                              "ACME,abc\n"
+                              "ACME,1.2.3\n"
+                              "ACME,1e\n"
+                              "ACME,1e99\n"
+                              "ACME,-\n"
+                              "GOOD,-0.5,notanumber\n";
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes(payload, quotes) == 1);
+        CHECK(quotes[0].symbol == "GOOD");
+        CHECK_NEAR(quotes[0].price, -0.5);
+        CHECK(quotes[0].volume == 0);
+    }
+
+    void jsonArraysParse(){
+        std::string payload = R"( [
+            {"symbol": "ACME", "price": 101.25, "volume": 1500, "name": "Acme \"Corp\""},
+            {"price": "2.5", "symbol": "INIT", "extra": {"nested": [1, "}", 2]}},
+            {"symbol": "NOPRICE", "volume": 10},
+            {"symbol": 7, "price": 1},
+            {}
+        ] )";
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes(payload, quotes) == 2);
+
+        CHECK(quotes[0].symbol == "ACME");
+        CHECK_NEAR(quotes[0].price, 101.25);
+        CHECK(quotes[0].volume == 1500);
+        CHECK(quotes[0].companyName == "Acme \\\"Corp\\\"");   // escapes are left as-is
+
+        CHECK(quotes[1].symbol == "INIT");
+        CHECK_NEAR(quotes[1].price, 2.5);
+    }
+
+    void newlineDelimitedJsonParses(){
+        std::string payload = "{\"symbol\":\"A\",\"price\":1}\n{\"symbol\":\"B\",\"price\":2}\n";
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes(payload, quotes) == 2);
+        CHECK(quotes[1].symbol == "B");
+    }
+
+    void truncatedJsonKeepsWhatParsed(){
+        std::string payload = R"([{"symbol":"A","price":1},{"symbol":"B","price":2},{"symbol":"C","pri)";
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes(payload, quotes) == 2);
+
+        quotes.clear();
+        CHECK(parseQuotes(R"([{"symbol":"A","price":1)", quotes) == 0);
+        CHECK(parseQuotes(R"([{"symbol":"A)", quotes) == 0);
+        CHECK(quotes.empty());
+    }
+
+    void outputIsAppendedTo(){
+        std::vector<Quote> quotes;
+        CHECK(parseQuotes("", quotes) == 0);
+        CHECK(parseQuotes(" \r\n\t", quotes) == 0);
+
+        std::string first = "A,1\n";
+        std::string second = "[{\"symbol\":\"B\",\"price\":2}]";
+        CHECK(parseQuotes(first, quotes) == 1);
+        CHECK(parseQuotes(second, quotes) == 1);
+        CHECK(quotes.size() == 2);
+        CHECK(quotes[0].symbol == "A");
+        CHECK(quotes[1].symbol == "B");
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"CSV rows parse", csvRowsParse},
+        {"malformed CSV rows are skipped", malformedCsvRowsAreSkipped},
+        {"JSON arrays parse", jsonArraysParse},
+        {"newline-delimited JSON parses", newlineDelimitedJsonParses},
+        {"truncated JSON keeps what parsed", truncatedJsonKeepsWhatParsed},
+        {"output is appended to", outputIsAppendedTo},
+    });
+}
@@ -0,0 +1,151 @@
+#include "check.h"
+#include "../replay.h"
+#include <fstream>
+#include <sstream>
+
+// A replay is a pure function of its tick files and order schedule: the same calls in the same
+// order at any speed, batched by timestamp, and the same fills out of a matching engine fed by it.
+
+
+namespace {
+    // ACME and INIT tick together at 10 and 30, ACME alone at 20, INIT alone at 40
+    std::string recordedDirectory(){
+        std::string directory = scratchDirectory("replay");
+        TickStore store(directory);
+        store.append("INIT", 10, 5.00, 1);
+        store.append("ACME", 10, 100.00, 1);
+        store.append("ACME", 20, 99.00, 1);
+        store.append("ACME", 30, 97.50, 1);
+        store.append("INIT", 30, 5.25, 1);
+        store.append("INIT", 40, 4.75, 1);
+        store.flush();
+        return directory;
+    }
+
+    const std::vector<ScheduledOrder> ORDERS = {
+        {15, 1, "ACME", Side::Buy, 10, 98.00},
+        {15, 2, "INIT", Side::Sell, 5, 5.20},
+        {35, 3, "INIT", Side::Buy, 7, 4.80},
+        {99, 4, "ACME", Side::Sell, 1, 1.00},   // after the last tick: submitted once the ticks run out
+    };
+
+    // Every call the replay makes, in order, as text
+    std::string transcript(const std::string& directory, double speed, ReplayStats& stats,
+                           int64_t from = INT64_MIN, int64_t to = INT64_MAX){
+        MarketReplay replay(directory, {}, from, to);
+        replay.schedule(ORDERS);
+        std::ostringstream calls;
+        stats = replay.run(speed,
+            [&calls](const std::vector<std::pair<std::string, double>>& updates){
+                calls << "prices";
+                for(const auto& update : updates){
+                    calls << " " << update.first << "=" << update.second;
+                }
+                calls << "\n";
+            },
+            [&calls](const ScheduledOrder& order){
+                calls << "order " << order.userID << " " << order.symbol << "\n";
+            });
+        return calls.str();
+    }
+
+
+    void batchesFollowRecordedTime(){
+        std::string directory = recordedDirectory();
+        ReplayStats stats;
+        std::string calls = transcript(directory, 0.0, stats);
+        CHECK(calls == "prices ACME=100 INIT=5\n"
+                       "order 1 ACME\n"
+                       "order 2 INIT\n"
+                       "prices ACME=99\n"
+                       "prices ACME=97.5 INIT=5.25\n"
+                       "order 3 INIT\n"
+                       "prices INIT=4.75\n"
+                       "order 4 ACME\n");
+        CHECK(stats.batches == 4);
+        CHECK(stats.updates == 6);
+        CHECK(stats.orders == 4);
+    }
+
+    void speedDoesNotChangeTheCalls(){
+        std::string directory = recordedDirectory();
+        ReplayStats stats;
+        std::string asFastAsPossible = transcript(directory, 0.0, stats);
+        // Timestamps are nanoseconds, so recorded time is 30 ns end to end
+        CHECK(transcript(directory, 1.0, stats) == asFastAsPossible);
+        CHECK(transcript(directory, 1000.0, stats) == asFastAsPossible);
+        CHECK(transcript(directory, 0.0, stats) == asFastAsPossible);
+    }
+
+    void rangesCutWholeBatches(){
+        std::string directory = recordedDirectory();
+        ReplayStats stats;
+        std::string calls = transcript(directory, 0.0, stats, 20, 40);
+        CHECK(calls == "order 1 ACME\n"
+                       "order 2 INIT\n"
+                       "prices ACME=99\n"
+                       "prices ACME=97.5 INIT=5.25\n"
+                       "order 3 INIT\n"
+                       "order 4 ACME\n");
+        CHECK(stats.batches == 2);
+
+        MarketReplay onlyInit(directory, {"INIT"});
+        CHECK(onlyInit.symbolCount() == 1);
+    }
+
+    void matchingIsReproducible(){
+        std::string directory = recordedDirectory();
+        std::string runs[2];
+        for(std::string& run : runs){
+            MatchingEngine engine;
+            std::vector<Fill> fills;
+            MarketReplay replay(directory, {});
+            replay.schedule(ORDERS);
+            replay.run(0.0,
+                [&](const std::vector<std::pair<std::string, double>>& updates){
+                    for(const auto& update : updates){
+                        engine.onMarketPrice(update.first, update.second, fills);
+                    }
+                },
+                [&](const ScheduledOrder& order){
+                    engine.submitLimit(order.symbol, order.userID, order.side, order.limitPrice, order.quantity, fills);
+                });
+
+            std::ostringstream out;
+            for(const Fill& fill : fills){
+                out << fill.makerOrderID << " " << fill.makerUserID << " " << fill.priceTicks << " " << fill.quantity << "\n";
+            }
+            run = out.str();
+        }
+        // ACME's buy at 98 fills at 97.50; INIT's sell at 5.20 at 5.25; INIT's buy at 4.80 at 4.75
+        CHECK(runs[0] == "1 1 9750 10\n2 2 525 5\n3 3 475 7\n");
+        CHECK(runs[1] == runs[0]);
+    }
+
+    void schedulesSkipBadLines(){
+        std::string path = scratchDirectory("replay") + "/orders.csv";
+        std::ofstream(path) << "timestamp,userID,symbol,side,quantity,limitPrice\n"
+                               "20,1,ACME,Buy,10,98.5\n"
+                               "garbage\n"
+                               "30,2,INIT,Hold,5,5\n"
+                               "10,3,INIT,Sell,5,5.2\n";
+        std::vector<ScheduledOrder> orders = loadScheduledOrders(path);
+        CHECK(orders.size() == 2);
+        CHECK(orders[0].userID == 1);
+        CHECK(orders[0].side == Side::Buy);
+        CHECK_NEAR(orders[0].limitPrice, 98.5);
+        CHECK(orders[1].symbol == "INIT");
+        CHECK(orders[1].side == Side::Sell);
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"batches follow recorded time", batchesFollowRecordedTime},
+        {"speed does not change the calls", speedDoesNotChangeTheCalls},
+        {"ranges cut whole batches", rangesCutWholeBatches},
+        {"matching is reproducible", matchingIsReproducible},
+        {"schedules skip bad lines", schedulesSkipBadLines},
+    });
+}
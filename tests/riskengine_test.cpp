@@ -0,0 +1,146 @@
+#include "check.h"
+#include "../riskengine.h"
+#include "../metrics.h"
+
+// Each pre-trade rule on its own, the order they are checked in, and per-account limits
+// overriding the defaults for UserIDs inside and outside the preallocated chunks.
+
+
+namespace {
+    RiskOrder buy(int userID, int quantity, double price, double buyingPower, int position = 0){
+        RiskOrder order;
+        order.userID = userID;
+        order.side = Side::Buy;
+        order.quantity = quantity;
+        order.price = price;
+        order.buyingPower = buyingPower;
+        order.position = position;
+        return order;
+    }
+
+    RiskOrder sell(int userID, int quantity, double price){
+        RiskOrder order = buy(userID, quantity, price, 0.0);
+        order.side = Side::Sell;
+        return order;
+    }
+
+
+    void buyingPowerCoversBuysOnly(){
+        RiskEngine risk;
+        CHECK(risk.check(buy(1, 10, 10.0, 100.0)) == RiskRule::None);
+        CHECK(risk.check(buy(1, 10, 10.0, 99.99)) == RiskRule::BuyingPower);
+        CHECK(risk.check(sell(1, 1000, 10.0)) == RiskRule::None);
+
+        RiskLimits limits;
+        limits.checkBuyingPower = false;
+        risk.setDefaultLimits(limits);
+        CHECK(risk.check(buy(1, 10, 10.0, 0.0)) == RiskRule::None);
+    }
+
+    void notionalCapsBothSides(){
+        RiskEngine risk;
+        RiskLimits limits;
+        limits.maxOrderNotional = 500.0;
+        risk.setDefaultLimits(limits);
+        CHECK(risk.check(buy(1, 50, 10.0, 1e9)) == RiskRule::None);
+        CHECK(risk.check(buy(1, 51, 10.0, 1e9)) == RiskRule::MaxNotional);
+        CHECK(risk.check(sell(1, 51, 10.0)) == RiskRule::MaxNotional);
+    }
+
+    void positionCapsHoldingsAfterABuy(){
+        RiskEngine risk;
+        RiskLimits limits;
+        limits.maxPosition = 100;
+        risk.setDefaultLimits(limits);
+        CHECK(risk.check(buy(1, 40, 1.0, 1e9, 60)) == RiskRule::None);
+        CHECK(risk.check(buy(1, 41, 1.0, 1e9, 60)) == RiskRule::MaxPosition);
+        // Selling only shrinks a position
+        RiskOrder order = sell(1, 10, 1.0);
+        order.position = 500;
+        CHECK(risk.check(order) == RiskRule::None);
+    }
+
+    void ruleOrderIsFixed(){
+        RiskEngine risk;
+        RiskLimits limits;
+        limits.maxOrderNotional = 100.0;
+        limits.maxPosition = 5;
+        risk.setDefaultLimits(limits);
+        // Breaks all three: notional is reported first, then position, then buying power
+        CHECK(risk.check(buy(1, 10, 20.0, 0.0, 10)) == RiskRule::MaxNotional);
+        CHECK(risk.check(buy(1, 10, 1.0, 0.0, 10)) == RiskRule::MaxPosition);
+        CHECK(risk.check(buy(1, 5, 1.0, 0.0)) == RiskRule::BuyingPower);
+    }
+
+    void rateCountsOnlyPassingOrders(){
+        RiskEngine risk;
+        RiskLimits limits;
+        limits.maxOrdersPerSecond = 3;
+        limits.maxOrderNotional = 100.0;
+        risk.setDefaultLimits(limits);
+
+        // Refused by another rule first, so none of these use up the rate
+        for(int i = 0; i < 10; i++){
+            CHECK(risk.check(sell(1, 1000, 1.0)) == RiskRule::MaxNotional);
+        }
+        for(int i = 0; i < 3; i++){
+            CHECK(risk.check(sell(1, 1, 1.0)) == RiskRule::None);
+        }
+
+        // A burst can straddle at most one window change, so at most one more window's worth passes
+        uint64_t before = RiskEngine::rejected(RiskRule::OrderRate);
+        int passed = 0;
+        for(int i = 0; i < 100; i++){
+            passed += risk.check(sell(1, 1, 1.0)) == RiskRule::None;
+        }
+        CHECK(passed <= 3);
+        CHECK(RiskEngine::rejected(RiskRule::OrderRate) - before == static_cast<uint64_t>(100 - passed));
+
+        // Other accounts have their own window
+        CHECK(risk.check(sell(2, 1, 1.0)) == RiskRule::None);
+    }
+
+    void accountLimitsOverrideDefaults(){
+        RiskEngine risk;
+        RiskLimits tight;
+        tight.maxOrderNotional = 10.0;
+        RiskLimits loose;
+        loose.checkBuyingPower = false;
+
+        // Inside the chunks, past them, and negative
+        const int users[] = {7, static_cast<int>(RiskEngine::CHUNK_ACCOUNTS * RiskEngine::MAX_CHUNKS) + 5, -3};
+        risk.setDefaultLimits(tight);
+        for(int userID : users){
+            CHECK(risk.check(buy(userID, 2, 10.0, 1e9)) == RiskRule::MaxNotional);
+            risk.setLimits(userID, loose);
+            CHECK(risk.limitsFor(userID).checkBuyingPower == false);
+            CHECK(risk.check(buy(userID, 2, 10.0, 0.0)) == RiskRule::None);
+            risk.clearLimits(userID);
+            CHECK_NEAR(risk.limitsFor(userID).maxOrderNotional, 10.0);
+        }
+        CHECK(risk.check(buy(8, 2, 10.0, 1e9)) == RiskRule::MaxNotional);
+        CHECK_NEAR(risk.defaultLimits().maxOrderNotional, 10.0);
+    }
+
+    void rejectionsAreCounted(){
+        RiskEngine risk;
+        uint64_t before = RiskEngine::rejected(RiskRule::BuyingPower);
+        risk.check(buy(1, 1, 1.0, 0.0));
+        risk.check(buy(1, 1, 1.0, 0.0));
+        CHECK(RiskEngine::rejected(RiskRule::BuyingPower) - before == 2);
+        CHECK(std::string(RiskEngine::describe(RiskRule::BuyingPower)) == "Insufficient funds to buy stock.");
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"buying power covers buys only", buyingPowerCoversBuysOnly},
+        {"notional caps both sides", notionalCapsBothSides},
+        {"position caps holdings after a buy", positionCapsHoldingsAfterABuy},
+        {"rule order is fixed", ruleOrderIsFixed},
+        {"rate counts only passing orders", rateCountsOnlyPassingOrders},
+        {"account limits override defaults", accountLimitsOverrideDefaults},
+        {"rejections are counted", rejectionsAreCounted},
+    });
+}
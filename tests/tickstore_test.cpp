@@ -0,0 +1,149 @@
+#include "check.h"
+#include "../tickstore.h"
+
+// Seeks and scans across block boundaries, a reader catching up with a writer, and the store's
+// handling of clocks that step back.
+
+
+namespace {
+    // Three and a half blocks of ticks at even timestamps: tick i is at 2i, priced i
+    const uint64_t TICKS = TICK_BLOCK_TICKS * 3 + TICK_BLOCK_TICKS / 2;
+
+    std::string writeTicks(const std::string& directory, uint64_t count){
+        std::string path = TickStore::pathFor(directory, "ACME");
+        TickWriter writer(path);
+        for(uint64_t i = 0; i < count; i++){
+            writer.append(static_cast<int64_t>(2 * i), static_cast<double>(i), static_cast<int64_t>(i % 7));
+        }
+        writer.flush();
+        return path;
+    }
+
+    // Ticks `scan` visits in [from, to), checking that they come in order and each run stays
+    // inside one block
+    uint64_t scanned(const TickReader& reader, int64_t from, int64_t to, int64_t& first, int64_t& last){
+        uint64_t seen = 0;
+        first = -1;
+        last = -1;
+        reader.scan(from, to, [&](const TickSpan& span){
+            CHECK(span.count > 0);
+            CHECK(span.count <= TICK_BLOCK_TICKS);
+            for(size_t i = 0; i < span.count; i++){
+                CHECK(span.timestamps[i] > last);
+                CHECK_NEAR(span.prices[i], static_cast<double>(span.timestamps[i] / 2));
+                CHECK(span.volumes[i] == (span.timestamps[i] / 2) % 7);
+                if(first < 0){
+                    first = span.timestamps[i];
+                }
+                last = span.timestamps[i];
+            }
+            seen += span.count;
+        });
+        return seen;
+    }
+
+
+    void seekFindsTheFirstTickAtOrAfter(){
+        std::string path = writeTicks(scratchDirectory("ticks"), TICKS);
+        TickReader reader(path);
+        CHECK(reader.size() == TICKS);
+
+        CHECK(reader.seek(INT64_MIN) == 0);
+        CHECK(reader.seek(0) == 0);
+        CHECK(reader.seek(1) == 1);
+        CHECK(reader.seek(2) == 1);
+        // Either side of each block boundary
+        for(uint64_t block = 1; block <= 3; block++){
+            int64_t start = static_cast<int64_t>(2 * block * TICK_BLOCK_TICKS);
+            CHECK(reader.seek(start) == block * TICK_BLOCK_TICKS);
+            CHECK(reader.seek(start - 1) == block * TICK_BLOCK_TICKS);
+            CHECK(reader.seek(start - 2) == block * TICK_BLOCK_TICKS - 1);
+            CHECK(reader.seek(start + 1) == block * TICK_BLOCK_TICKS + 1);
+        }
+        int64_t lastTick = static_cast<int64_t>(2 * (TICKS - 1));
+        CHECK(reader.seek(lastTick) == TICKS - 1);
+        CHECK(reader.seek(lastTick + 1) == TICKS);
+    }
+
+    void scansVisitExactlyTheRange(){
+        std::string path = writeTicks(scratchDirectory("ticks"), TICKS);
+        TickReader reader(path);
+        int64_t first, last;
+
+        CHECK(scanned(reader, INT64_MIN, INT64_MAX, first, last) == TICKS);
+        CHECK(first == 0);
+        CHECK(last == static_cast<int64_t>(2 * (TICKS - 1)));
+
+        // From mid-block to mid-block, two boundaries in between
+        int64_t from = static_cast<int64_t>(TICK_BLOCK_TICKS) + 1;
+        int64_t to = static_cast<int64_t>(5 * TICK_BLOCK_TICKS) + 1;
+        CHECK(scanned(reader, from, to, first, last) == 2 * TICK_BLOCK_TICKS);
+        CHECK(first == from + 1);
+        CHECK(last == to - 1);
+
+        CHECK(scanned(reader, 10, 10, first, last) == 0);
+        CHECK(scanned(reader, 20, 10, first, last) == 0);
+        CHECK(scanned(reader, 2 * static_cast<int64_t>(TICKS), INT64_MAX, first, last) == 0);
+
+        TickSpan span = reader.run(TICK_BLOCK_TICKS - 2, TICKS);
+        CHECK(span.count == 2);
+        CHECK(span.timestamps[0] == static_cast<int64_t>(2 * (TICK_BLOCK_TICKS - 2)));
+    }
+
+    void readersCatchUpOnRefresh(){
+        std::string directory = scratchDirectory("ticks");
+        std::string path = TickStore::pathFor(directory, "ACME");
+        TickWriter writer(path);
+        writer.append(0, 0.0, 0);
+        writer.flush();
+
+        TickReader reader(path);
+        CHECK(reader.size() == 1);
+        for(uint64_t i = 1; i < TICK_BLOCK_TICKS + 10; i++){
+            writer.append(static_cast<int64_t>(2 * i), static_cast<double>(i), static_cast<int64_t>(i % 7));
+        }
+        writer.flush();
+        CHECK(reader.size() == 1);
+
+        reader.refresh();
+        CHECK(reader.size() == TICK_BLOCK_TICKS + 10);
+        CHECK(reader.seek(2 * TICK_BLOCK_TICKS) == TICK_BLOCK_TICKS);
+        int64_t first, last;
+        CHECK(scanned(reader, INT64_MIN, INT64_MAX, first, last) == TICK_BLOCK_TICKS + 10);
+    }
+
+    void writersRefuseTimeGoingBack(){
+        std::string directory = scratchDirectory("ticks");
+        {
+            TickWriter writer(TickStore::pathFor(directory, "ACME"));
+            writer.append(100, 1.0, 1);
+            CHECK_THROWS(writer.append(99, 1.0, 1));
+            CHECK(writer.size() == 1);
+        }
+
+        // Reopening picks up where the file left off
+        TickStore store(directory);
+        store.append("ACME", 100, 2.0, 1);
+        CHECK_THROWS(store.append("ACME", 50, 2.0, 1));
+        store.appendClamped("ACME", 50, 3.0, 1);
+        store.append("INIT", 10, 4.0, 1);
+        store.flush();
+
+        TickReader reader(TickStore::pathFor(directory, "ACME"));
+        CHECK(reader.size() == 3);
+        TickSpan span = reader.run(0, reader.size());
+        CHECK(span.timestamps[2] == 100);
+        CHECK_NEAR(span.prices[2], 3.0);
+        CHECK(TickStore::symbolsIn(directory) == std::vector<std::string>({"ACME", "INIT"}));
+    }
+}
+
+
+int main(){
+    return runTests({
+        {"seek finds the first tick at or after", seekFindsTheFirstTickAtOrAfter},
+        {"scans visit exactly the range", scansVisitExactlyTheRange},
+        {"readers catch up on refresh", readersCatchUpOnRefresh},
+        {"writers refuse time going back", writersRefuseTimeGoingBack},
+    });
+}
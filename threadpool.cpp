@@ -0,0 +1,73 @@
+#include "threadpool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(size_t threadCount){
+    threadCount = std::max<size_t>(threadCount, 1);
+    workers.reserve(threadCount);
+    for(size_t i = 0; i < threadCount; i++){
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for(auto& worker : workers){
+        if(worker.joinable()){
+            worker.join();
+        }
+    }
+}
+
+
+void ThreadPool::stop(){
+    std::deque<std::packaged_task<void()>> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        stopped = true;
+        discarded.swap(queue);
+    }
+    available.notify_all();
+    for(auto& worker : workers){
+        if(worker.joinable()){
+            worker.join();
+        }
+    }
+}
+
+
+std::future<void> ThreadPool::submit(std::function<void()> task){
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(stopped){
+            return result;   // `packaged` is destroyed unrun, which breaks the promise
+        }
+        queue.push_back(std::move(packaged));
+    }
+    available.notify_one();
+    return result;
+}
+
+
+void ThreadPool::workerLoop(){
+    while(true){
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if(queue.empty()){
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
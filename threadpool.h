@@ -0,0 +1,48 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed-size pool of worker threads draining one FIFO queue.
+// The number of threads is the concurrency limit for whatever is submitted to it.
+class ThreadPool {
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::packaged_task<void()>> queue;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping = false;
+        bool stopped = false;   // by stop(): nothing more is queued
+
+        void workerLoop();
+
+    public:
+
+    explicit ThreadPool(size_t threadCount);
+
+    // Finishes everything already queued, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // After stop the task is dropped and its future reports std::future_errc::broken_promise
+    std::future<void> submit(std::function<void()> task);
+
+    // Discards every task still queued (their futures report broken_promise), lets the running
+    // ones finish and joins the workers
+    void stop();
+
+    size_t size() const { return workers.size(); }
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,328 @@
+#include "tickstore.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+    struct FileHeader {
+        char magic[8];
+        uint32_t blockTicks;
+        uint32_t reserved;
+        uint64_t count;
+        char padding[40];
+    };
+    static_assert(sizeof(FileHeader) == 64, "tick file header must stay 64 bytes");
+
+    constexpr char MAGIC[8] = {'T', 'I', 'C', 'K', 'S', '0', '0', '1'};
+    constexpr size_t HEADER_BYTES = sizeof(FileHeader);
+    constexpr size_t BLOCK_BYTES = TICK_BLOCK_TICKS * (sizeof(int64_t) + sizeof(double) + sizeof(int64_t));
+
+    size_t bytesForBlocks(uint64_t blocks){
+        return HEADER_BYTES + blocks * BLOCK_BYTES;
+    }
+
+    const int64_t* timestampsOf(const unsigned char* base, uint64_t block){
+        return reinterpret_cast<const int64_t*>(base + HEADER_BYTES + block * BLOCK_BYTES);
+    }
+
+    const double* pricesOf(const unsigned char* base, uint64_t block){
+        return reinterpret_cast<const double*>(base + HEADER_BYTES + block * BLOCK_BYTES
+                                               + TICK_BLOCK_TICKS * sizeof(int64_t));
+    }
+
+    const int64_t* volumesOf(const unsigned char* base, uint64_t block){
+        return reinterpret_cast<const int64_t*>(base + HEADER_BYTES + block * BLOCK_BYTES
+                                                + TICK_BLOCK_TICKS * (sizeof(int64_t) + sizeof(double)));
+    }
+
+    void checkHeader(const FileHeader* header){
+        if(std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->blockTicks != TICK_BLOCK_TICKS){
+            throw std::runtime_error("Not a tick file or written with a different block size.");
+        }
+    }
+}
+
+
+
+TickWriter::TickWriter(const std::string& path){
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0){
+        throw std::runtime_error("Could not open tick file: " + path);
+    }
+
+    struct stat info;
+    ::fstat(fd, &info);
+    bool fresh = info.st_size == 0;
+    size_t bytes = fresh ? bytesForBlocks(1) : static_cast<size_t>(info.st_size);
+    if(fresh && ::ftruncate(fd, static_cast<off_t>(bytes)) != 0){
+        ::close(fd);
+        throw std::runtime_error("Could not size tick file: " + path);
+    }
+
+    void* mapped = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED){
+        ::close(fd);
+        throw std::runtime_error("Could not map tick file: " + path);
+    }
+    base = static_cast<unsigned char*>(mapped);
+    mappedBytes = bytes;
+
+    FileHeader* header = reinterpret_cast<FileHeader*>(base);
+    if(fresh){
+        std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+        header->blockTicks = TICK_BLOCK_TICKS;
+        header->count = 0;
+    }
+    checkHeader(header);
+
+    count = header->count;
+    if(count > 0){
+        uint64_t last = count - 1;
+        lastTimestamp = timestampsOf(base, last / TICK_BLOCK_TICKS)[last % TICK_BLOCK_TICKS];
+    }
+}
+
+TickWriter::~TickWriter(){
+    if(base){
+        ::msync(base, mappedBytes, MS_ASYNC);
+        ::munmap(base, mappedBytes);
+    }
+    if(fd >= 0){
+        ::close(fd);
+    }
+}
+
+
+void TickWriter::ensureCapacity(uint64_t ticks){
+    uint64_t blocksNeeded = (ticks + TICK_BLOCK_TICKS - 1) / TICK_BLOCK_TICKS;
+    if(bytesForBlocks(blocksNeeded) <= mappedBytes){
+        return;
+    }
+
+    // Grow geometrically so remaps stay rare
+    uint64_t blocksMapped = (mappedBytes - HEADER_BYTES) / BLOCK_BYTES;
+    uint64_t blocks = std::max(blocksNeeded, blocksMapped * 2);
+    size_t bytes = bytesForBlocks(blocks);
+
+    if(::ftruncate(fd, static_cast<off_t>(bytes)) != 0){
+        throw std::runtime_error("Could not grow tick file.");
+    }
+    ::munmap(base, mappedBytes);
+    void* mapped = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED){
+        base = nullptr;
+        mappedBytes = 0;
+        throw std::runtime_error("Could not remap tick file.");
+    }
+    base = static_cast<unsigned char*>(mapped);
+    mappedBytes = bytes;
+}
+
+
+void TickWriter::append(int64_t timestamp, double price, int64_t volume){
+    if(timestamp < lastTimestamp){
+        throw std::runtime_error("Tick timestamps must not go backwards.");
+    }
+    ensureCapacity(count + 1);
+
+    uint64_t block = count / TICK_BLOCK_TICKS;
+    uint64_t slot = count % TICK_BLOCK_TICKS;
+    const_cast<int64_t*>(timestampsOf(base, block))[slot] = timestamp;
+    const_cast<double*>(pricesOf(base, block))[slot] = price;
+    const_cast<int64_t*>(volumesOf(base, block))[slot] = volume;
+
+    // Publish the count only after the tick itself is in place
+    std::atomic_thread_fence(std::memory_order_release);
+    count++;
+    reinterpret_cast<FileHeader*>(base)->count = count;
+    lastTimestamp = timestamp;
+}
+
+
+void TickWriter::flush(){
+    ::msync(base, mappedBytes, MS_ASYNC);
+}
+
+
+
+TickReader::TickReader(const std::string& path){
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        throw std::runtime_error("Could not open tick file: " + path);
+    }
+    try{
+        map();
+    } catch (...){
+        ::close(fd);
+        throw;
+    }
+}
+
+TickReader::~TickReader(){
+    unmap();
+    if(fd >= 0){
+        ::close(fd);
+    }
+}
+
+
+void TickReader::map(){
+    struct stat info;
+    ::fstat(fd, &info);
+    size_t bytes = static_cast<size_t>(info.st_size);
+    if(bytes < HEADER_BYTES){
+        throw std::runtime_error("Tick file is truncated.");
+    }
+
+    void* mapped = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED){
+        throw std::runtime_error("Could not map tick file.");
+    }
+    base = static_cast<const unsigned char*>(mapped);
+    mappedBytes = bytes;
+
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    checkHeader(header);
+
+    uint64_t capacity = (bytes - HEADER_BYTES) / BLOCK_BYTES * TICK_BLOCK_TICKS;
+    count = std::min<uint64_t>(header->count, capacity);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    uint64_t blocks = (count + TICK_BLOCK_TICKS - 1) / TICK_BLOCK_TICKS;
+    blockStarts.resize(blocks);
+    for(uint64_t block = 0; block < blocks; block++){
+        blockStarts[block] = timestampsOf(base, block)[0];
+    }
+}
+
+void TickReader::unmap(){
+    if(base){
+        ::munmap(const_cast<unsigned char*>(base), mappedBytes);
+        base = nullptr;
+        mappedBytes = 0;
+    }
+}
+
+void TickReader::refresh(){
+    unmap();
+    map();
+}
+
+
+uint64_t TickReader::seek(int64_t timestamp) const{
+    if(count == 0){
+        return 0;
+    }
+
+    // The first block starting at or after `timestamp`; the answer is in the block before it or at its start
+    auto later = std::lower_bound(blockStarts.begin(), blockStarts.end(), timestamp);
+    uint64_t block = (later == blockStarts.begin()) ? 0 : static_cast<uint64_t>(later - blockStarts.begin()) - 1;
+
+    uint64_t blockCount = std::min<uint64_t>(TICK_BLOCK_TICKS, count - block * TICK_BLOCK_TICKS);
+    const int64_t* timestamps = timestampsOf(base, block);
+    const int64_t* found = std::lower_bound(timestamps, timestamps + blockCount, timestamp);
+    return block * TICK_BLOCK_TICKS + static_cast<uint64_t>(found - timestamps);
+}
+
+
+TickSpan TickReader::run(uint64_t index, uint64_t end) const{
+    end = std::min(end, count);
+    if(index >= end){
+        return TickSpan{nullptr, nullptr, nullptr, 0};
+    }
+    uint64_t block = index / TICK_BLOCK_TICKS;
+    uint64_t slot = index % TICK_BLOCK_TICKS;
+    uint64_t length = std::min<uint64_t>(TICK_BLOCK_TICKS - slot, end - index);
+
+    return TickSpan{timestampsOf(base, block) + slot, pricesOf(base, block) + slot,
+                    volumesOf(base, block) + slot, static_cast<size_t>(length)};
+}
+
+
+void TickReader::scan(int64_t from, int64_t to, const std::function<void(const TickSpan&)>& visit) const{
+    uint64_t index = seek(from);
+    uint64_t end = seek(to);
+
+    while(index < end){
+        TickSpan span = run(index, end);
+        visit(span);
+        index += span.count;
+    }
+}
+
+
+
+TickStore::TickStore(const std::string& directory)
+    : directory(directory)
+{
+    if(::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST){
+        throw std::runtime_error("Could not create tick directory: " + directory);
+    }
+}
+
+
+std::string TickStore::pathFor(const std::string& directory, const std::string& symbol){
+    std::string file = symbol;
+    std::replace(file.begin(), file.end(), '/', '_');
+    return directory + "/" + file + ".ticks";
+}
+
+
+std::vector<std::string> TickStore::symbolsIn(const std::string& directory){
+    DIR* dir = ::opendir(directory.c_str());
+    if(!dir){
+        throw std::runtime_error("Could not open tick directory: " + directory);
+    }
+    std::vector<std::string> symbols;
+    const std::string suffix = ".ticks";
+    while(dirent* entry = ::readdir(dir)){
+        std::string name = entry->d_name;
+        if(name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0){
+            symbols.push_back(name.substr(0, name.size() - suffix.size()));
+        }
+    }
+    ::closedir(dir);
+
+    std::sort(symbols.begin(), symbols.end());
+    return symbols;
+}
+
+
+TickWriter& TickStore::writerFor(const std::string& symbol){
+    auto found = writers.find(symbol);
+    if(found == writers.end()){
+        // Opened before it is inserted, so a file that fails to open leaves no empty entry behind
+        auto writer = std::make_unique<TickWriter>(pathFor(directory, symbol));
+        found = writers.emplace(symbol, std::move(writer)).first;
+    }
+    return *found->second;
+}
+
+
+void TickStore::append(const std::string& symbol, int64_t timestamp, double price, int64_t volume){
+    std::lock_guard<std::mutex> lock(mutex);
+    writerFor(symbol).append(timestamp, price, volume);
+}
+
+
+void TickStore::appendClamped(const std::string& symbol, int64_t timestamp, double price, int64_t volume){
+    std::lock_guard<std::mutex> lock(mutex);
+    TickWriter& writer = writerFor(symbol);
+    writer.append(std::max(timestamp, writer.lastTick()), price, volume);
+}
+
+
+void TickStore::flush(){
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& entry : writers){
+        entry.second->flush();
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef TICKSTORE_H
+#define TICKSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// On-disk layout of one <SYMBOL>.ticks file:
+//   64-byte header (magic, block capacity, tick count)
+//   fixed-size blocks, each holding BLOCK_TICKS timestamps, then prices, then volumes
+// Columns are contiguous inside a block, so a price scan walks one dense array.
+// The first timestamp of every block doubles as the seek index.
+constexpr size_t TICK_BLOCK_TICKS = 4096;
+
+
+// A run of ticks handed to scan callbacks; the pointers are straight into the mapping
+struct TickSpan {
+    const int64_t* timestamps;
+    const double* prices;
+    const int64_t* volumes;
+    size_t count;
+};
+
+
+// Appends ticks to one symbol's file through a growing shared mapping
+class TickWriter {
+
+    private:
+        int fd = -1;
+        unsigned char* base = nullptr;
+        size_t mappedBytes = 0;
+        uint64_t count = 0;
+        int64_t lastTimestamp = INT64_MIN;
+
+        void ensureCapacity(uint64_t ticks);
+
+    public:
+
+    explicit TickWriter(const std::string& path);
+
+    ~TickWriter();
+
+    TickWriter(const TickWriter&) = delete;
+
+    TickWriter& operator=(const TickWriter&) = delete;
+
+    // Timestamps must not go backwards
+    void append(int64_t timestamp, double price, int64_t volume);
+
+    // Schedules dirty pages for writeback without blocking
+    void flush();
+
+    uint64_t size() const { return count; }
+
+    // INT64_MIN while the file is empty
+    int64_t lastTick() const { return lastTimestamp; }
+};
+
+
+// Read-only, zero-copy view over one symbol's file
+class TickReader {
+
+    private:
+        int fd = -1;
+        const unsigned char* base = nullptr;
+        size_t mappedBytes = 0;
+        uint64_t count = 0;
+        std::vector<int64_t> blockStarts;   // first timestamp of each block
+
+        void map();
+        void unmap();
+
+    public:
+
+    explicit TickReader(const std::string& path);
+
+    ~TickReader();
+
+    TickReader(const TickReader&) = delete;
+
+    TickReader& operator=(const TickReader&) = delete;
+
+    // Picks up ticks appended since the file was opened
+    void refresh();
+
+    uint64_t size() const { return count; }
+
+    // Index of the first tick with timestamp >= `timestamp` (size() if none)
+    uint64_t seek(int64_t timestamp) const;
+
+    // Ticks from `index` up to `end` or the end of index's block, whichever comes first
+    TickSpan run(uint64_t index, uint64_t end) const;
+
+    // Calls `visit` once per block-sized run of ticks in [from, to)
+    void scan(int64_t from, int64_t to, const std::function<void(const TickSpan&)>& visit) const;
+};
+
+
+// One TickWriter per symbol under a directory
+class TickStore {
+
+    private:
+        std::string directory;
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<TickWriter>> writers;
+
+        // Opens the symbol's file on first use; caller holds `mutex`
+        TickWriter& writerFor(const std::string& symbol);
+
+    public:
+
+    explicit TickStore(const std::string& directory);
+
+    static std::string pathFor(const std::string& directory, const std::string& symbol);
+
+    // Symbols with a tick file in `directory`, sorted
+    static std::vector<std::string> symbolsIn(const std::string& directory);
+
+    void append(const std::string& symbol, int64_t timestamp, double price, int64_t volume);
+
+    // For wall-clock stamps, which can step back: a timestamp older than the symbol's last tick
+    // is recorded at that tick's time instead of being refused
+    void appendClamped(const std::string& symbol, int64_t timestamp, double price, int64_t volume);
+
+    void flush();
+};
+
+#endif // TICKSTORE_H
@@ -3,6 +3,7 @@ import mysql.connector
 from mysql.connector import errorcode
 from bs4 import BeautifulSoup
 import os
+import sys
 from dotenv import load_dotenv
 
 SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
@@ -35,22 +36,27 @@ popular_stocks = [
 ]
 
 
-try:
-    connection = mysql.connector.connect(user='root', password='',
-                              host='127.0.0.1',
-                              database='Trading')
+# --csv: print "symbol,price,volume,name" rows on stdout for the C++ ingestion
+# stage (Database::ingestQuotes) instead of writing to MySQL from here
+csv_mode = len(sys.argv) > 1 and sys.argv[1] == '--csv'
 
-except mysql.connector.Error as err:
-  if err.errno == errorcode.ER_ACCESS_DENIED_ERROR:
-    print("Something is wrong with your user name or password")
-  elif err.errno == errorcode.ER_BAD_DB_ERROR:
-    print("Database does not exist")
+if not csv_mode:
+  try:
+      connection = mysql.connector.connect(user='root', password='',
+                                host='127.0.0.1',
+                                database='Trading')
+
+  except mysql.connector.Error as err:
+    if err.errno == errorcode.ER_ACCESS_DENIED_ERROR:
+      print("Something is wrong with your user name or password")
+    elif err.errno == errorcode.ER_BAD_DB_ERROR:
+      print("Database does not exist")
+    else:
+      print(err)
   else:
-    print(err)
-else:
-  print('Connection successful')
+    print('Connection successful')
 
-cursor = connection.cursor()    
+  cursor = connection.cursor()    
 
 for symbol in popular_stocks:
     alphaUrl = 'https://www.alphavantage.co/query?function=GLOBAL_QUOTE&symbol='+symbol+'&apikey='+ apiKey
@@ -58,13 +64,19 @@ for symbol in popular_stocks:
     data = r.json()
     price =  data['Global Quote']['02. open'] 
     price = float(price)
+    volume = int(data['Global Quote'].get('06. volume', 0))
     r = requests.get('https://ticker-2e1ica8b9.now.sh/keyword/' + symbol)
     data = r.json()
+    name = ''
     for element in data:
         if element['symbol'] == symbol:
             name = element['name']
             break
 
+    if csv_mode:
+        print(f"{symbol},{price},{volume},{name}", flush=True)
+        continue
+
     addStock = ("INSERT INTO stocks (Symbol, CompanyName, StockPrice) "
                 "VALUES (%s, %s, %s) "
                 "ON DUPLICATE KEY UPDATE "
@@ -74,6 +86,7 @@ for symbol in popular_stocks:
 
     cursor.execute(addStock, stockData)
 
-connection.commit()
-cursor.close()
-connection.close()
\ No newline at end of file
+if not csv_mode:
+  connection.commit()
+  cursor.close()
+  connection.close()